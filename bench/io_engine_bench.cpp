@@ -0,0 +1,234 @@
+// Compares the epoll and io_uring reactor engines: throughput, latency percentiles and I/O syscalls per
+// request. The server runs in a forked child whose libc socket/syscall entry points are wrapped at link
+// time (see bench/CMakeLists.txt) and counted into shared memory, the load is generated by the parent
+// over keep-alive connections, each sending batches of pipelined requests (one request per batch by default).
+// Every engine runs twice: handing requests to the worker pool, and in run-to-completion mode on its reactors.
+//
+// Usage: bench_io_engine [connections=64] [requests per connection=5000] [reactors=2] [workers=4] [pipeline depth=1]
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/wait.h>
+
+#include "httpserver.h"
+
+static std::atomic<unsigned long long> *syscallCounter = nullptr;
+static bool countSyscalls = false;
+
+static inline void countSyscall() {
+  if(countSyscalls)
+    syscallCounter->fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" {
+ssize_t __real_recv(int, void*, size_t, int);
+ssize_t __real_send(int, const void*, size_t, int);
+ssize_t __real_sendmsg(int, const msghdr*, int);
+ssize_t __real_sendfile(int, int, off_t*, size_t);
+ssize_t __real_read(int, void*, size_t);
+ssize_t __real_write(int, const void*, size_t);
+int __real_accept4(int, sockaddr*, socklen_t*, int);
+int __real_epoll_wait(int, void*, int, int);
+int __real_epoll_ctl(int, int, int, void*);
+int __real_setsockopt(int, int, int, const void*, socklen_t);
+int __real_close(int);
+long __real_syscall(long, ...);
+
+ssize_t __wrap_recv(int fd, void *buf, size_t len, int flags) { countSyscall(); return __real_recv(fd, buf, len, flags); }
+ssize_t __wrap_send(int fd, const void *buf, size_t len, int flags) { countSyscall(); return __real_send(fd, buf, len, flags); }
+ssize_t __wrap_sendmsg(int fd, const msghdr *msg, int flags) { countSyscall(); return __real_sendmsg(fd, msg, flags); }
+ssize_t __wrap_sendfile(int out, int in, off_t *offset, size_t count) { countSyscall(); return __real_sendfile(out, in, offset, count); }
+ssize_t __wrap_read(int fd, void *buf, size_t len) { countSyscall(); return __real_read(fd, buf, len); }
+ssize_t __wrap_write(int fd, const void *buf, size_t len) { countSyscall(); return __real_write(fd, buf, len); }
+int __wrap_accept4(int fd, sockaddr *addr, socklen_t *len, int flags) { countSyscall(); return __real_accept4(fd, addr, len, flags); }
+int __wrap_epoll_wait(int fd, void *events, int max, int timeout) { countSyscall(); return __real_epoll_wait(fd, events, max, timeout); }
+int __wrap_epoll_ctl(int fd, int op, int target, void *event) { countSyscall(); return __real_epoll_ctl(fd, op, target, event); }
+int __wrap_setsockopt(int fd, int level, int name, const void *value, socklen_t len) { countSyscall(); return __real_setsockopt(fd, level, name, value, len); }
+int __wrap_close(int fd) { countSyscall(); return __real_close(fd); }
+
+long __wrap_syscall(long number, ...) {
+  va_list args;
+  va_start(args, number);
+  long a = va_arg(args, long), b = va_arg(args, long), c = va_arg(args, long);
+  long d = va_arg(args, long), e = va_arg(args, long), f = va_arg(args, long);
+  va_end(args);
+  countSyscall();
+  return __real_syscall(number, a, b, c, d, e, f);
+}
+}
+
+struct Result {
+  unsigned long long requests = 0;
+  double seconds = 0;
+  double p50 = 0, p99 = 0, p999 = 0;
+  double syscallsPerRequest = 0;
+};
+
+static int connectTo(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if(connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+    __real_close(fd);
+    return -1;
+  }
+  int noDelay = 1;
+  __real_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  return fd;
+}
+
+// Sends a batch of pipelined requests and reads exactly that many responses, returns false on a broken connection.
+static bool roundTrip(int fd, const std::string &batch, int responses, std::string &buffer) {
+  if(__real_send(fd, batch.data(), batch.size(), MSG_NOSIGNAL) != (ssize_t)batch.size())
+    return false;
+  buffer.clear();
+  size_t start = 0;
+  char chunk[4096];
+  while(true) {
+    size_t headerEnd;
+    while(responses > 0 && (headerEnd = buffer.find("\r\n\r\n", start)) != std::string::npos) {
+      size_t pos = buffer.find("Content-Length: ", start);
+      size_t length = pos == std::string::npos || pos > headerEnd ? 0 : std::strtoul(buffer.c_str() + pos + 16, nullptr, 10);
+      if(buffer.size() < headerEnd + 4 + length)
+        break;
+      start = headerEnd + 4 + length;
+      responses--;
+    }
+    if(responses == 0)
+      return true;
+    ssize_t received = __real_recv(fd, chunk, sizeof(chunk), 0);
+    if(received <= 0)
+      return false;
+    buffer.append(chunk, received);
+  }
+}
+
+static Result run(IoEngine engine, int port, int connections, int requests, unsigned reactors, unsigned workers,
+                  int depth, bool runToCompletion) {
+  syscallCounter->store(0);
+  pid_t child = fork();
+  if(child == 0) {
+    countSyscalls = true;
+    HttpServer server;
+    server.setIoEngine(engine);
+    server.setReactorThreads(reactors);
+    server.setWorkerThreads(workers);
+    server.setRunToCompletion(runToCompletion);
+    server.Get("/", [](Request &, Response &res) { res.send("ok"); });
+    server.initServer(port);
+    _exit(0);
+  }
+
+  std::vector<int> sockets;
+  for(int attempt = 0; attempt < 200 && (int)sockets.size() < connections; attempt++) {
+    int fd = connectTo(port);
+    if(fd < 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    sockets.push_back(fd);
+  }
+  if((int)sockets.size() < connections) {
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    throw std::runtime_error("Server did not come up");
+  }
+
+  const std::string request = "GET / HTTP/1.1\r\nHost: bench\r\n\r\n";
+  std::string batch;
+  for(int i = 0; i < depth; i++)
+    batch += request;
+  // Warm up every connection so accept and setup syscalls stay out of the measurement.
+  for(int fd : sockets) {
+    std::string buffer;
+    roundTrip(fd, request, 1, buffer);
+  }
+  syscallCounter->store(0);
+
+  std::vector<std::vector<double>> latencies(connections);
+  std::vector<std::thread> clients;
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < connections; i++) {
+    clients.emplace_back([&, i]() {
+      std::string buffer;
+      latencies[i].reserve(requests);
+      for(int r = 0; r + depth <= requests; r += depth) {
+        auto sent = std::chrono::steady_clock::now();
+        if(!roundTrip(sockets[i], batch, depth, buffer))
+          return;
+        // Every request of a batch is charged the latency of the whole batch.
+        double latency = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count();
+        latencies[i].insert(latencies[i].end(), depth, latency);
+      }
+    });
+  }
+  for(std::thread &client : clients)
+    client.join();
+  auto end = std::chrono::steady_clock::now();
+  unsigned long long serverSyscalls = syscallCounter->load();
+
+  for(int fd : sockets)
+    __real_close(fd);
+  kill(child, SIGKILL);
+  waitpid(child, nullptr, 0);
+
+  std::vector<double> all;
+  for(std::vector<double> &perConnection : latencies)
+    all.insert(all.end(), perConnection.begin(), perConnection.end());
+  std::sort(all.begin(), all.end());
+
+  Result result;
+  result.requests = all.size();
+  result.seconds = std::chrono::duration<double>(end - start).count();
+  if(!all.empty()) {
+    result.p50 = all[all.size() / 2];
+    result.p99 = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+    result.p999 = all[std::min(all.size() - 1, all.size() * 999 / 1000)];
+    result.syscallsPerRequest = (double)serverSyscalls / all.size();
+  }
+  return result;
+}
+
+static void print(const char *name, const Result &result) {
+  std::printf("%-13s %10llu %12.0f %9.1f %9.1f %9.1f %14.2f\n", name, result.requests,
+              result.requests / result.seconds, result.p50, result.p99, result.p999, result.syscallsPerRequest);
+}
+
+int main(int argc, char **argv) {
+  int connections = argc > 1 ? std::atoi(argv[1]) : 64;
+  int requests = argc > 2 ? std::atoi(argv[2]) : 5000;
+  unsigned reactors = argc > 3 ? std::atoi(argv[3]) : 2;
+  unsigned workers = argc > 4 ? std::atoi(argv[4]) : 4;
+  int depth = std::max(1, argc > 5 ? std::atoi(argv[5]) : 1);
+
+  void *shared = mmap(nullptr, sizeof(std::atomic<unsigned long long>), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  syscallCounter = new (shared) std::atomic<unsigned long long>(0);
+
+  std::printf("%d connections x %d requests, %u reactors, %u workers, pipeline depth %d\n\n", connections, requests,
+              reactors, workers, depth);
+  std::printf("%-13s %10s %12s %9s %9s %9s %14s\n", "engine", "requests", "req/s", "p50(us)", "p99(us)", "p999(us)", "syscalls/req");
+  print("epoll", run(IoEngine::Epoll, 18080, connections, requests, reactors, workers, depth, false));
+  print("epoll rtc", run(IoEngine::Epoll, 18082, connections, requests, reactors, workers, depth, true));
+#ifdef BOLTPP_IO_URING
+  print("io_uring", run(IoEngine::IoUring, 18081, connections, requests, reactors, workers, depth, false));
+  print("io_uring rtc", run(IoEngine::IoUring, 18083, connections, requests, reactors, workers, depth, true));
+#else
+  std::printf("io_uring      (not built, configure with -DBOLTPP_IO_URING=ON)\n");
+#endif
+  return 0;
+}
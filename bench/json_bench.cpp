@@ -0,0 +1,663 @@
+// Checks the two-stage JSONParser against the recursive descent parser it replaced, then measures both.
+//
+// The differential part parses the same documents with both parsers and compares the JSONValue trees: the
+// corpora, a few thousand random documents with random whitespace, escapes and numbers of every shape, and
+// mutations of these with one byte replaced, inserted or removed. Whatever the two-stage parser accepts the
+// recursive one has to accept with the same result, the other way around is not required, the recursive parser
+// lets some invalid documents through. A list of invalid documents has to be rejected, and every indexer the
+// CPU supports has to find the same structural offsets. Any difference ends the program with status 1.
+//
+// The corpora are built to resemble twitter.json, many small objects full of strings, and canada.json, large
+// arrays of coordinates, plus a 20 KB API request body. Files given on the command line are used as well, so
+// the real ones can be measured. Every row parses each document rounds times and reports MB/s.
+//
+// Every accepted document also has to stringify to text that parses back to the same value, numbers to the
+// bit. The stringify rows serialize the parsed corpora, once with the serializer before shortest round-trip
+// numbers and escaping and once with stringify(), both in MB/s of the text stringify() produces.
+//
+// Usage: bench_json [rounds=20] [file.json ...]
+
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "errors.h"
+#include "json.h"
+
+// The parser before JSONTape: one character at a time through get() and peek(), one function per value type.
+// Its escapes are decoded correctly here, \b, \f, \n, \r and \t used to come out as the letter, and \u was
+// missing, so the two parsers can be compared on strings.
+class RecursiveParser {
+  std::string input;
+  size_t pos, size;
+
+  inline char get() { return input[pos++]; }
+  inline char peek() const { return pos < size ? input[pos] : '\0'; }
+  void skipWhitespaces() {
+    while(pos < size && std::isspace(input[pos]))
+      pos++;
+  }
+
+  JSONValue parseValue(char c) {
+    switch(c) {
+      case '"': return parseString();
+      case '{': return parseObject();
+      case '[': return parseArray();
+      case 'n': return parseNull();
+      case 't':
+      case 'f': return parseBoolean();
+      case '-':
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9': return parseNumber();
+      default: throw json_parse_error(std::string("Unexpected symbol caught: ") + c);
+    }
+  }
+
+  JSONValue parseBoolean() {
+    if(input.compare(pos, 4, "true") == 0) {
+      pos += 4;
+      return JSONValue(true);
+    }
+    if(input.compare(pos, 5, "false") == 0) {
+      pos += 5;
+      return JSONValue(false);
+    }
+    throw json_parse_error("Unexpected value caught, expected boolean");
+  }
+
+  JSONValue parseNull() {
+    if(pos <= size - 4 && get() == 'n' && get() == 'u' && get() == 'l' && get() == 'l')
+      return JSONValue(nullptr);
+    throw json_parse_error("Unexpected value caught, expected 'null'");
+  }
+
+  JSONValue parseString() {
+    if(get() != '"')
+      throw json_parse_error("Expected '\"' at beginning of the string");
+    std::string output;
+    while(true) {
+      if(pos >= size)
+        throw json_parse_error("Unterminated string");
+      char c = get();
+      if(c == '"')
+        break;
+      if(c == '\\') {
+        if(pos >= size)
+          throw json_parse_error("Invalid escape sequence in string");
+        char esc = get();
+        switch(esc) {
+          case '"': output.push_back('"'); break;
+          case '\\': output.push_back('\\'); break;
+          case '/': output.push_back('/'); break;
+          case 'b': output.push_back('\b'); break;
+          case 'f': output.push_back('\f'); break;
+          case 'n': output.push_back('\n'); break;
+          case 'r': output.push_back('\r'); break;
+          case 't': output.push_back('\t'); break;
+          case 'u': appendCodePoint(output); break;
+          default: throw json_parse_error("Invalid escape character in string");
+        }
+      } else
+        output.push_back(c);
+    }
+    return JSONValue(std::move(output));
+  }
+
+  unsigned parseHex() {
+    if(pos + 4 > size)
+      throw json_parse_error("Invalid \\u escape in string");
+    unsigned value = 0;
+    for(int i = 0; i < 4; i++) {
+      char c = get();
+      if(!std::isxdigit(static_cast<unsigned char>(c)))
+        throw json_parse_error("Invalid \\u escape in string");
+      value = value * 16 + (std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    return value;
+  }
+
+  void appendCodePoint(std::string &output) {
+    unsigned code = parseHex();
+    if(code >= 0xDC00 && code <= 0xDFFF)
+      throw json_parse_error("Unpaired surrogate in string");
+    if(code >= 0xD800 && code <= 0xDBFF) {
+      if(pos + 2 > size || get() != '\\' || get() != 'u')
+        throw json_parse_error("Unpaired surrogate in string");
+      unsigned low = parseHex();
+      if(low < 0xDC00 || low > 0xDFFF)
+        throw json_parse_error("Unpaired surrogate in string");
+      code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    }
+    if(code < 0x80)
+      output.push_back(char(code));
+    else if(code < 0x800)
+      output += {char(0xC0 | code >> 6), char(0x80 | (code & 0x3F))};
+    else if(code < 0x10000)
+      output += {char(0xE0 | code >> 12), char(0x80 | (code >> 6 & 0x3F)), char(0x80 | (code & 0x3F))};
+    else
+      output += {char(0xF0 | code >> 18), char(0x80 | (code >> 12 & 0x3F)), char(0x80 | (code >> 6 & 0x3F)),
+                 char(0x80 | (code & 0x3F))};
+  }
+
+  JSONValue parseNumber() {
+    const char *start = &input[pos];
+    while(pos < size && (std::isdigit(input[pos]) || input[pos] == '-' || input[pos] == '+' || input[pos] == '.' ||
+                         input[pos] == 'e' || input[pos] == 'E'))
+      pos++;
+    double num;
+    auto res = std::from_chars(start, &input[pos], num);
+    if(res.ec != std::errc())
+      throw json_parse_error("Invalid number");
+    return JSONValue(num);
+  }
+
+  JSONValue parseObject() {
+    JSONValue::Object obj;
+    get();
+    skipWhitespaces();
+    if(peek() == '}') {
+      get();
+      return JSONValue(std::move(obj));
+    }
+    if(peek() != '"')
+      throw json_parse_error("Expected \" as starting of key in JSON object");
+    while(true) {
+      std::string key = std::move(std::get<std::string>(parseString().value));
+      skipWhitespaces();
+      if(get() != ':')
+        throw json_parse_error("Missing : after key value");
+      skipWhitespaces();
+      JSONValue value = parseValue(peek());
+      obj.insert_or_assign(std::move(key), std::move(value));
+      skipWhitespaces();
+      char c = get();
+      if(c == '}')
+        break;
+      if(c != ',')
+        throw json_parse_error(std::string("Expected '}' or ',' but encountered unexpected symbol: ") + c);
+      skipWhitespaces();
+      if(peek() != '"')
+        throw json_parse_error("Expected \" as starting of key in JSON object");
+    }
+    return JSONValue(std::move(obj));
+  }
+
+  JSONValue parseArray() {
+    JSONValue::Array arr;
+    get();
+    skipWhitespaces();
+    if(peek() == ']') {
+      get();
+      return JSONValue(std::move(arr));
+    }
+    while(true) {
+      arr.emplace_back(parseValue(peek()));
+      skipWhitespaces();
+      char c = get();
+      if(c == ']')
+        break;
+      if(c != ',')
+        throw json_parse_error(std::string("Unexpected symbol caught: ") + c);
+      skipWhitespaces();
+      if(peek() == ']')
+        throw json_parse_error("Trailing commas not allowed in JSON arrays");
+    }
+    return JSONValue(std::move(arr));
+  }
+
+public:
+  explicit RecursiveParser(const std::string &str) : input(str), pos(0), size(str.size()) {}
+
+  JSONValue parse() {
+    skipWhitespaces();
+    if(pos >= size)
+      return JSONValue();
+    JSONValue json = parseValue(peek());
+    skipWhitespaces();
+    if(pos < size)
+      throw json_parse_error("Invalid JSON string value");
+    return json;
+  }
+};
+
+// stringify() before numbers were written with to_chars and strings were escaped, the baseline of the stringify
+// rows. Its output is not always valid JSON.
+static void legacyStringify(const JSONValue &json, std::string &out) {
+  std::visit([&out](auto &&arg) {
+    using T = std::decay_t<decltype(arg)>;
+    if constexpr(std::is_same_v<T, std::nullptr_t>)
+      out.append("null");
+    else if constexpr(std::is_same_v<T, bool>)
+      out.append(arg ? "true" : "false");
+    else if constexpr(std::is_same_v<T, double>)
+      out.append(std::to_string(arg));
+    else if constexpr(std::is_same_v<T, std::string>) {
+      out.push_back('"');
+      out.append(arg);
+      out.push_back('"');
+    } else if constexpr(std::is_same_v<T, JSONValue::Array>) {
+      out.push_back('[');
+      for(size_t i = 0; i < arg.size(); ++i) {
+        if(i > 0)
+          out.push_back(',');
+        legacyStringify(arg[i], out);
+      }
+      out.push_back(']');
+    } else if constexpr(std::is_same_v<T, JSONValue::Object>) {
+      out.push_back('{');
+      bool first = true;
+      for(const auto &kv : arg) {
+        if(!first)
+          out.push_back(',');
+        first = false;
+        out.push_back('"');
+        out.append(kv.first);
+        out.append("\":");
+        legacyStringify(kv.second, out);
+      }
+      out.push_back('}');
+    }
+  }, json.value);
+}
+
+static bool sameValue(const JSONValue &a, const JSONValue &b) {
+  if(a.value.index() != b.value.index())
+    return false;
+  if(const double *number = std::get_if<double>(&a.value))
+    return std::memcmp(number, &std::get<double>(b.value), sizeof(double)) == 0;
+  if(const std::string *text = std::get_if<std::string>(&a.value))
+    return *text == std::get<std::string>(b.value);
+  if(const JSONValue::Array *array = std::get_if<JSONValue::Array>(&a.value)) {
+    const JSONValue::Array &other = std::get<JSONValue::Array>(b.value);
+    if(array->size() != other.size())
+      return false;
+    for(size_t i = 0; i < array->size(); i++) {
+      if(!sameValue((*array)[i], other[i]))
+        return false;
+    }
+    return true;
+  }
+  if(const JSONValue::Object *object = std::get_if<JSONValue::Object>(&a.value)) {
+    const JSONValue::Object &other = std::get<JSONValue::Object>(b.value);
+    if(object->size() != other.size())
+      return false;
+    for(const auto &[key, value] : *object) {
+      auto found = other.find(key);
+      if(found == other.end() || !sameValue(value, found->second))
+        return false;
+    }
+    return true;
+  }
+  if(const bool *flag = std::get_if<bool>(&a.value))
+    return *flag == std::get<bool>(b.value);
+  return true;
+}
+
+// Random documents. Whitespace, escapes and number formats vary, depth and sizes stay small.
+class DocumentWriter {
+public:
+  explicit DocumentWriter(uint32_t seed) : random(seed) {}
+
+  std::string document() {
+    out.clear();
+    space();
+    value(0);
+    space();
+    return out;
+  }
+
+private:
+  std::mt19937 random;
+  std::string out;
+
+  size_t below(size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(random); }
+
+  void space() {
+    static const char WHITESPACE[] = {' ', '\t', '\n', '\r'};
+    for(size_t n = below(4) == 0 ? below(4) : 0; n > 0; n--)
+      out.push_back(WHITESPACE[below(4)]);
+  }
+
+  void string() {
+    static const char *const PIECES[] = {"a", "key", " ", "\\\"", "\\\\", "\\/", "\\n", "\\t", "\\b", "\\f", "\\r",
+                                         "\xc3\xa9", "\xe2\x82\xac", "{", "]", ":", ",", "\\\\\\\"", "0",
+                                         "\\u00e9", "\\u20AC", "\\ud83d\\ude00", "\\u0000", "\\u001f", "\\u005C"};
+    out.push_back('"');
+    for(size_t n = below(3) == 0 ? below(80) : below(12); n > 0; n--)
+      out.append(PIECES[below(sizeof(PIECES) / sizeof(PIECES[0]))]);
+    out.push_back('"');
+  }
+
+  void number() {
+    if(below(2))
+      out.push_back('-');
+    if(below(4) == 0)
+      out.push_back('0');
+    else
+      out.append(std::to_string(below(1000000000) + 1).substr(0, 1 + below(9)));
+    if(below(2)) {
+      out.push_back('.');
+      out.append(std::to_string(below(100000000)));
+    }
+    if(below(4) == 0) {
+      out.push_back("eE"[below(2)]);
+      if(below(2))
+        out.push_back("+-"[below(2)]);
+      out.append(std::to_string(below(300)));
+    }
+  }
+
+  void value(int depth) {
+    switch(depth < 6 ? below(7) : below(4)) {
+      case 0: string(); break;
+      case 1: number(); break;
+      case 2: out.append(below(3) == 0 ? "null" : below(2) ? "true" : "false"); break;
+      case 3: number(); break;
+      case 4:
+      case 5: {
+        out.push_back('[');
+        space();
+        for(size_t n = below(6), i = 0; i < n; i++) {
+          if(i > 0)
+            out.push_back(',');
+          space();
+          value(depth + 1);
+          space();
+        }
+        out.push_back(']');
+        break;
+      }
+      default: {
+        out.push_back('{');
+        space();
+        for(size_t n = below(6), i = 0; i < n; i++) {
+          if(i > 0)
+            out.push_back(',');
+          space();
+          string();
+          space();
+          out.push_back(':');
+          space();
+          value(depth + 1);
+          space();
+        }
+        out.push_back('}');
+      }
+    }
+  }
+};
+
+static std::string twitterLike(size_t statuses) {
+  std::mt19937 random(7);
+  auto pick = [&](size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(random); };
+  static const char *const WORDS[] = {"the", "release", "is", "out", "today", "@boltpp", "#cpp", "fast",
+                                      "\\\"quoted\\\"", "http:\\/\\/t.co\\/xyz", "\xe2\x9c\x93", "\\n", "server"};
+  std::string out = "{\"statuses\":[";
+  for(size_t i = 0; i < statuses; i++) {
+    std::string text;
+    for(size_t n = 5 + pick(20); n > 0; n--) {
+      text += WORDS[pick(sizeof(WORDS) / sizeof(WORDS[0]))];
+      text += " ";
+    }
+    uint64_t id = 250075927172759552ull + i * 7919;
+    out += i ? "," : "";
+    out += "{\"metadata\":{\"result_type\":\"recent\",\"iso_language_code\":\"en\"},"
+           "\"created_at\":\"Mon Sep 24 03:35:21 +0000 2012\",\"id\":" + std::to_string(id) +
+           ",\"id_str\":\"" + std::to_string(id) + "\",\"text\":\"" + text + "\","
+           "\"source\":\"<a href=\\\"http:\\/\\/twitter.com\\\" rel=\\\"nofollow\\\">Twitter<\\/a>\","
+           "\"truncated\":false,\"in_reply_to_status_id\":null,\"user\":{\"id\":" + std::to_string(1186275104 + pick(1000)) +
+           ",\"name\":\"user " + std::to_string(i) + "\",\"screen_name\":\"u" + std::to_string(pick(100000)) +
+           "\",\"location\":\"\",\"description\":\"" + text.substr(0, text.find(' ', text.size() / 2)) + "\",\"url\":null,"
+           "\"entities\":{\"description\":{\"urls\":[]}},\"protected\":false,\"followers_count\":" +
+           std::to_string(pick(5000)) + ",\"friends_count\":" + std::to_string(pick(500)) +
+           ",\"listed_count\":0,\"created_at\":\"Wed Mar 06 08:39:46 +0000 2013\",\"favourites_count\":" +
+           std::to_string(pick(100)) + ",\"utc_offset\":null,\"time_zone\":null,\"geo_enabled\":false,"
+           "\"verified\":false,\"statuses_count\":" + std::to_string(pick(10000)) + ",\"lang\":\"en\","
+           "\"profile_background_color\":\"C0DEED\",\"profile_image_url\":\"http:\\/\\/a0.twimg.com\\/profile_images\\/"
+           + std::to_string(pick(1u << 30)) + "\\/normal.png\",\"default_profile\":true,\"following\":false},"
+           "\"geo\":null,\"coordinates\":null,\"place\":null,\"contributors\":null,\"retweet_count\":" +
+           std::to_string(pick(50)) + ",\"favorite_count\":0,\"entities\":{\"hashtags\":[{\"text\":\"cpp\","
+           "\"indices\":[" + std::to_string(pick(50)) + "," + std::to_string(50 + pick(50)) + "]}],\"symbols\":[],"
+           "\"urls\":[],\"user_mentions\":[]},\"favorited\":false,\"retweeted\":false,\"lang\":\"en\"}";
+  }
+  out += "],\"search_metadata\":{\"completed_in\":0.087,\"max_id\":250126199840518145,\"query\":\"%23cpp\","
+         "\"count\":" + std::to_string(statuses) + ",\"since_id\":0}}";
+  return out;
+}
+
+static std::string canadaLike(size_t rings) {
+  std::mt19937 random(11);
+  std::uniform_real_distribution<double> wiggle(-0.05, 0.05);
+  char number[64];
+  std::string out = "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"properties\":"
+                    "{\"name\":\"Canada\"},\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[";
+  for(size_t ring = 0; ring < rings; ring++) {
+    out += ring ? ",[" : "[";
+    double x = -141.0 + ring * 0.37, y = 41.7 + ring * 0.11;
+    for(size_t i = 0; i < 200; i++) {
+      x += wiggle(random);
+      y += wiggle(random);
+      std::snprintf(number, sizeof(number), "%s[%.15f,%.15f]", i ? "," : "", x, y);
+      out += number;
+    }
+    out += "]";
+  }
+  out += "]}}]}";
+  return out;
+}
+
+static std::string apiBody() {
+  std::string out = "{\"order\":{\"id\":\"ord_4711\",\"customer\":{\"id\":42,\"email\":\"someone@example.com\","
+                    "\"name\":\"Some One\"},\"currency\":\"EUR\",\"lines\":[";
+  for(int i = 0; i < 160; i++) {
+    out += i ? "," : "";
+    out += "{\"sku\":\"SKU-" + std::to_string(100000 + i * 37) + "\",\"title\":\"Item number " + std::to_string(i) +
+           " with a \\\"quoted\\\" name\",\"quantity\":" + std::to_string(1 + i % 5) + ",\"price\":" +
+           std::to_string(i) + ".99,\"tags\":[\"a\",\"b\"],\"gift\":" + (i % 7 ? "false" : "true") + "}";
+  }
+  out += "],\"notes\":null,\"total\":12345.67}}";
+  return out;
+}
+
+static int failures = 0;
+
+static void fail(const char *what, const std::string &document) {
+  if(++failures <= 5)
+    std::fprintf(stderr, "%s: %.200s\n", what, document.c_str());
+}
+
+// Parses with both parsers, returns whether the two-stage parser accepted the document.
+static bool compareParsers(std::string document, bool mustAccept) {
+  std::pmr::vector<uint32_t> reference, offsets;
+  bool referenceValid = JSONTape::indexer(JSONTape::Isa::Scalar)(document.data(), document.size(), reference);
+  for(JSONTape::Isa isa : {JSONTape::Isa::SSE42, JSONTape::Isa::AVX2}) {
+    JSONTape::Indexer index = JSONTape::indexer(isa);
+    if(index && (index(document.data(), document.size(), offsets) != referenceValid || offsets != reference))
+      fail(JSONTape::isaName(isa), document);
+  }
+
+  JSONValue parsed;
+  try {
+    parsed = JSONParser(document).parse();
+  } catch(const json_parse_error &error) {
+    if(mustAccept)
+      fail((std::string("rejected a valid document, ") + error.what()).c_str(), document);
+    return false;
+  }
+  try {
+    if(!sameValue(parsed, RecursiveParser(document).parse()))
+      fail("parsed differently", document);
+  } catch(const json_parse_error &) {
+    fail("accepted a document the recursive parser rejects", document);
+  }
+  std::string text = parsed.stringify();
+  try {
+    if(!sameValue(JSONParser(text).parse(), parsed))
+      fail("stringified to a different value", document);
+  } catch(const json_parse_error &) {
+    fail(("stringified to invalid JSON " + text.substr(0, 200)).c_str(), document);
+  }
+  return true;
+}
+
+static void differential(const std::vector<std::pair<std::string, std::string>> &corpora) {
+  size_t documents = 0, mutations = 0, accepted = 0;
+  for(const auto &[name, document] : corpora) {
+    compareParsers(document, true);
+    documents++;
+  }
+
+  static const char *const VALID[] = {
+      "", " \n\t\r ", "0", "-0", "1e5", "-12.5E-3", "1E+2", "\"\"", "\"a\\\"b\\\\c\\/d\"", "[]", "{}", "[[[]]]",
+      "{\"a\":{\"b\":[1,2,{\"c\":null}]}}", " [ true , false , null ] ", "{\"dup\":1,\"dup\":2}", "[\"\\\\\"]",
+      "[\"\\\\\\\\\",\"\\\"\\\\\\\"\"]", "{\"\":\"\"}", "[1.5e-300,123456789012345678901234567890]",
+      "\"\\u0041\\u00e9\\u20ac\\uD83D\\uDE00\"", "[\"\\ud800\\udc00\\udbff\\udfff\"]"};
+  for(const char *document : VALID) {
+    compareParsers(document, true);
+    documents++;
+  }
+  // Round trips alone would accept any exact format, the shortest one is checked for a few numbers and escapes.
+  static const std::pair<JSONValue, const char *> WRITTEN[] = {
+      {30.0, "30"}, {-0.0, "-0"}, {0.1, "0.1"}, {-1.5e-7, "-1.5e-07"}, {1e21, "1e+21"}, {9007199254740993.0, "9007199254740992"},
+      {1.7976931348623157e308, "1.7976931348623157e+308"}, {5e-324, "5e-324"}, {std::string("a\"\\/\b\f\n\r\t\x01\x1f\x7f\xc3\xa9"),
+      "\"a\\\"\\\\/\\b\\f\\n\\r\\t\\u0001\\u001f\x7f\xc3\xa9\""}};
+  for(const auto &[value, text] : WRITTEN) {
+    if(value.stringify() != text)
+      fail("stringified wrongly", value.stringify());
+  }
+
+  // Both parsers could agree on a wrong decoding, escapes are also checked against what they stand for.
+  std::string escapes = "\"\\b\\f\\n\\r\\t\\/\\u0041\\u00e9\\u20ac\\ud83d\\ude00\"";
+  std::string_view expected = "\b\f\n\r\t/A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80";
+  JSONDocument escaped;
+  escaped.parse(escapes);
+  if(JSONParser(escapes).parse().asString() != expected || escaped.root().asStringView() != expected)
+    fail("decoded escapes wrongly", escapes);
+  documents++;
+  static const char *const INVALID[] = {
+      "[1,]", "{\"a\":1,}", "[1 2]", "{\"a\" 1}", "{1:2}", "tru", "nul", "nulll", "[01]", "[1.]", "[.5]", "[-]",
+      "[1e]", "\"abc", "\"a\\x\"", "[\"a\\\"]", "{\"a\":1}}", "[1]x", "\"tab\there\"", "[+1]", "truefalse", "[1,2",
+      "{", "]", "[,]", "{\"a\"}", "{\"a\":}", "[1e400]", "\"\\\"", "[true false]", "[\"a\" \"b\"]", "1 2", "[-a]",
+      "\"\\u12\"", "\"\\uZZZZ\"", "\"\\ud800\"", "\"\\udc00\"", "\"\\ud800\\u0041\"", "\"\\ud800x\"",
+      "\"\\ud800\\n\"", "\"\\u00e\""};
+  for(const char *document : INVALID) {
+    if(compareParsers(document, false))
+      fail("accepted an invalid document", document);
+    documents++;
+  }
+
+  std::string deepest = std::string(JSONTape::MAX_DEPTH, '[') + std::string(JSONTape::MAX_DEPTH, ']');
+  compareParsers(deepest, true);
+  if(compareParsers("[" + deepest + "]", false))
+    fail("accepted a document nested too deeply", deepest);
+  documents += 2;
+
+  // Strings and backslash runs across the 64 byte blocks of stage one.
+  for(size_t length = 0; length < 200; length++) {
+    for(size_t backslashes = 1; backslashes <= 3; backslashes++) {
+      std::string document = "[\"" + std::string(length, 'x') + std::string(backslashes * 2, '\\') + "\",1]";
+      compareParsers(document, true);
+      document = "[" + std::string(length, ' ') + "\"" + std::string(backslashes * 2 - 1, '\\') + "\"\"]";
+      compareParsers(document, true);
+      documents += 2;
+    }
+  }
+
+  DocumentWriter writer(2024);
+  std::mt19937 random(99);
+  static const char MUTATIONS[] = "{}[]:,\"\\ 0a-e.tfnlu1";
+  for(int i = 0; i < 5000; i++) {
+    std::string document = writer.document();
+    compareParsers(document, true);
+    documents++;
+    for(int m = 0; m < 4 && !document.empty(); m++) {
+      std::string mutated = document;
+      size_t at = random() % mutated.size();
+      char c = MUTATIONS[random() % (sizeof(MUTATIONS) - 1)];
+      switch(random() % 3) {
+        case 0: mutated[at] = c; break;
+        case 1: mutated.insert(mutated.begin() + at, c); break;
+        default: mutated.erase(at, 1);
+      }
+      accepted += compareParsers(mutated, false);
+      mutations++;
+    }
+  }
+  std::printf("differential: %zu documents, %zu mutations (%zu still valid), %d failures\n", documents, mutations,
+              accepted, failures);
+}
+
+template<typename Run>
+static void measure(const char *name, size_t bytes, int rounds, Run run) {
+  size_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < rounds; i++)
+    checksum += run();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::printf("  %-14s %9.1f MB/s   (%zu)\n", name, bytes * double(rounds) / seconds / 1e6, checksum % 10);
+}
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+  std::vector<std::pair<std::string, std::string>> corpora = {
+      {"twitter-like", twitterLike(600)}, {"canada-like", canadaLike(560)}, {"api body", apiBody()}};
+  for(int i = 2; i < argc; i++) {
+    std::ifstream file(argv[i], std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    corpora.emplace_back(argv[i], content.str());
+  }
+
+  differential(corpora);
+  if(failures)
+    return 1;
+
+  std::printf("runtime selection: %s\n", JSONTape::isaName(JSONTape::best()));
+  for(auto &[name, document] : corpora) {
+    std::printf("\n%s, %zu bytes\n", name.c_str(), document.size());
+    measure("recursive", document.size(), rounds, [&] { return RecursiveParser(document).parse().value.index(); });
+    measure("two-stage", document.size(), rounds, [&] { return JSONParser(document).parse().value.index(); });
+    JSONTape tape;
+    measure("tape only", document.size(), rounds, [&] {
+      tape.parse(document);
+      return tape.nodes().size();
+    });
+    std::pmr::vector<uint32_t> offsets;
+    for(JSONTape::Isa isa : {JSONTape::Isa::Scalar, JSONTape::Isa::SSE42, JSONTape::Isa::AVX2}) {
+      JSONTape::Indexer index = JSONTape::indexer(isa);
+      if(!index)
+        continue;
+      std::string label = std::string("index ") + JSONTape::isaName(isa);
+      measure(label.c_str(), document.size(), rounds, [&] {
+        index(document.data(), document.size(), offsets);
+        return offsets.size();
+      });
+    }
+
+    JSONValue parsed = JSONParser(document).parse();
+    size_t bytes = parsed.stringify().size();
+    measure("stringify old", bytes, rounds, [&] {
+      std::string out;
+      out.reserve(2048);
+      legacyStringify(parsed, out);
+      return out.size();
+    });
+    measure("stringify", bytes, rounds, [&] { return parsed.stringify().size(); });
+  }
+  return 0;
+}
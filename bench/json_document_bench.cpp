@@ -0,0 +1,109 @@
+// Measures what a handler pays to read three fields of a JSON request body: once through JSONParser, which builds
+// the whole JSONValue tree the way JsonBodyParser does, and once through JSONDocument, which indexes the body and
+// converts only the fields read, the way Request::json() does. The arena rows allocate from a fresh monotonic
+// buffer per request like the server's request arena, the others from the heap. The lookup rows read the same
+// fields from a body parsed beforehand, which is the cost of a lookup alone: a hash map walk against a scan of
+// the members on the tape.
+//
+// The fields sit at the start, in the middle behind a large array, and at the very end of the body. Before
+// measuring, every field read both ways has to match, and the JSONValue the document builds has to stringify
+// like the parsed one, otherwise the program ends with status 1.
+//
+// Usage: bench_json_document [rounds=20000] [lines=160]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+
+#include "json.h"
+
+static std::string orderBody(int lines) {
+  std::string out = "{\"order\":{\"id\":\"ord_4711\",\"customer\":{\"id\":42,\"email\":\"someone@example.com\","
+                    "\"name\":\"Some \\\"One\\\"\"},\"lines\":[";
+  for(int i = 0; i < lines; i++) {
+    out += i ? "," : "";
+    out += "{\"sku\":\"SKU-" + std::to_string(100000 + i * 37) + "\",\"title\":\"Item number " + std::to_string(i) +
+           "\",\"quantity\":" + std::to_string(1 + i % 5) + ",\"price\":" + std::to_string(i) +
+           ".99,\"tags\":[\"a\",\"b\"],\"gift\":" + (i % 7 ? "false" : "true") + "}";
+  }
+  out += "],\"currency\":\"EUR\",\"notes\":null,\"total\":12345.67}}";
+  return out;
+}
+
+struct Fields {
+  double customer = 0;
+  std::string currency;
+  double total = 0;
+
+  bool operator==(const Fields &other) const {
+    return customer == other.customer && currency == other.currency && total == other.total;
+  }
+};
+
+static Fields readEager(JSONValue &body) {
+  JSONValue &order = body["order"];
+  return {order["customer"]["id"].asDouble(), order["currency"].asString(), order["total"].asDouble()};
+}
+
+static Fields readLazy(const JSONDocument &body) {
+  JSONDocument::Element order = body["order"];
+  return {order["customer"]["id"].asDouble(), order["currency"].asString(), order["total"].asDouble()};
+}
+
+template<typename Run>
+static void measure(const char *name, int rounds, Run run) {
+  size_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < rounds; i++)
+    checksum += run().currency.size();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::printf("  %-18s %10.1f ns/request   (%zu)\n", name, seconds * 1e9 / rounds, checksum % 10);
+}
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? std::atoi(argv[1]) : 20000;
+  int lines = argc > 2 ? std::atoi(argv[2]) : 160;
+  std::string body = orderBody(lines);
+
+  JSONValue parsed = JSONParser(body).parse();
+  JSONDocument document;
+  document.parse(body);
+  if(!(readEager(parsed) == readLazy(document)) || document.root().toValue().stringify() != parsed.stringify() ||
+     document["order"]["customer"]["name"].asString() != "Some \"One\"" || document["order"]["lines"].size() != size_t(lines)) {
+    std::fprintf(stderr, "JSONDocument and JSONParser disagree\n");
+    return 1;
+  }
+
+  std::printf("order body, %zu bytes, 3 fields read\n", body.size());
+  measure("eager", rounds, [&] {
+    JSONValue value = JSONParser(body).parse();
+    return readEager(value);
+  });
+  measure("eager, arena", rounds, [&] {
+    std::pmr::monotonic_buffer_resource arena;
+    JSONValue value = JSONParser(body, &arena).parse();
+    return readEager(value);
+  });
+  measure("lazy", rounds, [&] {
+    JSONDocument lazy;
+    lazy.parse(body);
+    return readLazy(lazy);
+  });
+  measure("lazy, arena", rounds, [&] {
+    std::pmr::monotonic_buffer_resource arena;
+    JSONDocument lazy(&arena);
+    lazy.parse(body);
+    return readLazy(lazy);
+  });
+  measure("lazy, reused", rounds, [&] {
+    document.parse(body);
+    return readLazy(document);
+  });
+
+  std::printf("\nlookups in a parsed body\n");
+  measure("eager lookup", rounds * 50, [&] { return readEager(parsed); });
+  measure("lazy lookup", rounds * 50, [&] { return readLazy(document); });
+  return 0;
+}
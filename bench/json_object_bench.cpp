@@ -0,0 +1,179 @@
+// Compares JSONValue::Object, the members of an object in one vector with a hash table on top for objects
+// larger than JSONObject::INDEX_THRESHOLD, with the std::pmr::unordered_map it replaced.
+//
+// The memory part parses two documents, a list of many small records and a configuration with a few wide
+// objects, builds them once as JSONValue and once as a tree of unordered_maps, and counts every operator new of
+// the build. Both are sized up front the way the parser sizes them.
+//
+// The lookup part reads every member of objects of 2 to 256 members by a C-string key, the way handlers do. The
+// map rows look the key up through a std::string temporary, as JSONValue::operator[](const char*) did, and
+// through a prebuilt std::string, which is the map's own cost. Results are ns per lookup.
+//
+// Usage: bench_json_object [lookups=4000000]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "json.h"
+
+static unsigned long long allocations = 0;
+static unsigned long long allocatedBytes = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  allocatedBytes += size;
+  if(void *pointer = std::malloc(size ? size : 1))
+    return pointer;
+  throw std::bad_alloc();
+}
+
+// std::pmr::new_delete_resource() allocates through the aligned overloads.
+void* operator new(size_t size, std::align_val_t alignment) {
+  allocations++;
+  allocatedBytes += size;
+  size_t align = static_cast<size_t>(alignment);
+  if(void *pointer = std::aligned_alloc(align, (size + align - 1) / align * align))
+    return pointer;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+
+// JSONValue as it was with objects in a std::pmr::unordered_map.
+struct MapValue {
+  using Object = std::pmr::unordered_map<std::string, MapValue>;
+  using Array = std::pmr::vector<MapValue>;
+  std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value;
+};
+
+static MapValue toMap(const JSONValue &json) {
+  MapValue result;
+  if(const JSONValue::Object *object = std::get_if<JSONValue::Object>(&json.value)) {
+    MapValue::Object map;
+    map.reserve(object->size());
+    for(const auto &[key, value] : *object)
+      map.insert_or_assign(key, toMap(value));
+    result.value = std::move(map);
+  } else if(const JSONValue::Array *array = std::get_if<JSONValue::Array>(&json.value)) {
+    MapValue::Array values;
+    values.reserve(array->size());
+    for(const JSONValue &value : *array)
+      values.push_back(toMap(value));
+    result.value = std::move(values);
+  } else if(const std::string *text = std::get_if<std::string>(&json.value))
+    result.value = *text;
+  else if(const double *number = std::get_if<double>(&json.value))
+    result.value = *number;
+  else if(const bool *flag = std::get_if<bool>(&json.value))
+    result.value = *flag;
+  return result;
+}
+
+static std::string records(int count) {
+  std::string out = "[";
+  for(int i = 0; i < count; i++) {
+    out += i ? "," : "";
+    out += "{\"id\":" + std::to_string(i) + ",\"name\":\"user " + std::to_string(i) + "\",\"active\":" +
+           (i % 3 ? "true" : "false") + ",\"score\":" + std::to_string(i * 7 % 100) + ".5,\"role\":\"member\"," +
+           "\"team\":{\"id\":" + std::to_string(i % 10) + ",\"name\":\"team\"},\"tags\":[\"a\",\"b\"]}";
+  }
+  return out + "]";
+}
+
+static std::string configuration(int sections, int keys) {
+  std::string out = "{";
+  for(int s = 0; s < sections; s++) {
+    out += s ? "," : "";
+    out += "\"section_" + std::to_string(s) + "\":{";
+    for(int k = 0; k < keys; k++)
+      out += (k ? ",\"" : "\"") + std::string("setting_") + std::to_string(k) + "\":" + std::to_string(k);
+    out += "}";
+  }
+  return out + "}";
+}
+
+static std::vector<std::string> keysOf(size_t members) {
+  static const char *const STEMS[] = {"id", "name", "email", "created_at", "updated_at", "customer_reference", "x"};
+  std::vector<std::string> keys;
+  for(size_t i = 0; i < members; i++)
+    keys.push_back(STEMS[i % 7] + (i < 7 ? std::string() : "_" + std::to_string(i)));
+  return keys;
+}
+
+template<typename Lookup>
+static double measure(size_t lookups, const std::vector<std::string> &keys, Lookup lookup) {
+  double checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(size_t done = 0; done < lookups; done += keys.size()) {
+    for(const std::string &key : keys)
+      checksum += lookup(key.c_str());
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if(checksum < 0)
+    std::printf("%f", checksum);
+  return seconds * 1e9 / lookups;
+}
+
+int main(int argc, char **argv) {
+  size_t lookups = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+
+  std::printf("memory per document      %12s %12s %12s %12s\n", "map KB", "map allocs", "flat KB", "flat allocs");
+  std::pair<const char *, std::string> documents[] = {{"records(2000)", records(2000)},
+                                                     {"config(8 x 200)", configuration(8, 200)}};
+  for(const auto &[name, text] : documents) {
+    JSONDocument document;
+    document.parse(text);
+    unsigned long long bytes = allocatedBytes, count = allocations;
+    JSONValue flat = document.root().toValue();
+    unsigned long long flatBytes = allocatedBytes - bytes, flatCount = allocations - count;
+    bytes = allocatedBytes, count = allocations;
+    MapValue map = toMap(flat);
+    unsigned long long mapBytes = allocatedBytes - bytes, mapCount = allocations - count;
+    std::printf("  %-22s %12.1f %12llu %12.1f %12llu\n", name, mapBytes / 1024.0, mapCount, flatBytes / 1024.0,
+                flatCount);
+  }
+
+  std::printf("\nns per lookup  %10s %16s %10s %10s %10s\n", "members", "map, temporary", "map", "flat", "flat find");
+  for(size_t members : {2, 4, 8, 16, 32, 64, 256}) {
+    std::vector<std::string> keys = keysOf(members);
+    JSONValue flat = JSONValue::Object();
+    MapValue::Object map;
+    for(size_t i = 0; i < members; i++) {
+      flat[keys[i]] = double(i);
+      map[keys[i]].value = double(i);
+    }
+    double temporary = measure(lookups, keys, [&](const char *key) {
+      std::string copy(key);
+      return std::get<double>(map.find(copy)->second.value);
+    });
+    double prebuilt = 0;
+    {
+      size_t at = 0;
+      prebuilt = measure(lookups, keys, [&](const char *) {
+        const std::string &key = keys[at++ % keys.size()];
+        return std::get<double>(map.find(key)->second.value);
+      });
+    }
+    double flatLookup = measure(lookups, keys, [&](const char *key) { return flat[key].asDouble(); });
+    const JSONValue::Object &object = std::get<JSONValue::Object>(flat.value);
+    double flatFind = measure(lookups, keys, [&](const char *key) { return std::get<double>(object.find(key)->second.value); });
+    std::printf("  %26zu %16.2f %10.2f %10.2f %10.2f\n", members, temporary, prebuilt, flatLookup, flatFind);
+  }
+  return 0;
+}
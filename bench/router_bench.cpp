@@ -0,0 +1,223 @@
+// Measures route lookup. The baseline is the router before RouteTree: a trie of shared_ptr nodes with one
+// unordered_map of children per node, walked twice per request to build the normalized pattern and once more
+// for the path parameters, every walk splitting the path into freshly allocated strings, followed by a hash
+// lookup of "METHOD::pattern". The radix rows run RouteTree::match, once alone and once together with the
+// method check and filling the path parameter map the way HttpServer::findRoute does. The frozen rows repeat
+// that after RouteTree::freeze(), which answers static paths from a perfect hash table. The snapshot row adds
+// what HttpServer does around a lookup since routes can change at runtime: entering an epoch read section and
+// loading the published table through an atomic pointer. Every row runs over all request paths and over the
+// static ones alone.
+//
+// Usage: bench_router [rounds=200000]
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "epochdomain.h"
+#include "httpmethod.h"
+#include "routetree.h"
+#include "utils.h"
+
+struct Endpoint {
+  const char *method;
+  const char *pattern;
+};
+
+static const Endpoint ENDPOINTS[] = {
+    {"GET", "/"}, {"GET", "/health"}, {"GET", "/metrics"}, {"GET", "/v1/items"}, {"POST", "/v1/items"},
+    {"GET", "/v1/items/:id"}, {"PUT", "/v1/items/:id"}, {"DELETE", "/v1/items/:id"}, {"GET", "/v1/items/:id/reviews"},
+    {"GET", "/v1/items/:id/reviews/:review"}, {"GET", "/v1/items/featured"}, {"GET", "/v1/users"},
+    {"POST", "/v1/users"}, {"GET", "/v1/users/me"}, {"GET", "/v1/users/:id"}, {"PATCH", "/v1/users/:id"},
+    {"GET", "/v1/users/:id/orders"}, {"GET", "/v1/users/:id/orders/:order"}, {"GET", "/v1/users/:id/settings"},
+    {"GET", "/v1/orders"}, {"POST", "/v1/orders"}, {"GET", "/v1/orders/:id"}, {"POST", "/v1/orders/:id/cancel"},
+    {"GET", "/v1/orders/:id/invoice"}, {"GET", "/v1/search"}, {"GET", "/v1/categories"},
+    {"GET", "/v1/categories/:slug"}, {"GET", "/v1/categories/:slug/items"}, {"POST", "/v1/auth/login"},
+    {"POST", "/v1/auth/logout"}, {"POST", "/v1/auth/refresh"}, {"GET", "/v2/items"}, {"GET", "/v2/items/:id"},
+    {"GET", "/static/:file"}, {"GET", "/docs"}, {"GET", "/docs/:page"}};
+
+using Requests = std::vector<std::pair<std::string, std::string>>;
+
+static const Requests REQUESTS = {
+    {"GET", "/health"}, {"GET", "/v1/items"}, {"GET", "/v1/items/48151623"}, {"GET", "/v1/items/48151623/reviews/42"},
+    {"GET", "/v1/users/me"}, {"GET", "/v1/users/1337/orders/99"}, {"POST", "/v1/orders/7/cancel"},
+    {"GET", "/v1/categories/garden-tools/items"}, {"GET", "/static/app.3f9a2c.js"}, {"GET", "/v1/unknown/path"}};
+
+static const Requests STATIC_REQUESTS = {
+    {"GET", "/health"}, {"GET", "/v1/items"}, {"GET", "/v1/users/me"}, {"POST", "/v1/auth/login"}, {"GET", "/docs"}};
+
+// The router before RouteTree, as it was.
+class SplitTrie {
+  struct Trie {
+    std::unordered_map<std::string, std::shared_ptr<Trie>> children;
+    std::shared_ptr<Trie> paramChild;
+    std::string paramName;
+    bool isEndOfPath = false;
+  };
+  std::shared_ptr<Trie> root = std::make_shared<Trie>();
+
+public:
+  void addPath(const std::string &path) {
+    auto node = root;
+    for(const auto &segment : split(path, '/')) {
+      if(!segment.empty() && segment[0] == ':') {
+        if(!node->paramChild) {
+          node->paramChild = std::make_shared<Trie>();
+          node->paramChild->paramName = segment.substr(1);
+        }
+        node = node->paramChild;
+      } else {
+        if(node->children.find(segment) == node->children.end())
+          node->children[segment] = std::make_shared<Trie>();
+        node = node->children[segment];
+      }
+    }
+    node->isEndOfPath = true;
+  }
+
+  void getPathParams(const std::string &path, std::unordered_map<std::string, std::string> &params) {
+    std::shared_ptr<Trie> node = root;
+    params.clear();
+    for(const auto &segment : split(path, '/')) {
+      if(node->children.find(segment) != node->children.end()) {
+        node = node->children[segment];
+      } else if(node->paramChild) {
+        params[node->paramChild->paramName] = segment;
+        node = node->paramChild;
+      } else {
+        params.clear();
+        return;
+      }
+    }
+    if(!node->isEndOfPath)
+      params.clear();
+  }
+
+  std::string getNormalisedPath(const std::string &path) {
+    auto node = root;
+    std::string normalisedPath = "/";
+    for(const auto &segment : split(path, '/')) {
+      if(node->children.find(segment) != node->children.end()) {
+        normalisedPath.push_back('/');
+        normalisedPath.append(segment);
+        node = node->children[segment];
+      } else if(node->paramChild) {
+        normalisedPath.append("/:");
+        normalisedPath.append(node->paramChild->paramName);
+        node = node->paramChild;
+      } else {
+        return "";
+      }
+    }
+    if(!node->isEndOfPath)
+      return "";
+    return normalisedPath.size() > 1 ? normalisedPath.substr(1) : normalisedPath;
+  }
+};
+
+template<typename Lookup>
+static double run(const Requests &requests, int rounds, Lookup &lookup, size_t &checksum) {
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < rounds; i++) {
+    for(const auto &[method, path] : requests)
+      checksum += lookup(method, path);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return seconds * 1e9 / (static_cast<double>(rounds) * requests.size());
+}
+
+template<typename Lookup>
+static void measure(const char *name, int rounds, Lookup lookup) {
+  size_t checksum = 0;
+  double all = run(REQUESTS, rounds, lookup, checksum);
+  double statics = run(STATIC_REQUESTS, rounds, lookup, checksum);
+  std::printf("  %-14s %12.1f %12.1f   (%zu)\n", name, all, statics, checksum % 10);
+}
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+  SplitTrie trie;
+  std::unordered_map<std::string, int> routes;
+  RouteTree tree;
+  std::vector<std::array<const std::vector<std::string>*, HTTP_METHOD_COUNT>> endpoints;
+  std::vector<std::vector<std::string>> names(std::size(ENDPOINTS));
+  for(size_t i = 0; i < std::size(ENDPOINTS); i++) {
+    const Endpoint &endpoint = ENDPOINTS[i];
+    trie.addPath(endpoint.pattern);
+    routes[std::string(endpoint.method) + "::" + endpoint.pattern] = static_cast<int>(routes.size());
+
+    uint32_t handle = tree.insert(endpoint.pattern, &names[i]);
+    if(handle == endpoints.size())
+      endpoints.emplace_back();
+    endpoints[handle][static_cast<size_t>(lookupHttpMethod(endpoint.method))] = &names[i];
+  }
+
+  std::printf("%zu routes, %zu request paths, %zu of them static\n", std::size(ENDPOINTS), REQUESTS.size(),
+              STATIC_REQUESTS.size());
+  std::printf("  %-14s %12s %12s   ns/lookup\n", "", "all paths", "static");
+  std::unordered_map<std::string, std::string> params;
+  measure("split trie", rounds, [&](const std::string &method, const std::string &path) -> size_t {
+    std::string pattern = trie.getNormalisedPath(path);
+    if(pattern.empty())
+      return 0;
+    auto it = routes.find(method + "::" + pattern);
+    if(it == routes.end())
+      return 0;
+    trie.getPathParams(path, params);
+    return it->second + params.size();
+  });
+
+  auto match = [&](const std::string &, const std::string &path) -> size_t {
+    RouteTree::Match match;
+    return tree.match(path, match) ? match.route + match.parameterCount : 0;
+  };
+  auto matchWithParameters = [&](const std::string &method, const std::string &path) -> size_t {
+    RouteTree::Match match;
+    HttpMethod id = lookupHttpMethod(method);
+    params.clear();
+    if(id == HttpMethod::Unknown || !tree.match(path, match))
+      return 0;
+    const std::vector<std::string> *parameterNames = endpoints[match.route][static_cast<size_t>(id)];
+    if(!parameterNames)
+      return 0;
+    for(size_t i = 0; i < match.parameterCount; i++)
+      params.insert_or_assign((*parameterNames)[i], std::string(match.parameters[i]));
+    return match.route + params.size();
+  };
+
+  measure("radix", rounds, match);
+  measure("radix+params", rounds, matchWithParameters);
+  tree.freeze();
+  measure("frozen", rounds, match);
+  measure("frozen+params", rounds, matchWithParameters);
+
+  EpochDomain epochs;
+  EpochDomain::Reader &reader = epochs.registerReader();
+  std::atomic<const RouteTree*> published{&tree};
+  measure("snapshot", rounds, [&](const std::string &method, const std::string &path) -> size_t {
+    reader.enter();
+    const RouteTree *snapshot = published.load(std::memory_order_seq_cst);
+    RouteTree::Match match;
+    HttpMethod id = lookupHttpMethod(method);
+    params.clear();
+    size_t result = 0;
+    if(id != HttpMethod::Unknown && snapshot->match(path, match) && endpoints[match.route][static_cast<size_t>(id)]) {
+      const std::vector<std::string> &parameterNames = *endpoints[match.route][static_cast<size_t>(id)];
+      for(size_t i = 0; i < match.parameterCount; i++)
+        params.insert_or_assign(parameterNames[i], std::string(match.parameters[i]));
+      result = match.route + params.size();
+    }
+    reader.leave();
+    return result;
+  });
+  return 0;
+}
@@ -0,0 +1,118 @@
+// Compares the work-stealing scheduler the server runs its workers on against the single mutex/condvar
+// queue it replaced. Producer threads stand in for the reactors and submit small tasks, the workers
+// spend a fixed amount of work on every task. Reported are tasks per second for 1 to 64 workers.
+//
+// Usage: bench_scheduler [tasks=1000000] [producers=2] [work per task=200]
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "workscheduler.h"
+
+struct Task {
+  bool stop = false;
+  unsigned work = 0;
+};
+
+static std::atomic<unsigned long long> sink{0};
+
+static void runTask(const Task &task) {
+  unsigned long long value = task.work;
+  for(unsigned i = 0; i < task.work; i++)
+    value = value * 6364136223846793005ull + 1442695040888963407ull;
+  sink.fetch_add(value & 1, std::memory_order_relaxed);
+}
+
+// The queue the server used before: one std::queue, one mutex, notify_one on every push.
+class MutexQueue {
+  std::queue<std::unique_ptr<Task>> queue;
+  std::mutex mutex;
+  std::condition_variable variable;
+
+public:
+  explicit MutexQueue(size_t) {}
+
+  void submit(std::unique_ptr<Task> task, size_t) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push(std::move(task));
+    }
+    variable.notify_one();
+  }
+
+  std::unique_ptr<Task> next(size_t) {
+    std::unique_lock<std::mutex> lock(mutex);
+    variable.wait(lock, [&]() { return !queue.empty(); });
+    std::unique_ptr<Task> task = std::move(queue.front());
+    queue.pop();
+    return task;
+  }
+};
+
+template<typename Queue>
+static double run(unsigned workers, unsigned producers, unsigned long long tasks, unsigned work) {
+  Queue queue(workers);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+
+  for(unsigned i = 0; i < workers; i++) {
+    threads.emplace_back([&queue, i]() {
+      while(true) {
+        std::unique_ptr<Task> task = queue.next(i);
+        if(task->stop)
+          return;
+        runTask(*task);
+      }
+    });
+  }
+
+  std::vector<std::thread> submitters;
+  for(unsigned p = 0; p < producers; p++) {
+    submitters.emplace_back([&, p]() {
+      unsigned long long count = tasks / producers + (p < tasks % producers ? 1 : 0);
+      for(unsigned long long i = 0; i < count; i++) {
+        std::unique_ptr<Task> task = std::make_unique<Task>();
+        task->work = work;
+        queue.submit(std::move(task), i * producers + p);
+      }
+    });
+  }
+  for(std::thread &submitter : submitters)
+    submitter.join();
+
+  // Every worker leaves after exactly one stop task, so all of them get one.
+  for(unsigned i = 0; i < workers; i++) {
+    std::unique_ptr<Task> task = std::make_unique<Task>();
+    task->stop = true;
+    queue.submit(std::move(task), i);
+  }
+  for(std::thread &thread : threads)
+    thread.join();
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return tasks / seconds;
+}
+
+int main(int argc, char **argv) {
+  unsigned long long tasks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  unsigned producers = argc > 2 ? std::atoi(argv[2]) : 2;
+  unsigned work = argc > 3 ? std::atoi(argv[3]) : 200;
+
+  std::printf("%llu tasks, %u producers, %u rounds of work per task, %u hardware threads\n\n", tasks, producers,
+              work, std::thread::hardware_concurrency());
+  std::printf("%8s %16s %16s %9s\n", "workers", "mutex tasks/s", "stealing tasks/s", "speedup");
+  for(unsigned workers = 1; workers <= 64; workers *= 2) {
+    double locked = run<MutexQueue>(workers, producers, tasks, work);
+    double stealing = run<WorkScheduler<Task>>(workers, producers, tasks, work);
+    std::printf("%8u %16.0f %16.0f %8.2fx\n", workers, locked, stealing, stealing / locked);
+  }
+  return 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+/**
+ * @brief Monotonic memory for the containers of one request and its response.
+ *
+ * The first INLINE_SIZE bytes live inside the arena itself, so a typical request never reaches the global
+ * allocator. Nothing is freed individually, everything goes at once when the arena is destroyed.
+ */
+class RequestArena {
+public:
+  static constexpr size_t INLINE_SIZE = 4096;
+
+  RequestArena() = default;
+  RequestArena(const RequestArena&) = delete;
+  RequestArena& operator=(const RequestArena&) = delete;
+
+  inline std::pmr::memory_resource* resource() { return &monotonic; }
+
+private:
+  alignas(std::max_align_t) std::byte storage[INLINE_SIZE];
+  std::pmr::monotonic_buffer_resource monotonic{storage, INLINE_SIZE, std::pmr::new_delete_resource()};
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Connection objects indexed by a small integer handle, a socket descriptor or a slot given out by insert().
+ *
+ * Lookups are one array access. Objects of closed connections are reset and kept on a free list, so a
+ * steady stream of short connections costs no allocations once the slab has grown to the peak number of
+ * connections. Not thread-safe, a slab belongs to the one thread that drives its connections.
+ */
+template<typename T>
+class ConnectionSlab {
+  std::vector<std::unique_ptr<T>> slots;
+  std::vector<std::unique_ptr<T>> spare;  ///< Reset objects of closed connections, reused by the next one.
+  std::vector<size_t> freeKeys;           ///< Keys released by erase(), handed out again by insert().
+  size_t count = 0;
+
+public:
+  /**
+   * @return T* The object stored under key, or nullptr if there is none.
+   */
+  inline T* find(size_t key) const { return key < slots.size() ? slots[key].get() : nullptr; }
+
+  /**
+   * @brief Gets the object stored under key, creating a fresh one if there is none.
+   */
+  T& emplace(size_t key) {
+    if(key >= slots.size())
+      slots.resize(std::max(key + 1, slots.size() * 2));
+    if(!slots[key]) {
+      if(spare.empty()) {
+        slots[key] = std::make_unique<T>();
+      } else {
+        slots[key] = std::move(spare.back());
+        spare.pop_back();
+      }
+      count++;
+    }
+    return *slots[key];
+  }
+
+  /**
+   * @brief Stores a fresh object under the lowest free key, for handles that are not small integers themselves.
+   *
+   * @return size_t The key of the new object.
+   */
+  size_t insert() {
+    size_t key = slots.size();
+    while(!freeKeys.empty()) {
+      size_t candidate = freeKeys.back();
+      freeKeys.pop_back();
+      if(candidate < slots.size() && !slots[candidate]) {
+        key = candidate;
+        break;
+      }
+    }
+    emplace(key);
+    return key;
+  }
+
+  /**
+   * @brief Removes the object stored under key, it is reset and kept for reuse.
+   */
+  void erase(size_t key) {
+    if(key >= slots.size() || !slots[key])
+      return;
+    *slots[key] = T();
+    spare.push_back(std::move(slots[key]));
+    freeKeys.push_back(key);
+    count--;
+  }
+
+  /**
+   * @brief Calls function(key, object) for every stored object.
+   */
+  template<typename Function>
+  void forEach(Function function) {
+    for(size_t key = 0; key < slots.size(); key++) {
+      if(slots[key])
+        function(key, *slots[key]);
+    }
+  }
+
+  /**
+   * @brief Removes every object and frees all memory of the slab.
+   */
+  void clear() {
+    slots.clear();
+    spare.clear();
+    freeKeys.clear();
+    count = 0;
+  }
+
+  inline size_t size() const { return count; }
+};
+
+/**
+ * @brief Spare I/O buffers shared by the connections of one thread.
+ *
+ * A connection that goes idle hands its buffers back instead of holding on to them, so memory stays with
+ * the connections that are actually transferring data. Buffers keep their capacity while pooled, buffers
+ * that grew beyond maxCapacity are freed instead. Not thread-safe.
+ *
+ * @tparam Buffer A container with capacity(), e.g. std::string or std::vector.
+ */
+template<typename Buffer>
+class BufferPool {
+  std::vector<Buffer> spare;
+  size_t limit;
+  size_t maxCapacity;
+
+  static inline bool ownsMemory(const Buffer &buffer) { return buffer.capacity() > Buffer().capacity(); }
+
+public:
+  /**
+   * @param limit Maximum number of pooled buffers.
+   * @param maxCapacity Buffers with a larger capacity are freed instead of pooled.
+   */
+  BufferPool(size_t limit, size_t maxCapacity) : limit(limit), maxCapacity(maxCapacity) {}
+
+  /**
+   * @brief Gives an empty buffer pooled memory, unless it already has memory of its own or the pool is empty.
+   */
+  void acquire(Buffer &buffer) {
+    if(ownsMemory(buffer) || !buffer.empty() || spare.empty())
+      return;
+    buffer = std::move(spare.back());
+    spare.pop_back();
+  }
+
+  /**
+   * @brief Takes the memory of buffer, leaving it empty. The contents are kept, clear the buffer first if needed.
+   */
+  void release(Buffer &buffer) {
+    if(!ownsMemory(buffer))
+      return;
+    if(spare.size() < limit && buffer.capacity() <= maxCapacity)
+      spare.push_back(std::move(buffer));
+    buffer = Buffer();
+  }
+
+  inline size_t size() const { return spare.size(); }
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Epoch based reclamation for data that readers reach through an atomic pointer, RCU style.
+ *
+ * Every reading thread owns a Reader and wraps its use of the shared data in enter() and leave(). A writer
+ * publishes a replacement with one atomic exchange and retires the old object, which is deleted once no reader
+ * that could still see it is inside a read section. Readers never wait and never touch a shared cache line:
+ * enter() copies the global epoch into the reader's own slot, leave() clears it. Writers are expected to be rare
+ * and serialized by the caller, retired objects are collected on the next retire() or by collect().
+ */
+class EpochDomain {
+public:
+  class alignas(64) Reader {
+  public:
+    explicit Reader(const EpochDomain &domain) : domain(domain) {}
+
+    /**
+     * @brief Starts a read section, pointers loaded afterwards stay valid until leave().
+     */
+    inline void enter() {
+      // Sequentially consistent, so the store is visible before the reader loads any published pointer.
+      active.store(domain.epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+    }
+
+    inline void leave() { active.store(0, std::memory_order_release); }
+
+  private:
+    friend class EpochDomain;
+
+    std::atomic<uint64_t> active{0};  ///< Epoch seen when the current read section started, 0 outside of one.
+    const EpochDomain &domain;
+  };
+
+  /**
+   * @brief A read section of a reader, left when it goes out of scope, also by an exception.
+   */
+  class Section {
+  public:
+    explicit Section(Reader &reader) : reader(reader) { reader.enter(); }
+    ~Section() { reader.leave(); }
+    Section(const Section&) = delete;
+    Section& operator=(const Section&) = delete;
+
+  private:
+    Reader &reader;
+  };
+
+  EpochDomain() = default;
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  ~EpochDomain() {
+    for(auto &[epoch, deleter] : retired)
+      deleter();
+  }
+
+  /**
+   * @brief Adds a reader, it lives as long as the domain.
+   */
+  Reader& registerReader() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return readers.emplace_back(*this);
+  }
+
+  /**
+   * @brief Hands over an object that was replaced by an atomic exchange, it is deleted once unreachable.
+   */
+  template<typename T>
+  void retire(const T *object) {
+    if(!object)
+      return;
+    std::lock_guard<std::mutex> lock(mutex);
+    // Readers entering from here on see the new epoch, and they can only load the replacement.
+    uint64_t retiredAt = epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    retired.emplace_back(retiredAt, [object]() { delete object; });
+    collectLocked();
+  }
+
+  /**
+   * @brief Deletes the retired objects no reader can see anymore.
+   */
+  void collect() {
+    std::lock_guard<std::mutex> lock(mutex);
+    collectLocked();
+  }
+
+  inline size_t pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return retired.size();
+  }
+
+private:
+  std::atomic<uint64_t> epoch{1};
+  mutable std::mutex mutex;  ///< Guards readers and retired.
+  std::deque<Reader> readers;
+  std::vector<std::pair<uint64_t, std::function<void()>>> retired;  ///< Epoch of retirement and deleter.
+
+  void collectLocked() {
+    // An object retired at epoch e may be in use by readers that entered before e.
+    uint64_t oldest = UINT64_MAX;
+    for(const Reader &reader : readers) {
+      uint64_t active = reader.active.load(std::memory_order_seq_cst);
+      if(active != 0 && active < oldest)
+        oldest = active;
+    }
+    size_t kept = 0;
+    for(size_t i = 0; i < retired.size(); i++) {
+      if(retired[i].first <= oldest)
+        retired[i].second();
+      else
+        retired[kept++] = std::move(retired[i]);
+    }
+    retired.resize(kept);
+  }
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+
+#include "platform.h"
+
+/**
+ * @brief Small cache of open file descriptors and their metadata for static file responses.
+ *
+ * Lookups happen on worker threads, so opening and stat()ing files never stalls the IO side. An entry
+ * is trusted for REVALIDATE_INTERVAL, after that the path is stat()ed again and reopened when the file
+ * changed. Handed out files stay open for as long as a response still references them.
+ */
+class FileCache {
+public:
+  /**
+   * @brief Identity of a file version, a changed stamp means the cached descriptor is stale.
+   */
+  struct Stamp {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    int64_t modified = 0;
+    uint64_t size = 0;
+
+    bool operator==(const Stamp &other) const = default;
+  };
+
+  /**
+   * @brief One open file, closed when the last reference is dropped.
+   */
+  class File {
+  public:
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+    const char *mapping = nullptr;  ///< Read-only mapping of the contents, only set when the cache maps files.
+#endif
+    size_t size = 0;
+    Stamp stamp;
+
+    File() = default;
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+    ~File();
+  };
+
+  /**
+   * @param capacity Maximum number of files kept open.
+   */
+  explicit FileCache(size_t capacity = 64) : capacity(capacity) {}
+
+  /**
+   * @brief Gets an open regular file, from the cache when it is still current.
+   *
+   * @param path Path of the file.
+   * @return std::shared_ptr<const File> The file, or nullptr if it does not exist or is not a regular file.
+   */
+  std::shared_ptr<const File> open(const std::string &path);
+
+  /**
+   * @brief Makes files opened from now on also carry a read-only mapping of their contents.
+   */
+  inline void setMapContents(bool map) { mapContents = map; }
+
+private:
+  struct Entry {
+    std::shared_ptr<const File> file;
+    std::chrono::steady_clock::time_point validatedAt;
+    unsigned long long lastUsed = 0;
+  };
+
+  static constexpr std::chrono::seconds REVALIDATE_INTERVAL{1};
+
+  std::mutex mutex;
+  std::unordered_map<std::string, Entry> entries;
+  size_t capacity;
+  unsigned long long useCounter = 0;
+  bool mapContents = false;
+
+  /**
+   * @brief Reads the current stamp of a path.
+   *
+   * @return bool false if the path is missing or not a regular file.
+   */
+  static bool statPath(const std::string &path, Stamp &stamp);
+
+  std::shared_ptr<const File> openFile(const std::string &path) const;
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief Header names the server knows by heart.
+ *
+ * Requests and responses keep these in fixed slots indexed by the enum, so looking one up costs a
+ * perfect hash of the name instead of hashing and comparing std::strings. Names not listed here are
+ * custom headers and live in the fallback map. Keep the order in sync with HTTP_HEADER_NAMES.
+ */
+enum class HttpHeader : uint8_t {
+  Accept,
+  AcceptCharset,
+  AcceptEncoding,
+  AcceptLanguage,
+  AcceptRanges,
+  AccessControlAllowCredentials,
+  AccessControlAllowHeaders,
+  AccessControlAllowMethods,
+  AccessControlAllowOrigin,
+  AccessControlExposeHeaders,
+  AccessControlMaxAge,
+  AccessControlRequestHeaders,
+  AccessControlRequestMethod,
+  Age,
+  Allow,
+  Authorization,
+  CacheControl,
+  Connection,
+  ContentDisposition,
+  ContentEncoding,
+  ContentLanguage,
+  ContentLength,
+  ContentLocation,
+  ContentRange,
+  ContentSecurityPolicy,
+  ContentType,
+  Cookie,
+  Date,
+  ETag,
+  Expect,
+  Expires,
+  Forwarded,
+  From,
+  Host,
+  IfMatch,
+  IfModifiedSince,
+  IfNoneMatch,
+  IfRange,
+  IfUnmodifiedSince,
+  KeepAlive,
+  LastModified,
+  Link,
+  Location,
+  MaxForwards,
+  Origin,
+  Pragma,
+  ProxyAuthenticate,
+  ProxyAuthorization,
+  Range,
+  Referer,
+  RetryAfter,
+  SecFetchDest,
+  SecFetchMode,
+  SecFetchSite,
+  SecFetchUser,
+  Server,
+  SetCookie,
+  StrictTransportSecurity,
+  TE,
+  Trailer,
+  TransferEncoding,
+  Upgrade,
+  UpgradeInsecureRequests,
+  UserAgent,
+  Vary,
+  Via,
+  WWWAuthenticate,
+  XContentTypeOptions,
+  XForwardedFor,
+  XForwardedHost,
+  XForwardedProto,
+  XFrameOptions,
+  XRequestedWith,
+  XRequestId,
+  Unknown  ///< Not a well-known header, also the number of well-known ones.
+};
+
+inline constexpr size_t HTTP_HEADER_COUNT = static_cast<size_t>(HttpHeader::Unknown);
+
+/**
+ * @brief Canonical spelling of every HttpHeader, the one responses are written with.
+ */
+inline constexpr std::array<std::string_view, HTTP_HEADER_COUNT> HTTP_HEADER_NAMES = {
+  "Accept", "Accept-Charset", "Accept-Encoding", "Accept-Language", "Accept-Ranges",
+  "Access-Control-Allow-Credentials", "Access-Control-Allow-Headers", "Access-Control-Allow-Methods",
+  "Access-Control-Allow-Origin", "Access-Control-Expose-Headers", "Access-Control-Max-Age",
+  "Access-Control-Request-Headers", "Access-Control-Request-Method", "Age", "Allow", "Authorization",
+  "Cache-Control", "Connection", "Content-Disposition", "Content-Encoding", "Content-Language",
+  "Content-Length", "Content-Location", "Content-Range", "Content-Security-Policy", "Content-Type", "Cookie",
+  "Date", "ETag", "Expect", "Expires", "Forwarded", "From", "Host", "If-Match", "If-Modified-Since",
+  "If-None-Match", "If-Range", "If-Unmodified-Since", "Keep-Alive", "Last-Modified", "Link", "Location",
+  "Max-Forwards", "Origin", "Pragma", "Proxy-Authenticate", "Proxy-Authorization", "Range", "Referer",
+  "Retry-After", "Sec-Fetch-Dest", "Sec-Fetch-Mode", "Sec-Fetch-Site", "Sec-Fetch-User", "Server",
+  "Set-Cookie", "Strict-Transport-Security", "TE", "Trailer", "Transfer-Encoding", "Upgrade",
+  "Upgrade-Insecure-Requests", "User-Agent", "Vary", "Via", "WWW-Authenticate", "X-Content-Type-Options",
+  "X-Forwarded-For", "X-Forwarded-Host", "X-Forwarded-Proto", "X-Frame-Options", "X-Requested-With",
+  "X-Request-Id"
+};
+
+/**
+ * @brief Compile-time perfect hash from case-insensitive header names to HttpHeader.
+ *
+ * A seeded FNV-1a over the lowercased name picks one of TABLE_SIZE slots, the seed is searched at compile
+ * time until every well-known name gets a slot of its own. A lookup is one hash, one table read and one
+ * case-insensitive comparison against the only candidate.
+ */
+class HttpHeaderHash {
+public:
+  static constexpr size_t TABLE_SIZE = 512;
+
+  static constexpr uint32_t hash(std::string_view name, uint32_t seed) {
+    uint32_t value = 2166136261u ^ seed;
+    for(char c : name)
+      value = (value ^ static_cast<uint8_t>(lower(c))) * 16777619u;
+    return (value ^ (value >> 15)) & (TABLE_SIZE - 1);
+  }
+
+  static constexpr char lower(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c; }
+
+  static constexpr bool equalsLowered(std::string_view name, std::string_view canonical) {
+    if(name.size() != canonical.size())
+      return false;
+    for(size_t i = 0; i < name.size(); i++) {
+      if(lower(name[i]) != lower(canonical[i]))
+        return false;
+    }
+    return true;
+  }
+
+  static constexpr bool collisionFree(uint32_t seed) {
+    std::array<bool, TABLE_SIZE> used{};
+    for(std::string_view name : HTTP_HEADER_NAMES) {
+      uint32_t slot = hash(name, seed);
+      if(used[slot])
+        return false;
+      used[slot] = true;
+    }
+    return true;
+  }
+
+  static constexpr uint32_t findSeed() {
+    for(uint32_t seed = 0; seed < 100000; seed++) {
+      if(collisionFree(seed))
+        return seed;
+    }
+    return UINT32_MAX;
+  }
+
+  /**
+   * @brief Slot to header index plus one, 0 for free slots.
+   */
+  static constexpr std::array<uint8_t, TABLE_SIZE> buildTable(uint32_t seed) {
+    std::array<uint8_t, TABLE_SIZE> table{};
+    for(size_t i = 0; i < HTTP_HEADER_COUNT; i++)
+      table[hash(HTTP_HEADER_NAMES[i], seed)] = static_cast<uint8_t>(i + 1);
+    return table;
+  }
+};
+
+inline constexpr uint32_t HTTP_HEADER_SEED = HttpHeaderHash::findSeed();
+static_assert(HTTP_HEADER_SEED != UINT32_MAX, "no perfect hash seed for the well-known header names");
+
+inline constexpr std::array<uint8_t, HttpHeaderHash::TABLE_SIZE> HTTP_HEADER_TABLE =
+    HttpHeaderHash::buildTable(HTTP_HEADER_SEED);
+
+/**
+ * @brief Identifies a header name, ignoring case.
+ *
+ * @return HttpHeader The well-known header, HttpHeader::Unknown for custom ones.
+ */
+constexpr HttpHeader lookupHttpHeader(std::string_view name) {
+  uint8_t entry = HTTP_HEADER_TABLE[HttpHeaderHash::hash(name, HTTP_HEADER_SEED)];
+  if(entry == 0 || !HttpHeaderHash::equalsLowered(name, HTTP_HEADER_NAMES[entry - 1]))
+    return HttpHeader::Unknown;
+  return static_cast<HttpHeader>(entry - 1);
+}
+
+/**
+ * @return std::string_view The canonical name of a well-known header.
+ */
+constexpr std::string_view httpHeaderName(HttpHeader header) {
+  return HTTP_HEADER_NAMES[static_cast<size_t>(header)];
+}
+
+static_assert(!HTTP_HEADER_NAMES.back().empty(), "every HttpHeader needs a name");
+static_assert(httpHeaderName(HttpHeader::TransferEncoding) == "Transfer-Encoding");
+static_assert(lookupHttpHeader("content-length") == HttpHeader::ContentLength);
+static_assert(lookupHttpHeader("X-REQUEST-ID") == HttpHeader::XRequestId);
+static_assert(lookupHttpHeader("X-Custom") == HttpHeader::Unknown);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief The request methods of RFC 9110 plus PATCH, routes are indexed by it.
+ */
+enum class HttpMethod : uint8_t {
+  Get,
+  Head,
+  Post,
+  Put,
+  Delete,
+  Connect,
+  Options,
+  Trace,
+  Patch,
+  Unknown  ///< Any other method, also the number of known ones.
+};
+
+inline constexpr size_t HTTP_METHOD_COUNT = static_cast<size_t>(HttpMethod::Unknown);
+
+inline constexpr std::array<std::string_view, HTTP_METHOD_COUNT> HTTP_METHOD_NAMES = {
+  "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH"
+};
+
+/**
+ * @brief Identifies a method. Methods are case-sensitive, "get" is not GET.
+ *
+ * @return HttpMethod The method, HttpMethod::Unknown for any other token.
+ */
+constexpr HttpMethod lookupHttpMethod(std::string_view method) {
+  // The first letter and the length tell the known methods apart, one comparison confirms the guess.
+  HttpMethod guess = HttpMethod::Unknown;
+  switch(method.empty() ? '\0' : method[0]) {
+  case 'G': guess = HttpMethod::Get; break;
+  case 'H': guess = HttpMethod::Head; break;
+  case 'P':
+    guess = method.size() == 4 ? HttpMethod::Post : method.size() == 3 ? HttpMethod::Put : HttpMethod::Patch;
+    break;
+  case 'D': guess = HttpMethod::Delete; break;
+  case 'C': guess = HttpMethod::Connect; break;
+  case 'O': guess = HttpMethod::Options; break;
+  case 'T': guess = HttpMethod::Trace; break;
+  default: return HttpMethod::Unknown;
+  }
+  return method == HTTP_METHOD_NAMES[static_cast<size_t>(guess)] ? guess : HttpMethod::Unknown;
+}
+
+constexpr std::string_view httpMethodName(HttpMethod method) {
+  return HTTP_METHOD_NAMES[static_cast<size_t>(method)];
+}
+
+static_assert(!HTTP_METHOD_NAMES.back().empty(), "every HttpMethod needs a name");
+static_assert(lookupHttpMethod("PATCH") == HttpMethod::Patch && lookupHttpMethod("PUT") == HttpMethod::Put);
+static_assert(lookupHttpMethod("get") == HttpMethod::Unknown && lookupHttpMethod("") == HttpMethod::Unknown);
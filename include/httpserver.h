@@ -1,59 +1,143 @@
 #pragma once
 
-#include <winsock2.h>
+#include <array>
+#include <atomic>
 #include <functional>
 #include <vector>
 #include <unordered_map>
 #include <queue>
 #include <thread>
+#include <map>
+#include <deque>
 #include <memory>
+#include <new>
+#include <mutex>
 #include <condition_variable>
 
+#include "platform.h"
+#ifdef BOLTPP_IO_URING
+#include "uring.h"
+#endif
+#include "arena.h"
+#include "filecache.h"
+#include "connectionslab.h"
+#include "epochdomain.h"
+#include "workscheduler.h"
 #include "request.h"
 #include "response.h"
+#include "httpmethod.h"
+#include "pipeline.h"
+#include "router.h"
+#include "routetree.h"
 #include "CORS.h"
 
-#pragma comment(lib, "ws2_32.lib")
+#ifndef _WIN32
+/**
+ * @brief I/O engines the Linux reactors can run on.
+ */
+enum class IoEngine {
+  Epoll,    ///< Edge-triggered epoll, always available.
+  IoUring   ///< io_uring with multishot accept/recv and provided buffers, needs BOLTPP_IO_URING.
+};
+#endif
 
 /**
- * @brief The HttpServer class provides a basic asynchronous HTTP server implementation using IO Completion Ports.
+ * @brief The HttpServer class provides a basic asynchronous HTTP server implementation.
+ *
+ * On Windows connections are driven by IO Completion Ports, everywhere else by a set of edge-triggered
+ * epoll reactors that each own a SO_REUSEPORT listening socket and the connections accepted on it.
  *
  * This class manages incoming HTTP requests, parses them, applies global and route-specific middlewares,
  * and dispatches the request to the appropriate handler. It also creates and manages worker threads.
  */
 class HttpServer {
 private:
-  static const int contentLengthStringLength = 16;
-  const char* contentLength = "Content-Length:";
+  friend class Router;
 
   CorsConfig corsConfig;
   bool corsEnabled = false;
 
   SOCKET serverSocket;
 
-  class PathTree {
-    class Trie {
-    public:
-      std::unordered_map<std::string, std::shared_ptr<Trie>> children;
-
-      /**
-       * @brief Used for storing ":id" like param nodes
-       */
-      std::shared_ptr<Trie> paramChild = nullptr;
-
-      /**
-       * @brief Used for storing parameter name at that segment
-       */
-      std::string paramName;
-      bool isEndOfPath = false;
+  /**
+   * @brief A request on its way from the IO side to a worker, together with the arena its containers use.
+   *
+   * Allocated once per request and only ever passed around by pointer, so the arena never moves. The
+   * response is built in the same arena, and all of it is released with the package.
+   */
+  struct RequestPackage {
+    RequestArena arena;                   ///< Declared first, so it outlives everything allocated from it.
+    Request request{arena.resource()};    ///< Request already framed and parsed by the IO side.
+    SOCKET socket = INVALID_SOCKET;
+    size_t reactor = 0;                   ///< Index of the reactor owning the socket (epoll backend).
+    unsigned long long connectionId = 0;  ///< Id of the connection the request arrived on.
+    unsigned long long sequence = 0;      ///< Position of the request on its connection, responses are written in this order.
+  };
+
+  /**
+   * @brief Resumable HTTP/1.1 request framer, one per connection.
+   *
+   * Remembers how far the connection buffer was already scanned, so every read only looks at the new
+   * bytes, parses the request line and every header exactly once and hands out a complete Request. Line
+   * ends and header colons come from the index built by the vectorized HttpTokenizer, control characters
+   * in the request head are rejected.
+   */
+  class RequestParser {
+  public:
+    enum class Status {
+      Incomplete,  ///< More bytes are needed.
+      Complete,    ///< request() holds a full request spanning the first consumed() bytes of the buffer.
+      Error        ///< The bytes can never form a valid request, respond with errorStatus() and close.
     };
 
-    std::shared_ptr<Trie> root = std::make_shared<Trie>();
+    /**
+     * @brief Continues parsing the connection buffer from where the previous call stopped.
+     *
+     * @param buffer All bytes received on the connection that were not consumed yet.
+     * @param maxHeaderSize Maximum allowed size of the request line and headers.
+     * @param maxBodySize Maximum allowed Content-Length, larger bodies are refused before they are buffered.
+     * @return Status The parsing state.
+     */
+    Status parse(std::string_view buffer, size_t maxHeaderSize, size_t maxBodySize);
+
+    inline Request& request() { return package->request; }
 
-  public:
-    void addPath(const std::string &path);
-    std::unordered_map<std::string, std::string> getPathParams(const std::string &path);
-    std::string getNormalisedPath(const std::string &path);
+    /**
+     * @brief Hands out the complete request together with its arena, call reset() afterwards.
+     */
+    inline std::unique_ptr<RequestPackage> takeRequest() { return std::move(package); }
+    inline size_t consumed() const { return consumedLength; }
+    inline int errorStatus() const { return errorCode; }
+
+    /**
+     * @brief Whether the parsed request carries "Connection: close", no request after it may be processed.
+     */
+    inline bool closeRequested() const { return connectionClose; }
+
+    /**
+     * @brief Prepares the parser for the next request once the consumed bytes were removed from the buffer.
+     */
+    void reset();
+
+  private:
+    enum class State { RequestLine, Headers, Body };
+
+    State state = State::RequestLine;
+    size_t scanOffset = 0;      ///< Where indexing resumes, everything before was indexed already.
+    size_t lineStart = 0;       ///< Start of the line currently being parsed.
+    size_t requestStart = 0;    ///< Start of the request line, header slices are relative to it.
+    size_t colon = std::string_view::npos;  ///< First colon of the current header line, relative to lineStart.
+    size_t bodyStart = 0;
+    size_t contentLength = 0;
+    size_t consumedLength = 0;
+    bool hasContentLength = false;
+    bool connectionClose = false;
+    int errorCode = 400;
+    std::unique_ptr<RequestPackage> package;  ///< Created when the request line arrives, idle connections hold none.
+
+    bool parseRequestLine(std::string_view line);
+    bool parseHeaderLine(std::string_view line, size_t colon, size_t offset);
+    Status fail(int statusCode);
   };
   /**
    * @brief The Route class represents a route with its associated middlewares and handler.
@@ -80,64 +164,295 @@ private:
      *
      * @param route The Route instance to copy.
      */
-    Route(const Route &route) : middlewares(route.middlewares), handler(route.handler) {}
+    Route(const Route &route)
+        : middlewares(route.middlewares), handler(route.handler), blocking(route.blocking), method(route.method),
+          parameterNames(route.parameterNames), bindParameters(route.bindParameters), pattern(route.pattern) {}
 
     std::vector<std::function<void(Request&, Response&, long long&)>> middlewares;  ///< Middleware functions for this route.
     std::function<void(Request&, Response&)> handler;  ///< Handler function for processing the request.
+    bool blocking = false;  ///< The handler may block, never run it on a reactor thread.
+    HttpMethod method = HttpMethod::Get;  ///< HTTP method the route answers.
+    std::vector<std::string> parameterNames;  ///< Names of the ":name" segments of the path, in order.
+    /// Converts the parameters of a compile-time pattern while routing, false rejects the request.
+    bool (*bindParameters)(Request &req, const RouteTree::Match &match) = nullptr;
+    std::string pattern;  ///< Path pattern as registered, group prefix included.
+    /// Global, group and own middlewares of the route, compiled by freeze(). Not copied, it points into the owners.
+    std::vector<const Middleware*> chain;
+    /// Lengths of the parts of chain that count next on their own: global, one per covering group, own.
+    std::vector<uint32_t> segments;
   };
 
   /**
-   * @brief The SocketBuffer struct manages the buffer and synchronization for a given socket.
+   * @brief The routes of one path pattern, indexed by method, nullptr for methods it does not answer.
    */
-  struct SocketBuffer {
-    std::string buffer;   ///< Buffer to hold incoming data.
-    std::mutex mtx;       ///< Mutex for synchronizing access to the buffer.
-    bool processing = false;  ///< Flag to indicate if the socket is currently processing data.
+  using Endpoint = std::array<std::shared_ptr<Route>, HTTP_METHOD_COUNT>;
+
+  /**
+   * @brief A snapshot of all routes, never changed once published.
+   */
+  struct RouteTable {
+    RouteTree tree;                   ///< Frozen when published, its handles index endpoints.
+    std::vector<Endpoint> endpoints;  ///< Routes are shared with the snapshots before and after this one.
+    std::vector<std::string> allowed;  ///< Allow header of each endpoint when published, empty if it has no routes.
   };
 
-  struct RequestPackage {
-    SOCKET socket;
-    std::string rawRequest;
+  /**
+   * @brief Result of routing a request.
+   */
+  struct Routing {
+    Route *route = nullptr;                ///< Route to run, nullptr if none answers the method.
+    const std::string *allow = nullptr;    ///< Allow header of the matched path, nullptr if no path matched.
+  };
+
+  std::unique_ptr<RouteTable> pendingRoutes = std::make_unique<RouteTable>();  ///< Built in place until initServer().
+  /// The published snapshot, read by reactors and workers inside a read section of routeEpochs.
+  std::atomic<const RouteTable*> routeTable{nullptr};
+  EpochDomain routeEpochs;  ///< Keeps replaced snapshots alive while requests still route by them.
+  std::mutex routesMutex;   ///< Serializes route changes.
+  std::unique_ptr<WorkScheduler<RequestPackage>> scheduler;  ///< Created by initServer() with one deque per worker.
+
+  FileCache fileCache;  ///< Open files behind file responses, looked up by the workers.
+  std::vector<std::function<void(Request&, Response&, long long&)>> globalMiddlewares;  ///< Global middleware functions.
+
+  /**
+   * @brief A middleware of a group, it runs for the routes beneath prefix.
+   */
+  struct PrefixMiddleware {
+    std::string prefix;
+    Middleware middleware;
+  };
+
+  std::vector<PrefixMiddleware> prefixMiddlewares;  ///< In registration order, resolved per route by freeze().
+  Router router{this, ""};  ///< Registers the typed routes, groups and mounted routers of the server itself.
+
+
+  static const int BUFFER_SIZE = 10240;  ///< Buffer size for socket communications.
+  unsigned int MAX_THREADS = 1;  ///< Maximum number of worker threads.
+  size_t MAX_HEADER_SIZE = 8192;  ///< Maximum allowed header size.
+  size_t MAX_BODY_SIZE = 1 << 20;  ///< Maximum allowed body size.
+  static constexpr size_t POOLED_BUFFERS = 1024;           ///< Spare buffers of each kind kept for idle connections.
+  static constexpr size_t MAX_POOLED_BUFFER_SIZE = 65536;  ///< Larger receive buffers are freed instead of pooled.
+
+#ifdef _WIN32
+  /**
+   * @brief The SocketBuffer struct holds the read state of a socket, owned by the receiver thread.
+   */
+  struct SocketBuffer {
+    SOCKET socket = INVALID_SOCKET;
+    std::string buffer;   ///< Buffer to hold incoming data.
+    RequestParser parser; ///< Framing state of the request in buffer.
+    unsigned long long id = 0;            ///< Connection id, tells the dispatcher when a socket handle was reused.
+    unsigned long long nextSequence = 0;  ///< Sequence number given to the next request read from the socket.
+    bool noMoreRequests = false;          ///< A "Connection: close" request was read, ignore anything after it.
   };
 
   struct SocketResponse {
     SOCKET socket;
     Response response;
     bool terminate_socket;
+    unsigned long long connectionId = 0;
+    unsigned long long sequence = 0;
+    bool endOfConnection = false;  ///< No response follows, close the socket once everything before is written.
+    std::shared_ptr<const FileCache::File> file;  ///< Body of a file response, opened by the worker.
+    bool transmitted = false;      ///< No response: the socket's TransmitFile completed, terminate_socket if it failed.
+  };
+
+  /**
+   * @brief Write-side state of a socket, owned by the response dispatcher thread.
+   */
+  struct SocketOrder {
+    unsigned long long connectionId = 0;
+    unsigned long long nextToWrite = 0;             ///< Sequence number of the response that goes out next.
+    std::map<unsigned long long, SocketResponse> reordered;  ///< Responses that finished ahead of an earlier request.
+    bool finished = false;                          ///< The socket was shut down, drop whatever still arrives.
+    bool transmitting = false;                      ///< The front response's file is still being sent.
   };
 
-  PathTree registeredPaths;
-  std::queue<RequestPackage> incoming_request_queue;
   std::queue<SocketResponse> outgoing_responses;
-  std::mutex incoming_request_mutex;
-  std::condition_variable incoming_request_variable;
   std::mutex outgoing_response_mutex;
   std::condition_variable outgoing_response_variable;
 
   HANDLE iocp;   ///< Handle to the IO Completion Port.
 
-  // storage for per-socket buffers.
-  std::unordered_map<SOCKET, SocketBuffer> socketBuffers;
-
-  std::unordered_map<std::string, Route> allowedRoutes;  ///< Map storing allowed routes and their handlers.
-  std::vector<std::function<void(Request&, Response&, long long&)>> globalMiddlewares;  ///< Global middleware functions.
-
-
-  static const int BUFFER_SIZE = 10240;  ///< Buffer size for socket communications.
-  unsigned int MAX_THREADS = 1;  ///< Maximum number of worker threads.
-  size_t MAX_HEADER_SIZE = 8192;  ///< Maximum allowed header size.
+  // Read state of every socket, keyed by the slot stored in its PerIoData. Only touched by the receiver thread.
+  ConnectionSlab<SocketBuffer> socketBuffers;
+  BufferPool<std::string> inputBuffers{POOLED_BUFFERS, MAX_POOLED_BUFFER_SIZE};
+  BufferPool<std::vector<char>> receiveBuffers{POOLED_BUFFERS, BUFFER_SIZE};
+  unsigned long long nextConnectionId = 1;  ///< Only touched by the receiver thread.
 
   /**
-   * @brief Struct to store per-IO operation data.
+   * @brief Struct to store per-IO operation data, one per socket for as long as it is open.
    */
   struct PerIoData {
+    static constexpr size_t NO_SLOT = SIZE_MAX;
+
     OVERLAPPED overlapped;  ///< Overlapped structure for asynchronous IO.
     WSABUF wsabuff;         ///< WSABUF structure for IO data.
-    char buffer[BUFFER_SIZE];  ///< Data buffer.
+    std::vector<char> buffer;  ///< Data buffer from receiveBuffers, empty while an idle socket waits with a zero-byte read.
     SOCKET socket;          ///< Associated socket.
+    size_t slot = NO_SLOT;  ///< Key of the socket's SocketBuffer, assigned on its first completion.
     bool receiving;         ///< Flag indicating if the operation is a receive.
   };
 
+  /**
+   * @brief An overlapped TransmitFile, keeps the header block and the file alive until its completion arrives.
+   */
+  struct TransmitData : PerIoData {
+    unsigned long long connectionId = 0;
+    std::string headers;
+    TRANSMIT_FILE_BUFFERS buffers;
+    std::shared_ptr<const FileCache::File> file;
+  };
+#else
+  /**
+   * @brief A response serialized by a worker, waiting to be picked up by the owning reactor.
+   */
+  struct ReactorResponse {
+    SOCKET socket;
+    unsigned long long connectionId;
+    unsigned long long sequence;
+    std::string head;                             ///< Status line and headers.
+    std::string body;                             ///< Body, moved out of the Response without copying.
+    std::shared_ptr<const FileCache::File> file;  ///< Body of a file response, sent straight from the page cache.
+    bool terminate_socket;
+  };
+
+  /**
+   * @brief A piece of a connection's pending output: serialized bytes or the body of a cached file.
+   *
+   * Header blocks and bodies stay separate chunks and are written together with one gathered send.
+   */
+  struct OutgoingChunk {
+    std::string data;
+    std::shared_ptr<const FileCache::File> file;
+    size_t offset = 0;  ///< Bytes of the chunk already written.
+
+    inline size_t size() const { return file ? file->size : data.size(); }
+  };
+
+  /**
+   * @brief First-in first-out queue of output chunks.
+   *
+   * Unlike std::deque it owns no memory while empty, and its vector can be handed to a BufferPool when
+   * the connection goes idle.
+   */
+  struct OutgoingQueue {
+    std::vector<OutgoingChunk> chunks;
+    size_t head = 0;           ///< Index of the front chunk.
+    size_t bufferedBytes = 0;  ///< Unwritten bytes held in memory, file bodies stay in the page cache and do not count.
+
+    inline bool empty() const { return head == chunks.size(); }
+    inline size_t size() const { return chunks.size() - head; }
+    inline OutgoingChunk& front() { return chunks[head]; }
+    inline std::vector<OutgoingChunk>::const_iterator begin() const { return chunks.begin() + head; }
+    inline std::vector<OutgoingChunk>::const_iterator end() const { return chunks.end(); }
+    inline void push_back(OutgoingChunk &&chunk) {
+      if(!chunk.file)
+        bufferedBytes += chunk.size() - chunk.offset;
+      chunks.push_back(std::move(chunk));
+    }
+
+    /**
+     * @brief Marks written bytes of the front chunk, which stays queued.
+     */
+    inline void advance(size_t written) {
+      if(!chunks[head].file)
+        bufferedBytes -= written;
+      chunks[head].offset += written;
+    }
+
+    inline void pop_front() {
+      if(!chunks[head].file)
+        bufferedBytes -= chunks[head].size() - chunks[head].offset;
+      chunks[head] = OutgoingChunk();
+      if(++head == chunks.size()) {
+        chunks.clear();
+        head = 0;
+      }
+    }
+  };
+
+  /**
+   * @brief State of one client connection, owned and only ever touched by its reactor thread.
+   *
+   * Pipelined requests are handed to the workers concurrently, each tagged with the next sequence number,
+   * and their responses are written strictly in that order.
+   */
+  struct Connection {
+    SOCKET socket = INVALID_SOCKET;
+    unsigned long long id = 0;      ///< Reactor-unique id, guards against responses landing on a reused fd.
+    std::string buffer;             ///< Bytes received but not yet handed to a worker.
+    RequestParser parser;           ///< Framing state of the request at the front of buffer.
+    OutgoingQueue outgoing;         ///< Responses waiting to be written, the front one is being written.
+#ifdef BOLTPP_IO_URING
+    std::vector<iovec> sendSegments;     ///< Segments of the gathered send queued on the io_uring engine.
+    msghdr sendMessage{};
+#endif
+    std::map<unsigned long long, ReactorResponse> reordered;  ///< Responses that finished ahead of an earlier request.
+    unsigned long long nextSequence = 0;  ///< Sequence number given to the next request handed to the workers.
+    unsigned long long nextToWrite = 0;   ///< Sequence number of the response that goes out next.
+    bool closeAfterWrite = false;   ///< Close the connection once outgoing is drained.
+    bool noMoreRequests = false;    ///< Nothing after the requests already dispatched will be processed.
+    bool peerClosed = false;        ///< The client shut down its side, finish pending work then close.
+    bool writeInFlight = false;     ///< A send is queued on the io_uring engine.
+    bool closing = false;           ///< Close was requested on the io_uring engine, waiting for the kernel.
+    bool readPaused = false;        ///< Input is left in the socket until dispatching makes room again.
+
+    /**
+     * @brief Whether every response this connection will ever produce is part of outgoing.
+     */
+    inline bool lastOutput() const {
+      return closeAfterWrite || (noMoreRequests && nextToWrite == nextSequence);
+    }
+
+    /**
+     * @brief Whether no further request may be dispatched: the pipeline is full or too much output waits
+     *        for a client that does not read it.
+     */
+    inline bool dispatchBlocked() const {
+      return nextSequence - nextToWrite >= MAX_PIPELINE_DEPTH || outgoing.bufferedBytes > MAX_BUFFERED_OUTPUT;
+    }
+  };
+
+  /**
+   * @brief One epoll event loop with its own listening socket and connection set.
+   */
+  struct Reactor {
+    size_t index = 0;
+    int epollFd = -1;
+    int eventFd = -1;   ///< Signalled by workers when completed holds responses.
+    EpochDomain::Reader *routeReader = nullptr;  ///< Read section of run-to-completion routing.
+    SOCKET listenSocket = INVALID_SOCKET;
+    unsigned long long nextConnectionId = 1;
+    ConnectionSlab<Connection> connections;  ///< Indexed by socket descriptor.
+    BufferPool<std::string> inputBuffers{POOLED_BUFFERS, MAX_POOLED_BUFFER_SIZE};
+    BufferPool<std::vector<OutgoingChunk>> outputBuffers{POOLED_BUFFERS, MAX_SEND_SEGMENTS * 4};
+#ifdef BOLTPP_IO_URING
+    BufferPool<std::vector<iovec>> segmentBuffers{POOLED_BUFFERS, MAX_SEND_SEGMENTS};
+#endif
+    std::mutex completedMutex;
+    std::vector<ReactorResponse> completed;
+#ifdef BOLTPP_IO_URING
+    std::unique_ptr<IoUring> ring;  ///< Set when the reactor runs on the io_uring engine instead of epoll.
+    uint64_t wakeupValue = 0;       ///< Target of the queued eventfd read.
+#endif
+  };
+
+  std::vector<std::unique_ptr<Reactor>> reactors;
+  IoEngine ioEngine = IoEngine::Epoll;  ///< Engine the reactors run on.
+  unsigned int REACTOR_THREADS = 0;  ///< Number of reactor threads, 0 means one per hardware thread.
+  bool runToCompletion = false;      ///< Reactors run non-blocking routes inline instead of handing them to workers.
+
+  static constexpr unsigned MAX_SEND_SEGMENTS = 64;    ///< Output chunks gathered into one send.
+  static constexpr size_t INLINE_BODY_SIZE = 2048;     ///< Smaller bodies are copied behind their headers instead.
+  static constexpr unsigned MAX_PIPELINE_DEPTH = 16;   ///< Requests of one connection that may be with the workers at once.
+  static constexpr size_t MAX_BUFFERED_INPUT = 65536;   ///< Received bytes above which a blocked connection stops reading.
+  static constexpr size_t MAX_BUFFERED_OUTPUT = 262144; ///< Unwritten response bytes above which dispatching stops.
+  static constexpr unsigned URING_ENTRIES = 1024;       ///< Submission queue size of every io_uring reactor.
+  static constexpr unsigned URING_BUFFER_COUNT = 512;   ///< Provided receive buffers per io_uring reactor.
+  static constexpr unsigned URING_BUFFER_SIZE = 4096;   ///< Size of every provided receive buffer.
+#endif
+
   /**
    * @brief Gets the textual representation of an HTTP status code.
    *
@@ -154,6 +469,15 @@ private:
    */
   static std::string makeHttpResponse(Response &response);
 
+  /**
+   * @brief Creates the status line and header block of a response, terminated by an empty line.
+   *
+   * @param res The response object.
+   * @param contentLength Size of the body that follows the header block.
+   * @return std::string The serialized header block.
+   */
+  static std::string makeHttpResponseHeader(Response &response, size_t contentLength);
+
   /**
    * @brief Decodes a URL-encoded special sequence into its corresponding character.
    *
@@ -165,12 +489,25 @@ private:
   static std::string decodeUrl(std::string_view input);
 
   /**
-   * @brief Parses query parameters from the request URL and adds them to the Request object.
+   * @brief Splits the path off the request URL, the query parameters are only decoded once they are used.
    *
    * @param req The request object.
    */
   static void parseQueryParameters(Request &request);
 
+  /**
+   * @brief Decodes the query string of a request into parameters, the builder of Request::query_parameters.
+   */
+  static void decodeQueryParameters(const Request &request, LazyStringMap::Map &parameters);
+
+  /**
+   * @brief Fills a response with the JSON error message matching its status code.
+   *
+   * @param res The response object containing the error status.
+   * @return Response& The same response.
+   */
+  static Response& makeErrorResponse(Response &response);
+
   /**
    * @brief Sends an error response to the client.
    *
@@ -179,25 +516,141 @@ private:
    */
   static void sendErrorResponse(Response &response, const SOCKET &clientSocket);
 
-  static Request sendBadRequest(Request &req, SOCKET clientsocket);
+  bool validateCors(Request &req);
   
   /**
-   * @brief Parses an HTTP request string into a Request object.
+   * @brief Finds the route registered for the request's method and path and fills its path parameters.
    *
-   * @param request The raw HTTP request string.
-   * @param clientSocket The client socket.
-   * @return Request The parsed request.
+   * A HEAD request without a HEAD route is answered by the GET route. Must be called inside a read section of
+   * routeEpochs, the route and the Allow header are valid until it ends.
+   *
+   * @return Routing The route, and the methods the path allows if it matched at all.
    */
-  static Request parseHttpRequest(const std::string &request, const SOCKET &clientSocket, PathTree &registeredPaths);
-  
-  bool validateCors(Request &req);
-  
+  Routing findRoute(const RouteTable &table, Request &req);
+
+  /**
+   * @brief Registers a route, replacing the one of the same method and path pattern.
+   *
+   * Before initServer() the route goes into pendingRoutes, afterwards into a new snapshot that is published.
+   *
+   * @param bindParameters Converter of the typed parameters of a compile-time pattern, nullptr for others.
+   */
+  void addRoute(HttpMethod method, const std::string &path,
+                const std::vector<std::function<void(Request&, Response&, long long&)>> &middlewares,
+                std::function<void(Request&, Response&)> handler,
+                bool (*bindParameters)(Request &req, const RouteTree::Match &match) = nullptr);
+
+  /**
+   * @brief Applies a change to the routes, holding routesMutex.
+   *
+   * Before initServer() change edits pendingRoutes in place. Afterwards it gets a fresh table with the routes of
+   * the published one, which is then frozen and swapped in, and the old snapshot is retired. Routes the change
+   * creates or replaces must have their middleware chain compiled by it.
+   */
+  void updateRoutes(const std::function<void(RouteTable&)> &change);
+
+  /**
+   * @brief Builds a table with the same routes as table, shared, not copied.
+   */
+  static std::unique_ptr<RouteTable> copyRoutes(const RouteTable &table);
+
+  /**
+   * @brief Fills the Allow header of every endpoint of table: its methods, HEAD along with GET, and OPTIONS.
+   */
+  static void listAllowedMethods(RouteTable &table);
+
+  /**
+   * @throws std::runtime_error if table has no route for method and path.
+   */
+  static std::shared_ptr<Route>& registeredRoute(RouteTable &table, const std::string &method, const std::string &path);
+
+  inline bool routesPublished() const { return routeTable.load(std::memory_order_acquire) != nullptr; }
+
+  /**
+   * @brief Runs CORS validation, middlewares and the route handler of a request.
+   *
+   * Without a route the request is answered from the route table: 404 if no path matched, the allowed methods
+   * for OPTIONS, 405 with an Allow header for any other method. An exception thrown by a middleware or the
+   * handler answers 400 if it is a json_parse_error, e.g. from Request::json(), and 500 otherwise, in place of
+   * whatever the handler had set on the response.
+   *
+   * @param routing The result of findRoute().
+   * @return bool Whether the connection is closed after the response.
+   */
+  bool handleRequest(Request &req, Response &res, const Routing &routing);
+
+  /**
+   * @brief Collects the middlewares of a route into its chain: global ones, those of groups covering it, its own.
+   */
+  void compileChain(Route &route);
+
   /**
    * @brief Function executed by worker threads to handle IO completion events.
+   *
+   * @param index Index of the worker's deque in the scheduler.
+   */
+  void workerThreadFunction(size_t index);
+
+  /**
+   * @brief Hands a framed request to the workers, requests of one connection prefer the same worker.
+   */
+  void submitRequest(std::unique_ptr<RequestPackage> task);
+
+  /**
+   * @brief Creates the scheduler and starts the worker threads.
+   */
+  void startWorkers();
+
+  /**
+   * @brief Hands a finished response back to the IO side that owns the request's socket.
+   *
+   * @param task The request the response belongs to.
+   * @param response The response to send.
+   * @param terminate_socket Whether the connection is closed after the response is written.
+   */
+  void dispatchResponse(const RequestPackage &task, Response &response, bool terminate_socket);
+
+#ifdef _WIN32
+  /**
+   * @brief Writes responses in the order their requests arrived on each socket and closes finished sockets.
    */
-  void workerThreadFunction();
-  
   void responseDispatcherThread();
+
+  /**
+   * @brief Writes a response to its socket. A file body is sent by an overlapped TransmitFile, the order is marked
+   *        transmitting until its completion comes back through the receiver thread.
+   *
+   * @return bool false if the socket failed.
+   */
+  bool writeSocketResponse(SocketResponse &response, SocketOrder &order);
+
+  /**
+   * @brief Retires the response at the front of the order, shutting the socket down after a closing response or
+   *        a failed write. The receiver still has a read posted, it sees the shutdown and sends the end marker.
+   *
+   * @return bool false if the socket was shut down.
+   */
+  static bool finishSocketResponse(SocketOrder &order, bool written);
+
+  /**
+   * @brief Writes every buffer with gathered WSASend calls, resuming after partial sends.
+   *
+   * @return bool false if the socket failed.
+   */
+  static bool sendBuffers(SOCKET socket, WSABUF *buffers, DWORD count);
+
+  /**
+   * @brief Queues the marker that closes the socket behind its last response and forgets its read state.
+   */
+  void endConnection(PerIoData *ioData, SocketBuffer &socketBuffer);
+
+  /**
+   * @brief Posts the next read of a socket.
+   *
+   * @param idle Whether no partial request is buffered. An idle socket waits with a zero-byte read and gives
+   *             its receive buffer back to the pool, it takes one again once data arrives.
+   */
+  void postReceive(PerIoData *ioData, bool idle);
   
   void receiverThreadFunction();
   
@@ -207,6 +660,137 @@ private:
    * @note After this control flow of your program won't go ahead
    */
   void serverListen();
+#else
+  /**
+   * @brief Serializes a finished response into the form the reactor writes, opening file bodies from the cache.
+   */
+  ReactorResponse makeReactorResponse(const RequestPackage &task, Response &response, bool terminate_socket);
+
+  /**
+   * @brief Pins the calling reactor thread to one of the cores the process may run on.
+   */
+  static void pinToCore(unsigned int index);
+
+  /**
+   * @brief Creates the reactor's SO_REUSEPORT listening socket, epoll instance and wakeup eventfd.
+   */
+  void openReactor(Reactor &reactor, int port, int addressFamily, int type, int protocol);
+
+  /**
+   * @brief Event loop of one reactor: accepts, reads, frames requests and writes responses.
+   *
+   * @note Never returns.
+   */
+  void reactorThreadFunction(Reactor &reactor);
+
+  void acceptConnections(Reactor &reactor);
+
+  /**
+   * @brief Reads what is available on the connection and forwards complete requests to the workers. Once
+   *        MAX_BUFFERED_INPUT bytes wait behind a blocked dispatch the rest stays in the socket.
+   *
+   * @return bool false if the connection was closed.
+   */
+  bool readConnection(Reactor &reactor, Connection &connection);
+
+  /**
+   * @brief Writes as much of the connection's pending output as the socket accepts.
+   *
+   * @return bool false if the connection was closed.
+   */
+  bool flushConnection(Reactor &reactor, Connection &connection);
+
+  /**
+   * @brief Hands every complete request buffered on the connection to the workers, up to MAX_PIPELINE_DEPTH
+   *        requests in flight. In run-to-completion mode non-blocking routes are answered right here instead.
+   *
+   * @return bool false if the connection was closed.
+   */
+  bool dispatchBufferedRequest(Reactor &reactor, Connection &connection);
+
+  /**
+   * @brief Moves the run of responses starting at the connection's next sequence number to its output.
+   */
+  static void collectOrderedResponses(Reactor &reactor, Connection &connection);
+
+  /**
+   * @brief Hands the buffers of a connection that has nothing to receive or send back to the reactor's pools.
+   */
+  static void parkBuffers(Reactor &reactor, Connection &connection);
+
+  /**
+   * @brief Removes a connection whose socket is closed from the reactor, keeping its buffers for reuse.
+   */
+  static void eraseConnection(Reactor &reactor, Connection &connection);
+
+  /**
+   * @brief Appends serialized bytes to the connection's output as a chunk of their own.
+   */
+  static void appendOutgoing(Connection &connection, std::string &&data);
+
+  /**
+   * @brief Describes the unwritten part of the connection's leading output chunks for a gathered send.
+   *
+   * @param segments Receives at most MAX_SEND_SEGMENTS segments.
+   * @param withFiles Whether mapped file chunks are included, otherwise gathering stops at the first file.
+   * @return size_t The number of segments filled in.
+   */
+  static size_t gatherOutgoing(const Connection &connection, iovec *segments, bool withFiles);
+
+  /**
+   * @brief Marks bytes of the connection's output as written, dropping every chunk that was completed.
+   */
+  static void consumeOutgoing(Connection &connection, size_t written);
+
+  /**
+   * @brief Moves responses completed by workers onto their connections and writes them.
+   */
+  void drainCompletedResponses(Reactor &reactor);
+
+  /**
+   * @brief Runs once a connection's pending output is fully written: closes it or moves on to the next request.
+   *
+   * @return bool false if the connection was closed.
+   */
+  bool finishWrite(Reactor &reactor, Connection &connection);
+
+  /**
+   * @brief Stops receiving on a connection whose buffered input cannot be dispatched yet.
+   */
+  void pauseReading(Reactor &reactor, Connection &connection);
+
+  /**
+   * @brief Receives again on a paused connection, the input that waited in the socket is picked up as a new event.
+   */
+  void resumeReading(Reactor &reactor, Connection &connection);
+
+  void closeConnection(Reactor &reactor, SOCKET socket);
+
+#ifdef BOLTPP_IO_URING
+  /**
+   * @brief Event loop of one io_uring reactor, every iteration submits and reaps in a single io_uring_enter().
+   *
+   * @note Never returns.
+   */
+  void uringReactorThreadFunction(Reactor &reactor);
+
+  void handleUringCompletion(Reactor &reactor, uint64_t userData, int result, uint32_t flags);
+
+  void submitUringRecv(Reactor &reactor, Connection &connection);
+
+  /**
+   * @brief Queues a send of the connection's pending output, linked with a close when it is the last response.
+   */
+  bool submitUringSend(Reactor &reactor, Connection &connection);
+
+  /**
+   * @brief Cancels the connection's multishot receive, its final completion reports -ECANCELED.
+   */
+  void cancelUringRecv(Reactor &reactor, Connection &connection);
+
+  void closeUringConnection(Reactor &reactor, Connection &connection);
+#endif
+#endif
   
 public:
   /**
@@ -228,12 +812,45 @@ public:
    */
   inline void setMaxHeaderSize(size_t maxHeaderSize) { MAX_HEADER_SIZE = maxHeaderSize; }
 
+  /**
+   * @brief Sets the maximum allowed body size, requests announcing a larger Content-Length get 413.
+   *
+   * @param maxBodySize Maximum body size in bytes.
+   */
+  inline void setMaxBodySize(size_t maxBodySize) { MAX_BODY_SIZE = maxBodySize; }
+
   /**
    * @brief Sets the number of worker threads.
    *
    * @param threads The number of threads.
    */
   void setWorkerThreads(unsigned int threads);
+
+#ifndef _WIN32
+  /**
+   * @brief Sets the number of epoll reactor threads, each accepting on its own SO_REUSEPORT socket.
+   *
+   * @param threads The number of reactors, 0 uses one per hardware thread.
+   */
+  inline void setReactorThreads(unsigned int threads) { REACTOR_THREADS = threads; }
+
+  /**
+   * @brief Selects the I/O engine used by the reactors.
+   *
+   * @param engine The engine, IoEngine::IoUring throws from initServer() when not compiled in.
+   */
+  inline void setIoEngine(IoEngine engine) { ioEngine = engine; }
+
+  /**
+   * @brief Switches to thread-per-core run-to-completion mode.
+   *
+   * Every reactor is pinned to its own core and parses, routes and answers requests inline, without
+   * handing them to another thread. Routes marked with setBlocking() still run on the worker threads.
+   *
+   * @param enabled Whether reactors run requests themselves.
+   */
+  inline void setRunToCompletion(bool enabled) { runToCompletion = enabled; }
+#endif
   
   /**
    * @brief Initializes the server socket and starts the IO completion port.
@@ -256,11 +873,30 @@ public:
    * @param middleware The middleware function.
    */
   inline void use(std::function<void(Request&, Response&, long long&)> middleware) {
+    if(routesPublished())
+      throw std::runtime_error("Middlewares can't be added once the server is initialized");
     globalMiddlewares.emplace_back(middleware);
   }
 
   void createCorsConfig(std::function<void(CorsConfig&)> configurer);
 
+  /**
+   * @brief Creates a group of routes beneath a path prefix, sharing middlewares.
+   *
+   * The middlewares run for every route beneath the prefix, after the global ones, including routes registered
+   * on the server directly. Routes outside the prefix never see them.
+   *
+   * @param prefix Path prefix like "/api/v1", may contain parameters.
+   * @param middlewares Middlewares for all routes beneath the prefix.
+   * @return Router& The group, routes registered on it are added to the server right away.
+   */
+  Router& group(const std::string &prefix, const std::vector<Middleware> &middlewares = {});
+
+  /**
+   * @brief Adds the routes, middlewares and groups of a router beneath a path prefix.
+   */
+  void mount(const std::string &prefix, const Router &router);
+
   /**
    * @brief Registers a GET route with associated middlewares and a handler.
    *
@@ -356,18 +992,91 @@ public:
    */
   void Delete(const std::string path, std::function<void(Request&, Response&)> handler);
 
+  /**
+   * @brief Marks a registered route as blocking, so it never runs on a reactor thread in run-to-completion mode.
+   *
+   * @param method The HTTP method, e.g. "GET".
+   * @param path The route path exactly as registered.
+   * @param blocking Whether the route blocks.
+   * @throws std::runtime_error if no such route is registered.
+   */
+  void setBlocking(const std::string method, const std::string path, bool blocking = true);
+
+  /**
+   * @brief Removes a route, also while the server is running.
+   *
+   * Requests already routed to it finish normally, later ones are answered as if it was never registered.
+   *
+   * @param method The HTTP method, e.g. "GET".
+   * @param path The route path as registered, parameter names may differ.
+   * @throws std::runtime_error if no such route is registered.
+   */
+  void removeRoute(const std::string method, const std::string path);
+
+  /**
+   * @brief Registers a GET route whose pattern is parsed at compile time, like "/users/:id<u64>/posts/:slug".
+   *
+   * Parameters annotated with <u32>, <u64>, <i32>, <i64> or <f64> are converted while routing, a request whose
+   * parameter is not a value of its type gets 404 and never reaches middlewares or handler. Unannotated ones
+   * and <str> are std::string_view. The handler takes the values either as arguments after the response,
+   * handler(req, res, id, slug), or as one tuple, handler(req, res, std::tuple<uint64_t, std::string_view>).
+   * path_parameters is filled as for every other route.
+   */
+  template<RoutePattern Pattern, typename Handler>
+  void Get(Handler handler) { router.Get<Pattern>(std::move(handler)); }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Get(const std::vector<std::function<void(Request&, Response&, long long&)>> middlewares, Handler handler) {
+    router.Get<Pattern>(middlewares, std::move(handler));
+  }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Post(Handler handler) { router.Post<Pattern>(std::move(handler)); }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Post(const std::vector<std::function<void(Request&, Response&, long long&)>> middlewares, Handler handler) {
+    router.Post<Pattern>(middlewares, std::move(handler));
+  }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Patch(Handler handler) { router.Patch<Pattern>(std::move(handler)); }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Patch(const std::vector<std::function<void(Request&, Response&, long long&)>> middlewares, Handler handler) {
+    router.Patch<Pattern>(middlewares, std::move(handler));
+  }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Put(Handler handler) { router.Put<Pattern>(std::move(handler)); }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Put(const std::vector<std::function<void(Request&, Response&, long long&)>> middlewares, Handler handler) {
+    router.Put<Pattern>(middlewares, std::move(handler));
+  }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Delete(Handler handler) { router.Delete<Pattern>(std::move(handler)); }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Delete(const std::vector<std::function<void(Request&, Response&, long long&)>> middlewares, Handler handler) {
+    router.Delete<Pattern>(middlewares, std::move(handler));
+  }
+
+  /**
+   * @brief Compiles the route table for serving and publishes it, middlewares can't be added afterwards.
+   *
+   * Static paths get a perfect hash table of their own and only paths with parameters walk the route
+   * tree, and every route gets one flat chain of the global, group and its own middlewares. The table is
+   * immutable from here on, workers read it through an atomic pointer without locks. Routes added or removed
+   * later go into a new table that replaces it, see updateRoutes(). initServer() calls this, calling it
+   * earlier only makes registration errors surface sooner.
+   */
+  void freeze();
+
   /**
    * @brief Destructor for HttpServer.
    *
    * Cleans up all resources, closes sockets, and clears data structures.
    */
-  ~HttpServer() {
-    closesocket(serverSocket);
-    for(const std::pair<const SOCKET, SocketBuffer> &it : socketBuffers)
-      closesocket(it.first);
-    socketBuffers.clear();
-    globalMiddlewares.clear();
-    allowedRoutes.clear();
-    WSACleanup();
-  }
+  ~HttpServer();
 };
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Vectorized indexing of the request line and header block.
+ *
+ * The request framer only cares about a few bytes of a request head: the LF ending a line, the colon after
+ * a header name, and control characters that must not appear in a request at all. An indexer classifies
+ * 32 bytes per step, as two SSE2 or one AVX2 comparison in the spirit of picohttpparser, and records the
+ * line ends and colons in tables the framer then walks, instead of searching the buffer again for every
+ * token. Invalid bytes are reduced to the position of the first one. A table lookup serves CPUs without
+ * either instruction set, the fastest indexer the CPU supports is picked once at startup.
+ */
+class HttpTokenizer {
+public:
+  enum class Isa {
+    Scalar,  ///< One byte per step through a lookup table, available everywhere.
+    SSE2,    ///< 16 bytes per comparison, every x86-64 CPU.
+    AVX2     ///< 32 bytes per comparison, selected at runtime when the CPU supports it.
+  };
+
+  static constexpr size_t BLOCK_SIZE = 32;
+
+  /**
+   * @brief Structure of a range of a request head, all offsets relative to the start of the range.
+   */
+  struct Index {
+    static constexpr size_t CAPACITY = 64;    ///< Entries per table.
+    static constexpr size_t MAX_BYTES = 512;  ///< Indexed per call, so a large body behind the head costs little.
+
+    uint32_t lineFeeds[CAPACITY];  ///< Every LF, in ascending order.
+    uint32_t colons[CAPACITY];     ///< Every ':', in ascending order.
+    size_t lineFeedCount = 0;
+    size_t colonCount = 0;
+    /**
+     * @brief First control character other than HTAB, a DEL, or a CR not followed by LF. SIZE_MAX if none.
+     *
+     * A CR that is the last byte of the data counts as valid, its LF may still arrive. A bare LF is not
+     * reported here, the framer sees it as a line end without CR.
+     */
+    size_t invalid = SIZE_MAX;
+    size_t length = 0;  ///< Bytes indexed, a multiple of BLOCK_SIZE unless the data ended.
+  };
+
+  /**
+   * @brief Indexes [begin, end) until the data ends, MAX_BYTES were indexed or a table has no room for
+   * another block.
+   */
+  using Indexer = void (*)(const char *begin, const char *end, Index &index);
+
+  /**
+   * @brief Indexes with the fastest indexer of this CPU.
+   */
+  static inline void index(const char *begin, const char *end, Index &index) { active(begin, end, index); }
+
+  /**
+   * @return Isa The instruction set index() uses.
+   */
+  static Isa best();
+
+  /**
+   * @return Indexer The indexer for isa, nullptr if it is not compiled in or the CPU lacks it.
+   */
+  static Indexer indexer(Isa isa);
+
+  static const char* isaName(Isa isa);
+
+private:
+  static const Indexer active;
+};
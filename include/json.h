@@ -1,20 +1,131 @@
 #pragma once
 
+#include <cstdint>
+#include <forward_list>
+#include <initializer_list>
 #include <variant>
-#include <unordered_map>
+#include <memory_resource>
+#include <utility>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <tuple>
+
+#include "jsontape.h"
+
+class JSONValue;
+
+/**
+ * @brief A JSON object: its members in one vector, in the order they were inserted.
+ *
+ * Most objects have a handful of members, scanning their keys is faster than hashing one and keeps a parsed
+ * document in a few contiguous blocks instead of one node per member. Once an object grows past
+ * INDEX_THRESHOLD members it also gets an open addressing table of member positions by key hash. Lookups take a
+ * std::string_view, no key is copied to find a member.
+ *
+ * Allocates from a std::pmr memory resource like JSONValue::Array: moving keeps it, copying switches to the
+ * default one. Keys must not be changed through an iterator, the table would no longer find them.
+ */
+class JSONObject {
+public:
+  using key_type = std::string;
+  using mapped_type = JSONValue;
+  using value_type = std::pair<std::string, JSONValue>;
+  using size_type = size_t;
+  using iterator = std::pmr::vector<value_type>::iterator;
+  using const_iterator = std::pmr::vector<value_type>::const_iterator;
+
+  static constexpr size_t INDEX_THRESHOLD = 16;  ///< Largest object searched without the table.
+
+  explicit JSONObject(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : members(resource), slots(resource) {}
+
+  JSONObject(std::initializer_list<value_type> members,
+             std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+  inline iterator begin();
+  inline iterator end();
+  inline const_iterator begin() const;
+  inline const_iterator end() const;
+
+  inline size_type size() const;
+  inline bool empty() const;
+
+  /**
+   * @brief Makes room for count members, and for their table if they are more than INDEX_THRESHOLD.
+   */
+  void reserve(size_type count);
+
+  inline iterator find(std::string_view key);
+  inline const_iterator find(std::string_view key) const;
+  inline bool contains(std::string_view key) const { return locate(key) != NOT_FOUND; }
+  inline size_type count(std::string_view key) const { return contains(key) ? 1 : 0; }
+
+  /**
+   * @brief The value of the member named key, a new null member if there is none.
+   */
+  JSONValue& operator[](std::string_view key);
+
+  /**
+   * @throws std::out_of_range if there is no member named key.
+   */
+  JSONValue& at(std::string_view key);
+  const JSONValue& at(std::string_view key) const;
+
+  /**
+   * @brief Appends a member with the value built from args, unless one named key exists already.
+   */
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(std::string_view key, Args&&... args);
+
+  /**
+   * @brief Replaces the value of the member named key, or appends the member if there is none.
+   */
+  template<typename Value>
+  std::pair<iterator, bool> insert_or_assign(std::string key, Value &&value);
+
+  /**
+   * @brief Removes the member named key, the members after it move up one place.
+   */
+  size_type erase(std::string_view key);
+
+  void clear();
+
+  inline std::pmr::memory_resource* resource() const { return members.get_allocator().resource(); }
+
+private:
+  static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+  std::pmr::vector<value_type> members;
+  /// Positions plus one of the members by key hash, probed linearly, 0 is free. Empty while not indexed.
+  std::pmr::vector<uint32_t> slots;
+
+  size_t locate(std::string_view key) const;
+
+  /**
+   * @brief Makes the member at position, the last one, findable after it was appended.
+   */
+  void indexLast();
+
+  /**
+   * @brief Rebuilds the table with room for count members, or drops it for INDEX_THRESHOLD members or less.
+   */
+  void rebuildIndex(size_t count);
+};
 
 /**
  * @brief The JSONValue class represents a JSON value that can be of various types.
+ *
+ * Objects and arrays allocate through a std::pmr memory resource. Moving keeps the resource, copying always
+ * switches to the default one, so a copy stays valid after the arena of the original is gone.
  */
 class JSONValue {
 
   void stringifyTo(std::string &out) const;
 
 public:
-  using Object = std::unordered_map<std::string, JSONValue>;  ///< JSON object (dictionary).
-  using Array = std::vector<JSONValue>;                         ///< JSON array (list).
+  using Object = JSONObject;                  ///< JSON object, members in insertion order.
+  using Array = std::pmr::vector<JSONValue>;  ///< JSON array (list).
 
   // The underlying variant that stores the JSON value.
   std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value;
@@ -44,7 +155,7 @@ public:
    *
    * @param s The string.
    */
-  JSONValue(const std::string s) : value(s) {}
+  JSONValue(std::string s) : value(std::move(s)) {}
 
   /**
    * @brief Constructor for C-string value.
@@ -58,14 +169,28 @@ public:
    *
    * @param a The JSON array.
    */
-  JSONValue(const Array a) : value(a) {}
+  JSONValue(const Array &a) : value(a) {}
+
+  /**
+   * @brief Constructor taking over an array, together with its memory resource.
+   *
+   * @param a The JSON array.
+   */
+  JSONValue(Array &&a) : value(std::move(a)) {}
 
   /**
    * @brief Constructor for object value.
    *
    * @param o The JSON object.
    */
-  JSONValue(const Object o) : value(o) {}
+  JSONValue(const Object &o) : value(o) {}
+
+  /**
+   * @brief Constructor taking over an object, together with its memory resource.
+   *
+   * @param o The JSON object.
+   */
+  JSONValue(Object &&o) : value(std::move(o)) {}
 
   /**
    * @brief Copy constructor.
@@ -74,13 +199,15 @@ public:
    */
   JSONValue(const JSONValue &json) : value(json.value) {}
 
+  JSONValue(JSONValue &&json) noexcept = default;
+
   /**
    * @brief Assignment operator from another JSONValue.
    *
    * @param json The JSONValue to assign.
    * @return JSONValue& Reference to the assigned object.
    */
-  JSONValue& operator=(const JSONValue json);
+  JSONValue& operator=(JSONValue json);
 
   /**
    * @brief Assignment operator for JSON object.
@@ -139,20 +266,29 @@ public:
   JSONValue& operator=(const std::nullptr_t null);
 
   /**
-   * @brief Accesses a member of a JSON object using a C-string key.
+   * @brief Accesses a member of a JSON object, adding it as null if it is missing.
+   *
+   * @param key The key.
+   * @return JSONValue& Reference to the value.
+   * @throws json_type_error if the value is not an object.
+   */
+  JSONValue& operator[](std::string_view key);
+
+  /**
+   * @brief Accesses a member of a JSON object using a C-string key, see operator[](std::string_view).
    *
    * @param str Key string.
    * @return JSONValue& Reference to the value.
    */
-  JSONValue& operator[](const char* str);
+  inline JSONValue& operator[](const char* str) { return (*this)[std::string_view(str)]; }
 
   /**
-   * @brief Accesses a member of a JSON object using a std::string key.
+   * @brief Accesses a member of a JSON object using a std::string key, see operator[](std::string_view).
    *
    * @param key The key.
    * @return JSONValue& Reference to the value.
    */
-  JSONValue& operator[](const std::string& key);
+  inline JSONValue& operator[](const std::string& key) { return (*this)[std::string_view(key)]; }
 
   /**
    * @brief Accesses an element of a JSON array using an integer index.
@@ -197,68 +333,220 @@ public:
   /**
    * @brief Converts the JSON value into its string representation.
    *
+   * Numbers are written with the fewest digits that parse back to the same double, integers without a
+   * fraction. NaN and infinities become null. Strings are escaped, bytes from 0x80 on are passed through.
+   *
    * @return std::string The JSON string.
    */
   std::string stringify() const;
 };
 
+// The members of JSONObject that need JSONValue to be complete.
+
+inline JSONObject::iterator JSONObject::begin() { return members.begin(); }
+inline JSONObject::iterator JSONObject::end() { return members.end(); }
+inline JSONObject::const_iterator JSONObject::begin() const { return members.begin(); }
+inline JSONObject::const_iterator JSONObject::end() const { return members.end(); }
+inline JSONObject::size_type JSONObject::size() const { return members.size(); }
+inline bool JSONObject::empty() const { return members.empty(); }
+
+inline JSONObject::iterator JSONObject::find(std::string_view key) {
+  size_t position = locate(key);
+  return position == NOT_FOUND ? members.end() : members.begin() + position;
+}
+
+inline JSONObject::const_iterator JSONObject::find(std::string_view key) const {
+  size_t position = locate(key);
+  return position == NOT_FOUND ? members.end() : members.begin() + position;
+}
+
+template<typename... Args>
+std::pair<JSONObject::iterator, bool> JSONObject::try_emplace(std::string_view key, Args&&... args) {
+  size_t position = locate(key);
+  if(position != NOT_FOUND)
+    return {members.begin() + position, false};
+  members.emplace_back(std::piecewise_construct, std::forward_as_tuple(key),
+                       std::forward_as_tuple(std::forward<Args>(args)...));
+  indexLast();
+  return {members.end() - 1, true};
+}
+
+template<typename Value>
+std::pair<JSONObject::iterator, bool> JSONObject::insert_or_assign(std::string key, Value &&value) {
+  size_t position = locate(key);
+  if(position != NOT_FOUND) {
+    members[position].second = std::forward<Value>(value);
+    return {members.begin() + position, false};
+  }
+  members.emplace_back(std::move(key), std::forward<Value>(value));
+  indexLast();
+  return {members.end() - 1, true};
+}
+
 /**
- * @brief The JSONParser class is responsible for parsing a JSON string into a JSONValue.
+ * @brief A JSON document whose values are read on demand.
+ *
+ * parse() validates the whole document and indexes it into a JSONTape, but builds no JSONValue. An Element is a
+ * position on the tape: operator[] finds members and array values by walking it, stepping over nested arrays and
+ * objects in one go, and only the values read through asDouble(), asString() and the like are converted. A
+ * handler that reads a few fields of a large body pays for the index and those fields, not for a tree of the
+ * whole body.
+ *
+ * The document refers to the text it parsed, which has to outlive it. Elements and the views they hand out are
+ * valid until the next parse().
  */
-class JSONParser {
-  std::string input;  ///< The JSON input string.
-  size_t pos, size;   ///< Current position and size of the input.
+class JSONDocument {
+public:
+  class Element {
+  public:
+    inline JSONTape::Type type() const { return node().type; }
+    inline bool isNull() const { return node().type == JSONTape::Type::Null; }
+
+    /**
+     * @return size_t Values of an array or members of an object, 0 for other values.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Whether the value is an object with a member named key.
+     */
+    bool contains(std::string_view key) const;
+
+    /**
+     * @brief Finds a member of an object. The last one wins if a key repeats, as it does in JSONParser.
+     *
+     * @throws json_type_error if the value is not an object.
+     * @throws std::out_of_range if the object has no member named key.
+     */
+    Element operator[](std::string_view key) const;
+
+    /**
+     * @brief Finds a value of an array.
+     *
+     * @throws json_type_error if the value is not an array.
+     * @throws std::out_of_range if index is past the end of the array.
+     */
+    Element operator[](size_t index) const;
+
+    /**
+     * @throws json_type_error if the value is not a number.
+     */
+    double asDouble() const;
+
+    /**
+     * @throws json_type_error if the value is not a boolean.
+     */
+    bool asBool() const;
+
+    /**
+     * @brief Copies a string with its escape sequences decoded.
+     *
+     * @throws json_type_error if the value is not a string.
+     */
+    std::string asString() const;
+
+    /**
+     * @brief A string with its escape sequences decoded, without copying it if it has none.
+     *
+     * Strings with escape sequences are decoded on every call into memory the document keeps until the next
+     * parse(), read them once if that matters.
+     *
+     * @throws json_type_error if the value is not a string.
+     */
+    std::string_view asStringView() const;
+
+    /**
+     * @brief Builds the JSONValue of this value and everything inside of it.
+     *
+     * @param resource Memory resource for the objects and arrays of the result.
+     */
+    JSONValue toValue(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) const;
+
+  private:
+    friend class JSONDocument;
+
+    const JSONDocument *document;
+    uint32_t index;  ///< Position of the value on the tape.
+
+    Element(const JSONDocument *document, uint32_t index) : document(document), index(index) {}
+
+    inline const JSONTape& tape() const { return document->tape; }
+    inline const JSONTape::Node& node() const { return tape().nodes()[index]; }
+
+    /**
+     * @return uint32_t Position of the value after the one at position on the tape, skipping its children.
+     */
+    uint32_t skip(uint32_t position) const;
+
+    /**
+     * @return uint32_t Position of the value of the last member named key, 0 if there is none.
+     */
+    uint32_t find(std::string_view key) const;
+
+    std::string string(const JSONTape::Node &node) const;
+    JSONValue build(uint32_t &position, std::pmr::memory_resource *resource) const;
+  };
 
   /**
-   * @brief Returns the next character and advances the position.
-   *
-   * @return char The next character.
+   * @param resource Where the tape allocates, e.g. Request::memoryResource().
    */
-  inline char get() { return input[pos++]; }
+  explicit JSONDocument(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : tape(resource), decoded(resource) {}
 
   /**
-   * @brief Returns the next character without advancing the position.
+   * @brief Parses json, replacing the previous document. A blank document is a single null.
    *
-   * @return char The next character or '\0' if end of input.
+   * @throws json_parse_error if json is not valid JSON.
    */
-  inline char peek() const { return pos < size ? input[pos] : '\0'; }
-
-  /**
-   * @brief Skips whitespace characters in the input.
-   */
-  void skipWhitespaces() {
-    while(pos < size && std::isspace(input[pos])) {
-      pos++;
-    }
+  inline void parse(std::string_view json) {
+    decoded.clear();
+    tape.parse(json);
   }
 
-  // Parsing helper functions:
-  JSONValue parseBoolean();
-  JSONValue parseNull();
-  JSONValue parseString();
-  JSONValue parseNumber();
-  JSONValue parseObject();
-  JSONValue parseArray();
+  inline Element root() const { return Element(this, 0); }
+  inline Element operator[](std::string_view key) const { return root()[key]; }
+  inline Element operator[](size_t index) const { return root()[index]; }
+
+private:
+  JSONTape tape;
+  mutable std::pmr::forward_list<std::pmr::string> decoded;  ///< Strings decoded by asStringView(), never moved.
+};
+
+/**
+ * @brief The JSONParser class is responsible for parsing a JSON string into a JSONValue.
+ *
+ * The input is indexed and validated by a JSONDocument first, the JSONValue is then built from its tape. Arrays
+ * and objects are sized from the counts on the tape, they never grow while being filled.
+ */
+class JSONParser {
+  std::string_view input;  ///< The JSON text, not owned.
+  std::pmr::memory_resource *resource;  ///< Where the objects and arrays of the parsed value allocate.
+  JSONDocument document;
 
 public:
   /**
-   * @brief Constructs a JSONParser with a given JSON string.
+   * @brief Constructs a JSONParser for a JSON text, without copying it.
    *
-   * @param str The JSON string to parse.
+   * @param json The JSON text to parse, it has to outlive parse().
+   * @param resource Memory resource for the objects and arrays of the result, e.g. Request::memoryResource().
    */
-  inline JSONParser(std::string &str) : input(str), pos(0), size(str.length()) {}
+  inline JSONParser(std::string_view json, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : input(json), resource(resource) {}
 
   /**
-   * @brief Resets the parser with a new JSON string.
+   * @brief Resets the parser with a new JSON text, without copying it.
    *
-   * @param jsonString The new JSON string.
+   * @param json The new JSON text, it has to outlive parse().
    */
-  inline void setJsonString(const std::string &jsonString) { input = jsonString; pos = 0; size = jsonString.length(); }
+  inline void setJsonString(std::string_view json) { input = json; }
 
   /**
-   * @brief Parses the JSON string and returns a JSONValue.
+   * @brief Parses the JSON text and returns a JSONValue.
+   *
+   * Strings are copied into the result once at their decoded size, short ones fit into the std::string itself.
    *
-   * @return JSONValue The parsed JSON value.
+   * @return JSONValue The parsed JSON value, null for a blank input.
+   * @throws json_parse_error if the input is not valid JSON.
    */
   JSONValue parse();
 };
\ No newline at end of file
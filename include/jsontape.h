@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief A JSON document parsed in two stages into a flat array of nodes.
+ *
+ * Stage one classifies 64 bytes per step with SSE4.2 or AVX2 shuffles, or a lookup table on other CPUs, and
+ * records the offset of every structural byte: brackets, colons and commas outside of strings, both quotes of
+ * every string and the first byte of every number or literal. Which bytes are inside a string follows from the
+ * quote bits by a prefix XOR, so the byte-wise work is branch free. Stage two walks these offsets with an explicit
+ * stack, validates the grammar and writes one node per value in document order, the tape. Strings stay in the
+ * document and are only referred to, numbers are converted right away.
+ *
+ * JSONParser turns the tape into a JSONValue, JSONDocument reads values from it on demand. Nothing about the tape
+ * needs recursion, and its vectors are reused by the next parse().
+ */
+class JSONTape {
+public:
+  enum class Type : uint8_t { Null, True, False, Number, String, Array, Object };
+
+  /**
+   * @brief One value. The values of an array and the key and value nodes of each member of an object follow
+   * their container in order.
+   */
+  struct Node {
+    Type type = Type::Null;
+    bool escaped = false;  ///< A string containing escape sequences, its text has to be decoded.
+    uint32_t size = 0;     ///< Bytes of a string, values of an array, members of an object.
+    union {
+      double number = 0;
+      uint32_t offset;  ///< Offset of the first byte of a string in the document.
+      uint32_t next;    ///< Index of the node after an array or object and all of its values.
+    };
+  };
+
+  enum class Isa {
+    Scalar,  ///< One byte per step through a lookup table, available everywhere.
+    SSE42,   ///< 16 bytes per shuffle, selected at runtime when the CPU supports SSE4.2.
+    AVX2     ///< 32 bytes per shuffle, selected at runtime when the CPU supports it.
+  };
+
+  static constexpr size_t BLOCK_BYTES = 64;
+  static constexpr size_t MAX_DEPTH = 1024;       ///< Deepest nesting of arrays and objects accepted.
+  static constexpr size_t MAX_BYTES = UINT32_MAX;  ///< Largest document, offsets are 32 bits.
+
+  /**
+   * @brief Replaces the offsets with the structural bytes of [begin, begin + length), in ascending order.
+   *
+   * @return bool False if a string is not terminated or contains a control character.
+   */
+  using Indexer = bool (*)(const char *begin, size_t length, std::pmr::vector<uint32_t> &offsets);
+
+  /**
+   * @param resource Where the tape and the buffers of both stages allocate.
+   */
+  explicit JSONTape(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : structurals(resource), open(resource), tape(resource) {}
+
+  /**
+   * @brief Parses a document into the tape, replacing the previous one. A blank document is a single null.
+   *
+   * The nodes refer to json by offset, it has to outlive them.
+   *
+   * @throws json_parse_error if json is not valid JSON.
+   */
+  void parse(std::string_view json);
+
+  inline const std::pmr::vector<Node>& nodes() const { return tape; }
+
+  /**
+   * @brief The text of a string node as it is in the document, escape sequences included.
+   */
+  inline std::string_view rawString(const Node &node) const { return json.substr(node.offset, node.size); }
+
+  /**
+   * @brief Writes the text of a string with its escape sequences decoded to out, \\u escapes as UTF-8.
+   *
+   * The decoded text is never longer than raw, out needs room for raw.size() bytes.
+   *
+   * @param raw Text between the quotes, validated by parse().
+   * @return size_t The bytes written.
+   */
+  static size_t decodeString(std::string_view raw, char *out);
+
+  /**
+   * @brief Indexes with the fastest indexer of this CPU.
+   */
+  static inline bool index(std::string_view json, std::pmr::vector<uint32_t> &offsets) {
+    return active(json.data(), json.size(), offsets);
+  }
+
+  /**
+   * @return Isa The instruction set index() uses.
+   */
+  static Isa best();
+
+  /**
+   * @return Indexer The indexer for isa, nullptr if it is not compiled in or the CPU lacks it.
+   */
+  static Indexer indexer(Isa isa);
+
+  static const char* isaName(Isa isa);
+
+private:
+  static const Indexer active;
+
+  std::string_view json;
+  std::pmr::vector<uint32_t> structurals;  ///< Output of stage one, kept to reuse its memory.
+  std::pmr::vector<uint32_t> open;         ///< Arrays and objects stage two is inside of, by node index.
+  std::pmr::vector<Node> tape;
+
+  void build();
+  void pushString(uint32_t quote, const uint32_t *&offset);
+  void pushKey(const uint32_t *&offset, const uint32_t *last);
+  void pushAtom(uint32_t at);
+};
@@ -13,9 +13,9 @@
  * and assigns the result to req.body. If parsing fails, it sends a 400 Bad Request response.
  */
 inline auto JsonBodyParser = [](Request &req, Response &res, long long &next) {
-  if(req.headers["Content-Type"].find("application/json") != std::string::npos) {
+  if(req.getHeader(HttpHeader::ContentType).find("application/json") != std::string_view::npos) {
     try {
-      req.body = JSONParser(req.payload).parse();
+      req.body = JSONParser(req.payload, req.memoryResource()).parse();
     } catch (const std::exception &e) {
       res.status(400).send("Bad Request");
       next = -1; // Stop further middleware execution.
@@ -32,7 +32,7 @@ inline auto JsonBodyParser = [](Request &req, Response &res, long long &next) {
  * decodes the payload, and assigns it to req.body as a JSON object.
  */
 inline auto UrlencodedBodyParser = [](Request &req, Response &res, long long &next) {
-  if(req.headers["Content-Type"].find("application/x-www-form-urlencoded") != std::string::npos) {
+  if(req.getHeader(HttpHeader::ContentType).find("application/x-www-form-urlencoded") != std::string_view::npos) {
     auto urlEncodingCharacter = [](const std::string_view sequence) {
       if(sequence[0] != '%' && sequence.length() != 3)
         return '\0';
@@ -55,7 +55,7 @@ inline auto UrlencodedBodyParser = [](Request &req, Response &res, long long &ne
     std::string key = "", value = "";
     key.reserve(length);
     value.reserve(length);
-    JSONValue::Object json;
+    JSONValue::Object json(req.memoryResource());
     for(size_t i = 0; i < length; i++) {
       char c = req.payload[i];
       if(c == '&') {
@@ -80,7 +80,7 @@ inline auto UrlencodedBodyParser = [](Request &req, Response &res, long long &ne
     }
     if(key != "")
       json[trim(key)] = JSONValue(trim(value));
-    req.body = JSONValue(json);
+    req.body = JSONValue(std::move(json));
   }
   next++;
 };
\ No newline at end of file
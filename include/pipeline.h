@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "request.h"
+#include "response.h"
+
+/**
+ * @brief A middleware registered at runtime. It gets the index of its step in next, incrementing it skips the
+ * following step and a negative value ends the chain without calling the handler.
+ */
+using Middleware = std::function<void(Request&, Response&, long long&)>;
+
+/**
+ * @brief Runs count middlewares by the next counter protocol.
+ *
+ * @return bool Whether the chain ran through, false if a middleware stopped it.
+ */
+inline bool runMiddlewares(const Middleware *const *middlewares, size_t count, Request &req, Response &res) {
+  for(long long i = 0; i < static_cast<long long>(count); i++) {
+    (*middlewares[i])(req, res, i);
+    if(i < 0)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Middlewares known at compile time, composed into one middleware.
+ *
+ * The steps are stored by value and called directly, so the compiler can inline all of them into one function:
+ * server.use(pipeline(JsonBodyParser, UrlencodedBodyParser)) costs one indirect call per request, not one per
+ * step. Inside the pipeline next counts its own steps with the same protocol as a chain of separate middlewares,
+ * a step that stops the pipeline also stops the chain it is part of. Stateless middlewares can be named by type
+ * alone, Pipeline<decltype(JsonBodyParser), decltype(UrlencodedBodyParser)>().
+ */
+template<typename... Middlewares>
+class Pipeline {
+public:
+  Pipeline() = default;
+
+  explicit Pipeline(Middlewares... middlewares) requires(sizeof...(Middlewares) > 0)
+      : steps(std::move(middlewares)...) {}
+
+  void operator()(Request &req, Response &res, long long &next) {
+    for(long long i = 0; i < static_cast<long long>(sizeof...(Middlewares)); i++) {
+      call(i, req, res, std::index_sequence_for<Middlewares...>());
+      if(i < 0) {
+        next = -1;
+        return;
+      }
+    }
+  }
+
+private:
+  std::tuple<Middlewares...> steps;
+
+  template<size_t... Index>
+  inline void call(long long &i, Request &req, Response &res, std::index_sequence<Index...>) {
+    // Resolves to a jump over inlined steps, a step may move i anywhere.
+    (void)((i == static_cast<long long>(Index) ? (std::get<Index>(steps)(req, res, i), true) : false) || ...);
+  }
+};
+
+template<typename... Middlewares>
+Pipeline(Middlewares...) -> Pipeline<Middlewares...>;
+
+/**
+ * @brief Composes middlewares into a Pipeline, copying them.
+ */
+template<typename... Middlewares>
+inline Pipeline<std::decay_t<Middlewares>...> pipeline(Middlewares&&... middlewares) {
+  return Pipeline<std::decay_t<Middlewares>...>(std::forward<Middlewares>(middlewares)...);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+/**
+ * @brief Thin portability layer over the native socket API.
+ *
+ * Windows builds use winsock2 and IO Completion Ports. Every other platform uses BSD sockets,
+ * with the winsock names the server code is written against mapped onto their POSIX equivalents.
+ */
+#ifdef _WIN32
+
+#include <winsock2.h>
+#include <mswsock.h>
+
+#pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "mswsock.lib")
+
+/**
+ * @brief Flags passed to every send() call.
+ */
+constexpr int SEND_FLAGS = 0;
+
+#else
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+
+using SOCKET = int;
+
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+
+/**
+ * @brief Flags passed to every send() call, a peer that hung up must not raise SIGPIPE.
+ */
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+
+inline int closesocket(SOCKET socket) { return ::close(socket); }
+
+#endif
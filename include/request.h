@@ -1,21 +1,127 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <unordered_map>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "httpheaders.h"
 #include "json.h"
+#include "utils.h"
+
+class Request;
+
+/**
+ * @brief String map of a request that is only built when it is first used.
+ *
+ * Behaves like the std::pmr::unordered_map it wraps. The server leaves the header, query and path parameter
+ * maps of a parsed request unbuilt, handlers that stick to the string_view accessors of Request never
+ * pay for them. Building happens on first access, also through const members, so a map must not be
+ * shared between threads before it was touched once.
+ */
+class LazyStringMap {
+public:
+  using Map = std::pmr::unordered_map<std::string, std::string>;
+  using key_type = Map::key_type;
+  using mapped_type = Map::mapped_type;
+  using value_type = Map::value_type;
+  using size_type = Map::size_type;
+  using iterator = Map::iterator;
+  using const_iterator = Map::const_iterator;
+  using Builder = void (*)(const Request &request, Map &map);
+
+  explicit LazyStringMap(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) : map(resource) {}
+
+  template<typename InputIterator>
+  LazyStringMap(InputIterator first, InputIterator last) : map(first, last) {}
+
+  inline iterator begin() { return get().begin(); }
+  inline iterator end() { return get().end(); }
+  inline const_iterator begin() const { return get().begin(); }
+  inline const_iterator end() const { return get().end(); }
+
+  inline iterator find(const std::string &key) { return get().find(key); }
+  inline const_iterator find(const std::string &key) const { return get().find(key); }
+  inline size_type count(const std::string &key) const { return get().count(key); }
+  inline bool contains(const std::string &key) const { return get().count(key) > 0; }
+
+  inline std::string& operator[](const std::string &key) { return get()[key]; }
+  inline std::string& operator[](std::string &&key) { return get()[std::move(key)]; }
+  inline std::string& at(const std::string &key) { return get().at(key); }
+  inline const std::string& at(const std::string &key) const { return get().at(key); }
+
+  template<typename Value>
+  inline std::pair<iterator, bool> insert_or_assign(std::string key, Value &&value) {
+    return get().insert_or_assign(std::move(key), std::forward<Value>(value));
+  }
+  template<typename... Args>
+  inline std::pair<iterator, bool> emplace(Args&&... args) { return get().emplace(std::forward<Args>(args)...); }
+  inline size_type erase(const std::string &key) { return get().erase(key); }
+  inline iterator erase(const_iterator position) { return get().erase(position); }
+
+  inline size_type size() const { return get().size(); }
+  inline bool empty() const { return get().empty(); }
+  inline Map::allocator_type get_allocator() const { return map.get_allocator(); }
+  inline void clear() { builder = nullptr; map.clear(); }
+
+  /**
+   * @return bool Whether the map was built already, after that it is the only copy of its entries.
+   */
+  inline bool built() const { return builder == nullptr; }
+
+private:
+  friend class Request;
+
+  mutable Map map;
+  mutable Builder builder = nullptr;  ///< Fills map from owner on first use, nullptr once built.
+  const Request *owner = nullptr;
+
+  Map& get() const {
+    if(builder) {
+      Builder build = builder;
+      builder = nullptr;
+      build(*owner, map);
+    }
+    return map;
+  }
+};
 
 /**
  * @brief The Request class represents an HTTP request.
  *
  * Contains HTTP method, path, protocol version, payload, query parameters, headers, and body.
+ *
+ * Requests read by the server keep their maps and JSON body in the arena of the request, which is released
+ * in one piece once the response is written. Copy values that have to outlive the request, moving them
+ * out keeps them in the arena.
+ *
+ * The header block is kept as received and the getters hand out views into it, headers and query
+ * parameters are looked up without building the headers and query_parameters maps. Those maps, and
+ * path_parameters, are only filled when a handler touches them.
  */
 class Request {
 public:
+  using StringMap = std::pmr::unordered_map<std::string, std::string>;
+
   /**
    * @brief Default constructor initializes empty values.
    */
-  Request() : method(""), path(""), protocol(""), payload(""), query_parameters({}), path_parameters({}), headers({}) {}
+  Request() : method(""), path(""), protocol(""), payload("") {}
+
+  /**
+   * @brief Constructs an empty request whose maps allocate from resource.
+   *
+   * @param resource Memory resource that outlives the request, usually its RequestArena.
+   */
+  explicit Request(std::pmr::memory_resource *resource)
+      : protocol(""), query_parameters(resource), path_parameters(resource), headers(resource), head(resource),
+        headerSlices(resource), parameterSlices(resource) {
+    bindMaps();
+  }
 
   /**
    * @brief Parameterized constructor for initializing a request.
@@ -32,7 +138,8 @@ public:
       std::unordered_map<std::string, std::string> path_params,
       std::unordered_map<std::string, std::string> _headers)
       : method(_method), path(_path), url(_url), protocol(_protocol), payload(_payload),
-        query_parameters(query_params), path_parameters(path_params), headers(_headers) {}
+        query_parameters(query_params.begin(), query_params.end()),
+        path_parameters(path_params.begin(), path_params.end()), headers(_headers.begin(), _headers.end()) {}
 
   /**
    * @brief Copy constructor.
@@ -41,15 +148,227 @@ public:
    */
   Request(const Request &req)
       : method(req.method), path(req.path), url(req.url), protocol(req.protocol), payload(req.payload),
-        query_parameters(req.query_parameters), path_parameters(req.path_parameters), headers(req.headers) {}
+        query_parameters(req.query_parameters), path_parameters(settled(req.path_parameters)), headers(req.headers),
+        body(req.body), head(req.head), headerSlices(req.headerSlices), knownHeaders(req.knownHeaders) {
+    bindMaps();
+  }
+
+  Request(Request &&req)
+      : method(std::move(req.method)), path(std::move(req.path)), url(std::move(req.url)),
+        protocol(std::move(req.protocol)), payload(std::move(req.payload)),
+        query_parameters(std::move(req.query_parameters)),
+        path_parameters(settled(std::move(req.path_parameters))),
+        headers(std::move(req.headers)), body(std::move(req.body)), head(std::move(req.head)),
+        headerSlices(std::move(req.headerSlices)), knownHeaders(req.knownHeaders) {
+    bindMaps();
+  }
+
+  Request& operator=(Request req) {
+    document.reset();
+    method = std::move(req.method);
+    path = std::move(req.path);
+    url = std::move(req.url);
+    protocol = std::move(req.protocol);
+    payload = std::move(req.payload);
+    query_parameters = std::move(req.query_parameters);
+    path_parameters = std::move(req.path_parameters);
+    headers = std::move(req.headers);
+    body = std::move(req.body);
+    head = std::move(req.head);
+    headerSlices = std::move(req.headerSlices);
+    knownHeaders = req.knownHeaders;
+    bindMaps();
+    return *this;
+  }
 
   std::string method;  ///< HTTP method.
   std::string path;    ///< URL path.
   std::string url;    ///< Complete URL of the request
   std::string protocol = "HTTP/1.1";  ///< HTTP protocol version.
   std::string payload; ///< Raw request payload.
-  std::unordered_map<std::string, std::string> query_parameters;  ///< Query parameters from URL.
-  std::unordered_map<std::string, std::string> path_parameters;  ///< Path parameters from URL.
-  std::unordered_map<std::string, std::string> headers;  ///< HTTP headers.
+  LazyStringMap query_parameters;  ///< Decoded query parameters from URL, built on first use.
+  LazyStringMap path_parameters;  ///< Path parameters from URL, built on first use.
+  LazyStringMap headers;  ///< HTTP headers, built on first use.
   JSONValue body;      ///< Parsed JSON body (if applicable).
-};
\ No newline at end of file
+
+  inline std::string_view getMethod() const { return method; }
+  inline std::string_view getUrl() const { return url; }
+  inline std::string_view getPath() const { return path; }
+  inline std::string_view getProtocol() const { return protocol; }
+  inline std::string_view getBody() const { return payload; }
+
+  /**
+   * @return std::string_view The still encoded part of the URL after '?', empty if there is none.
+   */
+  inline std::string_view getQueryString() const {
+    size_t questionMark = url.find('?');
+    return questionMark == std::string::npos ? std::string_view() : std::string_view(url).substr(questionMark + 1);
+  }
+
+  /**
+   * @brief Gets a decoded query parameter, decoding all of them on the first call.
+   *
+   * @return std::string_view The value, empty if the parameter is missing.
+   */
+  std::string_view getQuery(const std::string &key) const {
+    auto it = query_parameters.find(key);
+    return it == query_parameters.end() ? std::string_view() : std::string_view(it->second);
+  }
+
+  /**
+   * @brief Gets a header value, comparing names case-insensitively. The last one wins if a header repeats.
+   *
+   * Well-known names resolve to their slot through the perfect hash, only custom headers are searched for.
+   *
+   * @return std::string_view The value without surrounding whitespace, empty if the header is missing.
+   */
+  std::string_view getHeader(std::string_view name) const {
+    HttpHeader header = lookupHttpHeader(name);
+    if(header != HttpHeader::Unknown)
+      return getHeader(header);
+    return findHeader(name).value_or(std::string_view());
+  }
+
+  /**
+   * @brief Gets a well-known header in constant time while the headers map is unbuilt.
+   */
+  std::string_view getHeader(HttpHeader header) const {
+    if(headers.built())
+      return findHeader(httpHeaderName(header)).value_or(std::string_view());
+    uint16_t slot = knownHeaders[static_cast<size_t>(header)];
+    return slot == 0 ? std::string_view() : view(headerSlices[slot - 1].value);
+  }
+
+  inline bool hasHeader(std::string_view name) const {
+    HttpHeader header = lookupHttpHeader(name);
+    if(header != HttpHeader::Unknown)
+      return hasHeader(header);
+    return findHeader(name).has_value();
+  }
+
+  inline bool hasHeader(HttpHeader header) const {
+    if(headers.built())
+      return findHeader(httpHeaderName(header)).has_value();
+    return knownHeaders[static_cast<size_t>(header)] != 0;
+  }
+
+  /**
+   * @brief Calls function(name, value) for every header, in the order received unless the map was built.
+   */
+  template<typename Function>
+  void forEachHeader(Function function) const {
+    if(headers.built()) {
+      for(const auto &it : headers.map)
+        function(std::string_view(it.first), std::string_view(it.second));
+      return;
+    }
+    for(const HeaderSlice &slice : headerSlices)
+      function(view(slice.name), view(slice.value));
+  }
+
+  /**
+   * @brief The payload as a JSONDocument, parsed on the first call and read on demand.
+   *
+   * An alternative to JsonBodyParser and body for handlers that read a few fields of a large body, no JSONValue
+   * is built for the fields they skip. The document lives in the arena of the request and refers to payload,
+   * which must not change afterwards. Copies and moves of the request parse again.
+   *
+   * @throws json_parse_error if the payload is not valid JSON, on every call. Left uncaught, the server answers
+   * 400 Bad Request.
+   */
+  const JSONDocument& json() const {
+    if(!document) {
+      JSONDocument parsed(memoryResource());
+      parsed.parse(payload);
+      document.emplace(std::move(parsed));
+    }
+    return *document;
+  }
+
+  /**
+   * @brief Gets the memory resource the request's containers allocate from, for data that lives as long as it.
+   */
+  inline std::pmr::memory_resource* memoryResource() const { return path_parameters.get_allocator().resource(); }
+
+private:
+  friend class HttpServer;
+  friend class Router;
+
+  struct Slice {
+    size_t offset = 0;
+    size_t length = 0;
+  };
+
+  struct HeaderSlice {
+    Slice name;
+    Slice value;
+  };
+
+  std::pmr::string head;                        ///< Request line and headers as received, the slices point into it.
+  std::pmr::vector<HeaderSlice> headerSlices;  ///< Trimmed header names and values, in the order received.
+  /// Per well-known header the index plus one of its last entry in headerSlices, 0 if it was not sent.
+  std::array<uint16_t, HTTP_HEADER_COUNT> knownHeaders{};
+  /// Names of the path parameters, owned by the matched route, and where their values are in path.
+  const std::vector<std::string> *parameterNames = nullptr;
+  std::pmr::vector<Slice> parameterSlices;
+  /// Typed parameters of a route registered with a compile-time pattern, allocated from memoryResource().
+  const void *routeParameters = nullptr;
+  mutable std::optional<JSONDocument> document;  ///< Built by json(), refers to payload.
+
+  inline std::string_view view(Slice slice) const { return std::string_view(head).substr(slice.offset, slice.length); }
+
+  std::optional<std::string_view> findHeader(std::string_view name) const {
+    std::optional<std::string_view> value;
+    forEachHeader([&](std::string_view key, std::string_view candidate) {
+      if(equalsIgnoreCase(key, name))
+        value = candidate;
+    });
+    return value;
+  }
+
+  inline void bindMaps() {
+    headers.owner = this;
+    query_parameters.owner = this;
+    path_parameters.owner = this;
+  }
+
+  /**
+   * @brief Makes the request read its headers from head and decode its query parameters with decoder on demand.
+   */
+  inline void deferMaps(LazyStringMap::Builder decoder) {
+    headers.builder = &buildHeaders;
+    query_parameters.builder = decoder;
+  }
+
+  /**
+   * @brief Makes path_parameters name the values in parameterSlices with names once it is used.
+   */
+  inline void deferPathParameters(const std::vector<std::string> &names) {
+    parameterNames = &names;
+    path_parameters.builder = &buildPathParameters;
+  }
+
+  // The names belong to a route that may be gone once the request was handled, copies take the map built.
+  static const LazyStringMap& settled(const LazyStringMap &map) {
+    map.size();
+    return map;
+  }
+  static LazyStringMap&& settled(LazyStringMap &&map) {
+    map.size();
+    return std::move(map);
+  }
+
+  static void buildPathParameters(const Request &request, LazyStringMap::Map &map) {
+    std::string_view routed = request.path;
+    for(size_t i = 0; i < request.parameterSlices.size(); i++) {
+      Slice slice = request.parameterSlices[i];
+      map.insert_or_assign((*request.parameterNames)[i],
+                           std::string(routed.substr(std::min(slice.offset, routed.size()), slice.length)));
+    }
+  }
+
+  static void buildHeaders(const Request &request, LazyStringMap::Map &map) {
+    for(const HeaderSlice &slice : request.headerSlices)
+      map.insert_or_assign(std::string(request.view(slice.name)), std::string(request.view(slice.value)));
+  }
+};
@@ -1,15 +1,25 @@
 #pragma once
 
+#include <array>
 #include <unordered_map>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "httpheaders.h"
 #include "json.h"
 
 /**
  * @brief The Response class represents an HTTP response.
  *
  * It contains the status code, payload, protocol, and headers. Methods allow for setting these
- * attributes and for converting JSON responses.
+ * attributes and for converting JSON responses. Content-Length is always computed when the response is
+ * serialized, and Content-Type defaults to "text/plain; charset=UTF-8" unless a handler sets it.
+ *
+ * Well-known headers are kept in slots indexed by HttpHeader and written with their canonical names, the
+ * headers map only holds custom ones. Header names are matched case-insensitively.
  */
 class Response {
   int statusCode = 200;   ///< HTTP status code.
@@ -17,15 +27,30 @@ class Response {
   std::string protocol = "HTTP/1.1";   ///< HTTP protocol version.
   std::string file_path;
   bool isFileResponse = false;
+  bool headResponse = false;            ///< Answers a HEAD request, only the header block is sent.
+  std::optional<size_t> contentLength;  ///< Length announced for a body the handler did not build.
+
+  struct KnownHeader {
+    HttpHeader header;
+    std::pmr::string value;
+  };
+
+  std::pmr::vector<KnownHeader> knownHeaders;  ///< Well-known headers in the order they were first set.
+  std::array<uint8_t, HTTP_HEADER_COUNT> knownSlots{};  ///< Index plus one into knownHeaders, 0 if unset.
 
   static const std::string getMimeType(const std::string& extension);
 
 public:
-  Response() {
-    headers["Content-Type"] = "text/plain; charset=UTF-8";
-  }
+  Response() = default;
+
+  /**
+   * @brief Constructs a response whose headers allocate from resource.
+   *
+   * @param resource Memory resource that outlives the response, usually the arena of its request.
+   */
+  explicit Response(std::pmr::memory_resource *resource) : knownHeaders(resource), headers(resource) {}
 
-  std::unordered_map<std::string, std::string> headers;  ///< HTTP headers.
+  std::pmr::unordered_map<std::string, std::string> headers;  ///< Custom HTTP headers, see setHeader().
 
   /**
    * @brief Sets the HTTP protocol version.
@@ -42,14 +67,42 @@ public:
    *
    * @return std::string The protocol string.
    */
-  inline std::string getProtocol() const { return protocol; }
+  inline const std::string& getProtocol() const { return protocol; }
 
   /**
    * @brief Gets the response payload.
    *
-   * @return std::string The payload.
+   * @return const std::string& The payload.
+   */
+  inline const std::string& getPayload() const { return payload; }
+
+  /**
+   * @brief Moves the payload out of the response, so it can be written without another copy.
+   *
+   * @return std::string The payload, the response is left without one.
+   */
+  inline std::string takePayload() { return std::move(payload); }
+
+  /**
+   * @brief Whether the response answers a HEAD request. Its body is never sent: send() only takes note of the
+   * length, and a handler may skip building the body and announce its length with setContentLength() instead.
+   */
+  inline bool isHeadResponse() const { return headResponse; }
+
+  /**
+   * @brief Sets the Content-Length of a HEAD response whose body was not built, other responses ignore it.
+   */
+  inline Response& setContentLength(size_t length) {
+    contentLength = length;
+    return *this;
+  }
+
+  /**
+   * @return size_t Content-Length of the response given the size of the body it would send.
    */
-  inline std::string getPayload() const { return payload; }
+  inline size_t announcedLength(size_t bodySize) const {
+    return headResponse && contentLength ? *contentLength : bodySize;
+  }
 
   /**
    * @brief Gets the HTTP status code.
@@ -95,11 +148,46 @@ public:
   Response& download(const std::string_view file_path);
 
   /**
-   * @brief Sets a header for the response.
+   * @brief Sets a header for the response, replacing one of the same name in any case.
    *
    * @param key Header name.
    * @param value Header value.
    * @return Response reference to the current response.
    */
   Response& setHeader(const std::string_view key, const std::string_view value);
+
+  /**
+   * @brief Sets a well-known header without looking up its name.
+   */
+  Response& setHeader(HttpHeader header, const std::string_view value);
+
+  /**
+   * @return std::string_view The value of a header, empty if it is not set.
+   */
+  std::string_view getHeader(const std::string_view key) const;
+
+  std::string_view getHeader(HttpHeader header) const;
+
+  bool hasHeader(HttpHeader header) const;
+
+  /**
+   * @brief Calls function(name, value) for every header, the well-known ones first under their canonical names.
+   */
+  template<typename Function>
+  void forEachHeader(Function function) const {
+    for(const KnownHeader &known : knownHeaders)
+      function(httpHeaderName(known.header), std::string_view(known.value));
+    for(const auto &it : headers)
+      function(std::string_view(it.first), std::string_view(it.second));
+  }
+
+private:
+  friend class HttpServer;
+
+  const std::string* findCustomHeader(const std::string_view key) const;
+
+  /**
+   * @brief Discards everything a handler set, except the protocol and whether a HEAD request is answered.
+   */
+  void reset();
 };
\ No newline at end of file
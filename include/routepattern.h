@@ -0,0 +1,151 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "routetree.h"
+
+/**
+ * @brief Types a path parameter of a compile-time route pattern can have, written as ":name<type>".
+ */
+enum class RouteParameterType : uint8_t {
+  String,  ///< "str" or no annotation, a std::string_view into the path.
+  U32,     ///< "u32", uint32_t.
+  U64,     ///< "u64", uint64_t.
+  I32,     ///< "i32", int32_t.
+  I64,     ///< "i64", int64_t.
+  F64      ///< "f64", double.
+};
+
+template<RouteParameterType Type> struct RouteParameterValue { using type = std::string_view; };
+template<> struct RouteParameterValue<RouteParameterType::U32> { using type = uint32_t; };
+template<> struct RouteParameterValue<RouteParameterType::U64> { using type = uint64_t; };
+template<> struct RouteParameterValue<RouteParameterType::I32> { using type = int32_t; };
+template<> struct RouteParameterValue<RouteParameterType::I64> { using type = int64_t; };
+template<> struct RouteParameterValue<RouteParameterType::F64> { using type = double; };
+
+/**
+ * @brief A route pattern as template argument, server.Get<"/users/:id<u64>">(handler) deduces it from the literal.
+ */
+template<size_t N>
+struct RoutePattern {
+  char text[N] = {};
+
+  constexpr RoutePattern(const char (&pattern)[N]) {
+    for(size_t i = 0; i < N; i++)
+      text[i] = pattern[i];
+  }
+
+  constexpr std::string_view view() const { return std::string_view(text, N - 1); }
+};
+
+/**
+ * @brief A pattern taken apart at compile time.
+ */
+template<size_t N>
+struct ParsedRoutePattern {
+  char path[N] = {};   ///< The pattern without type annotations, the form RouteTree takes.
+  size_t pathLength = 0;
+  RouteParameterType types[RouteTree::MAX_PARAMETERS] = {};
+  size_t parameterCount = 0;
+};
+
+constexpr RouteParameterType parseRouteParameterType(std::string_view name) {
+  if(name == "str") return RouteParameterType::String;
+  if(name == "u32") return RouteParameterType::U32;
+  if(name == "u64") return RouteParameterType::U64;
+  if(name == "i32") return RouteParameterType::I32;
+  if(name == "i64") return RouteParameterType::I64;
+  if(name == "f64") return RouteParameterType::F64;
+  throw std::invalid_argument("unknown route parameter type, use str, u32, u64, i32, i64 or f64");
+}
+
+/**
+ * @brief Splits a pattern into its plain path and parameter types. Malformed patterns fail to compile.
+ */
+template<size_t N>
+constexpr ParsedRoutePattern<N> parseRoutePattern(std::string_view pattern) {
+  ParsedRoutePattern<N> parsed;
+  size_t i = 0;
+  while(i < pattern.size()) {
+    if(pattern[i] != ':' || (i > 0 && pattern[i - 1] != '/')) {
+      parsed.path[parsed.pathLength++] = pattern[i++];
+      continue;
+    }
+
+    size_t nameEnd = i + 1;
+    while(nameEnd < pattern.size() && pattern[nameEnd] != '/' && pattern[nameEnd] != '<')
+      nameEnd++;
+    if(nameEnd == i + 1)
+      throw std::invalid_argument("route parameter without a name");
+    for(; i < nameEnd; i++)
+      parsed.path[parsed.pathLength++] = pattern[i];
+
+    RouteParameterType type = RouteParameterType::String;
+    if(i < pattern.size() && pattern[i] == '<') {
+      size_t close = pattern.find('>', i);
+      if(close == std::string_view::npos)
+        throw std::invalid_argument("route parameter type without a closing '>'");
+      type = parseRouteParameterType(pattern.substr(i + 1, close - i - 1));
+      i = close + 1;
+      if(i < pattern.size() && pattern[i] != '/')
+        throw std::invalid_argument("a typed route parameter has to end its segment");
+    }
+    if(parsed.parameterCount == RouteTree::MAX_PARAMETERS)
+      throw std::invalid_argument("too many route parameters");
+    parsed.types[parsed.parameterCount++] = type;
+  }
+  return parsed;
+}
+
+/**
+ * @brief Converts the text of a parameter, the whole text has to be a value of the type.
+ */
+template<typename Value>
+inline bool convertRouteParameter(std::string_view text, Value &value) {
+  if constexpr(std::is_same_v<Value, std::string_view>) {
+    value = text;
+    return true;
+  } else {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size();
+  }
+}
+
+/**
+ * @brief Everything the server needs to know about a compile-time pattern.
+ *
+ * Parameters is the tuple of parameter values in pattern order, convert() fills it from the views a
+ * RouteTree match produced and fails as soon as one of them is not a value of its type. The pattern's
+ * parameters are the last ones of the match, a group prefix in front of the pattern may add others.
+ */
+template<RoutePattern Pattern>
+struct CompiledRoute {
+  static constexpr ParsedRoutePattern<sizeof(Pattern.text)> parsed =
+      parseRoutePattern<sizeof(Pattern.text)>(Pattern.view());
+
+  static constexpr std::string_view path() { return std::string_view(parsed.path, parsed.pathLength); }
+
+  template<size_t... Index>
+  static auto tupleOf(std::index_sequence<Index...>)
+      -> std::tuple<typename RouteParameterValue<parsed.types[Index]>::type...>;
+
+  using Parameters = decltype(tupleOf(std::make_index_sequence<parsed.parameterCount>()));
+
+  static bool convert(const RouteTree::Match &match, Parameters &values) {
+    return convertAll(match, values, std::make_index_sequence<parsed.parameterCount>());
+  }
+
+private:
+  template<size_t... Index>
+  static bool convertAll(const RouteTree::Match &match, Parameters &values, std::index_sequence<Index...>) {
+    const size_t first = match.parameterCount - parsed.parameterCount;
+    return (convertRouteParameter(match.parameters[first + Index], std::get<Index>(values)) && ...);
+  }
+};
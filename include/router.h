@@ -0,0 +1,173 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "httpmethod.h"
+#include "pipeline.h"
+#include "request.h"
+#include "response.h"
+#include "routepattern.h"
+#include "routetree.h"
+
+class HttpServer;
+
+/**
+ * @brief A set of routes under a common path prefix, with middlewares for all of them.
+ *
+ * A Router built on its own only records what is registered on it, server.mount("/api", router) then adds all of
+ * it below the prefix, and the same router can be mounted several times. server.group("/api/v1", {auth}) returns
+ * a router that is part of the server, routes registered on it are added right away.
+ *
+ * Middlewares of a router, passed to group() or added with use(), belong to its prefix: they run for every route
+ * whose pattern lies beneath it, also routes registered on the server directly, after the global middlewares and
+ * those of shorter prefixes. Which prefixes cover a route is decided once when the server compiles its routes,
+ * a request never runs a middleware only to find out that its path is outside the group.
+ */
+class Router {
+public:
+  Router() = default;
+  Router(Router&&) = default;
+  Router& operator=(Router&&) = default;
+
+  /**
+   * @brief Adds a middleware for all routes beneath the prefix of this router.
+   */
+  void use(Middleware middleware);
+
+  /**
+   * @brief Creates a router for the routes beneath prefix, relative to this one.
+   *
+   * @param prefix Path prefix like "/admin", may contain parameters.
+   * @param middlewares Middlewares for all routes beneath the prefix.
+   * @return Router& The group, it lives as long as this router.
+   */
+  Router& group(const std::string &prefix, const std::vector<Middleware> &middlewares = {});
+
+  /**
+   * @brief Adds the routes, middlewares and groups of another router beneath prefix, copying them.
+   */
+  void mount(const std::string &prefix, const Router &router);
+
+  void Get(const std::string &path, const std::vector<Middleware> &middlewares, std::function<void(Request&, Response&)> handler);
+  void Get(const std::string &path, std::function<void(Request&, Response&)> handler);
+  void Post(const std::string &path, const std::vector<Middleware> &middlewares, std::function<void(Request&, Response&)> handler);
+  void Post(const std::string &path, std::function<void(Request&, Response&)> handler);
+  void Patch(const std::string &path, const std::vector<Middleware> &middlewares, std::function<void(Request&, Response&)> handler);
+  void Patch(const std::string &path, std::function<void(Request&, Response&)> handler);
+  void Put(const std::string &path, const std::vector<Middleware> &middlewares, std::function<void(Request&, Response&)> handler);
+  void Put(const std::string &path, std::function<void(Request&, Response&)> handler);
+  void Delete(const std::string &path, const std::vector<Middleware> &middlewares, std::function<void(Request&, Response&)> handler);
+  void Delete(const std::string &path, std::function<void(Request&, Response&)> handler);
+
+  /**
+   * @brief Registers a GET route with a compile-time pattern, see HttpServer::Get<Pattern>().
+   */
+  template<RoutePattern Pattern, typename Handler>
+  void Get(Handler handler) { addTypedRoute<Pattern>(HttpMethod::Get, {}, std::move(handler)); }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Get(const std::vector<Middleware> &middlewares, Handler handler) {
+    addTypedRoute<Pattern>(HttpMethod::Get, middlewares, std::move(handler));
+  }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Post(Handler handler) { addTypedRoute<Pattern>(HttpMethod::Post, {}, std::move(handler)); }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Post(const std::vector<Middleware> &middlewares, Handler handler) {
+    addTypedRoute<Pattern>(HttpMethod::Post, middlewares, std::move(handler));
+  }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Patch(Handler handler) { addTypedRoute<Pattern>(HttpMethod::Patch, {}, std::move(handler)); }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Patch(const std::vector<Middleware> &middlewares, Handler handler) {
+    addTypedRoute<Pattern>(HttpMethod::Patch, middlewares, std::move(handler));
+  }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Put(Handler handler) { addTypedRoute<Pattern>(HttpMethod::Put, {}, std::move(handler)); }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Put(const std::vector<Middleware> &middlewares, Handler handler) {
+    addTypedRoute<Pattern>(HttpMethod::Put, middlewares, std::move(handler));
+  }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Delete(Handler handler) { addTypedRoute<Pattern>(HttpMethod::Delete, {}, std::move(handler)); }
+
+  template<RoutePattern Pattern, typename Handler>
+  void Delete(const std::vector<Middleware> &middlewares, Handler handler) {
+    addTypedRoute<Pattern>(HttpMethod::Delete, middlewares, std::move(handler));
+  }
+
+private:
+  friend class HttpServer;
+
+  /**
+   * @brief A route as registered on a router that is not part of a server.
+   */
+  struct Definition {
+    HttpMethod method = HttpMethod::Get;
+    std::string path;
+    std::vector<Middleware> middlewares;
+    std::function<void(Request&, Response&)> handler;
+    bool (*bindParameters)(Request &req, const RouteTree::Match &match) = nullptr;
+  };
+
+  HttpServer *server = nullptr;  ///< Server the routes go to, nullptr while the router only records them.
+  std::string prefix;            ///< Prefix of this router within the server.
+  std::vector<Middleware> middlewares;
+  std::vector<Definition> routes;
+  std::vector<std::pair<std::string, std::unique_ptr<Router>>> groups;
+
+  Router(HttpServer *server, std::string prefix) : server(server), prefix(std::move(prefix)) {}
+
+  /**
+   * @brief Joins two path prefixes, the route tree ignores the doubled or trailing '/' this may leave.
+   */
+  static std::string joinPath(const std::string &prefix, const std::string &path) {
+    return prefix.empty() ? path : prefix + "/" + path;
+  }
+
+  void add(Definition route);
+
+  /**
+   * @brief Converts the parameters of a compiled pattern into a tuple in the arena of the request.
+   *
+   * The pattern's own parameters are the last ones of the match, the prefix of a group may add some before them.
+   */
+  template<typename Compiled>
+  static bool bindRouteParameters(Request &req, const RouteTree::Match &match) {
+    using Parameters = typename Compiled::Parameters;
+    static_assert(std::is_trivially_destructible_v<Parameters>, "released with the arena, never destroyed");
+    Parameters values;
+    if(!Compiled::convert(match, values))
+      return false;
+    void *storage = req.memoryResource()->allocate(sizeof(Parameters), alignof(Parameters));
+    req.routeParameters = new(storage) Parameters(values);
+    return true;
+  }
+
+  template<RoutePattern Pattern, typename Handler>
+  void addTypedRoute(HttpMethod method, const std::vector<Middleware> &middlewares, Handler handler) {
+    using Compiled = CompiledRoute<Pattern>;
+    using Parameters = typename Compiled::Parameters;
+    auto invoke = [handler = std::move(handler)](Request &req, Response &res) mutable {
+      const Parameters &parameters = *static_cast<const Parameters*>(req.routeParameters);
+      if constexpr(std::is_invocable_v<Handler&, Request&, Response&, const Parameters&>)
+        handler(req, res, parameters);
+      else
+        std::apply([&](const auto&... values) { handler(req, res, values...); }, parameters);
+    };
+    add({method, std::string(Compiled::path()), middlewares, std::move(invoke), &bindRouteParameters<Compiled>});
+  }
+};
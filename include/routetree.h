@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Compressed radix tree over route patterns, matched in one pass over the path.
+ *
+ * A pattern is a path whose segments are literal text or a ":name" parameter taking one whole segment.
+ * Literal text is stored radix style, every edge labelled with the longest prefix the patterns below it
+ * share, and parameters are nodes of their own. Registration builds the tree from heap nodes, freeze() or
+ * the first match after an insert flattens it into one contiguous array, the literal children of a node next
+ * to each other and all labels in one string, so a lookup walks a few cache lines and never allocates.
+ *
+ * Literal edges take precedence over parameters, and a literal branch that dead-ends is backtracked: with
+ * "/users/new/edit" and "/users/:id/posts" registered, "/users/new/posts" matches the second pattern.
+ * Runs of '/' in a path count as one and trailing slashes are ignored.
+ *
+ * Once all routes are registered, freeze() compiles the patterns without parameters into a minimal perfect
+ * hash table. A path spelled exactly like one of them is then answered by one hash and one comparison, only
+ * the other paths walk the tree. A frozen tree never changes, so any number of threads may match at once, an
+ * unfrozen one may only be matched by the thread inserting into it.
+ */
+class RouteTree {
+public:
+  static constexpr uint32_t NO_ROUTE = UINT32_MAX;
+  static constexpr size_t MAX_PARAMETERS = 16;
+
+  /**
+   * @brief Result of match(), the parameters are views into the matched path.
+   */
+  struct Match {
+    uint32_t route = NO_ROUTE;  ///< Handle of the matched pattern.
+    size_t parameterCount = 0;
+    std::array<std::string_view, MAX_PARAMETERS> parameters;  ///< Parameter values in pattern order.
+  };
+
+  RouteTree();
+  ~RouteTree();
+
+  /**
+   * @brief Adds a pattern, patterns that only differ in their parameter names share one handle.
+   *
+   * @param pattern Path like "/users/:id/posts".
+   * @param parameterNames Receives the parameter names in pattern order, if not nullptr.
+   * @return uint32_t Handle of the pattern, handles are dense and count up from 0.
+   * @throws std::runtime_error If a parameter has no name, the pattern has more than MAX_PARAMETERS or the
+   *         tree is frozen.
+   */
+  uint32_t insert(std::string_view pattern, std::vector<std::string> *parameterNames = nullptr);
+
+  /**
+   * @return uint32_t Handle of a registered pattern, NO_ROUTE if it was never inserted.
+   */
+  uint32_t find(std::string_view pattern) const;
+
+  /**
+   * @brief Finds the pattern matching path.
+   *
+   * @return bool Whether a pattern matched, match is only meaningful if so.
+   */
+  bool match(std::string_view path, Match &match) const;
+
+  /**
+   * @return std::string The pattern with unnamed parameters and normalized slashes, "/users/:" for "/users/:id/".
+   */
+  static std::string shapeOf(std::string_view pattern) { return parsePattern(pattern, nullptr); }
+
+  /**
+   * @brief Whether every path matching pattern lies beneath prefix, segment by segment.
+   *
+   * "/api" covers "/api" and "/api/users" but not "/apis", "/users/:id" covers "/users/:uid/posts".
+   */
+  static bool covers(std::string_view prefix, std::string_view pattern);
+
+  /**
+   * @return size_t Number of distinct patterns.
+   */
+  inline size_t size() const { return shapes.size(); }
+
+  /**
+   * @brief Builds the perfect hash table of the static patterns and makes the tree immutable.
+   */
+  void freeze();
+
+  inline bool frozen() const { return isFrozen; }
+
+private:
+  static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+  struct Node {
+    uint32_t labelOffset = 0;   ///< Literal text of the edge into this node, in labels.
+    uint32_t labelLength = 0;
+    uint32_t firstChild = 0;    ///< Literal children are the nodes [firstChild, firstChild + childCount).
+    uint32_t childCount = 0;
+    uint32_t parameterChild = NO_NODE;  ///< Node reached by taking one segment as a parameter.
+    uint32_t route = NO_ROUTE;  ///< Pattern ending here.
+  };
+
+  struct BuildNode;
+
+  struct StaticSlot {
+    uint32_t keyOffset = 0;  ///< The pattern, in staticKeys.
+    uint32_t keyLength = 0;
+    uint32_t route = NO_ROUTE;
+  };
+
+  std::unique_ptr<BuildNode> root;  ///< Tree as registered, only used to rebuild nodes.
+  std::unordered_map<std::string, uint32_t> shapes;  ///< Patterns with unnamed parameters, like "/users/:", to handles.
+  mutable std::vector<Node> nodes;  ///< The flattened tree, the root first.
+  mutable std::string labels;
+  mutable bool stale = true;  ///< Patterns were inserted since the tree was last flattened.
+
+  bool isFrozen = false;
+  uint64_t staticSeed = 0;
+  std::vector<uint32_t> staticDisplacements;  ///< Per bucket of keys the value that spreads them over free slots.
+  std::vector<StaticSlot> staticSlots;        ///< One slot per static pattern, empty until frozen.
+  std::string staticKeys;
+
+  static uint64_t hashPath(std::string_view path, uint64_t seed);
+  static inline uint32_t reduce(uint32_t value, size_t range) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(value) * range) >> 32);
+  }
+  static inline uint32_t staticSlot(uint64_t hash, uint32_t displacement, size_t slots) {
+    // Mixed before the reduction, which only looks at high bits: keys whose hashes differ in low bits would
+    // otherwise share a slot for almost every displacement.
+    uint32_t value = (static_cast<uint32_t>(hash) ^ (displacement * 0x9E3779B9u)) * 0x85EBCA6Bu;
+    return reduce(value ^ (value >> 15), slots);
+  }
+  uint32_t findStatic(std::string_view path) const;
+
+  /**
+   * @brief Splits a pattern into its shape and parameter names.
+   */
+  static std::string parsePattern(std::string_view pattern, std::vector<std::string> *parameterNames);
+  void flatten() const;
+  bool matchLiteral(const Node &node, std::string_view path, size_t position, Match &match) const;
+  bool matchBelow(const Node &node, std::string_view path, size_t position, Match &match) const;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+/**
+ * @brief Minimal io_uring wrapper over the raw kernel interface, used by the io_uring reactor engine.
+ *
+ * Owns one submission/completion ring pair and optionally one provided-buffer ring. An instance is
+ * only ever driven by a single thread, the kernel is the only other party touching the shared rings.
+ */
+class IoUring {
+  int ringFd = -1;
+
+  unsigned *sqHead = nullptr;
+  unsigned *sqTail = nullptr;
+  unsigned *sqArray = nullptr;
+  unsigned sqMask = 0;
+  unsigned sqEntries = 0;
+  io_uring_sqe *sqes = nullptr;
+  unsigned sqeTail = 0;     ///< Next SQE handed out by getSqe().
+  unsigned sqeSubmitted = 0; ///< SQEs already published to the kernel.
+
+  unsigned *cqHead = nullptr;
+  unsigned *cqTail = nullptr;
+  unsigned cqMask = 0;
+  io_uring_cqe *cqes = nullptr;
+
+  void *sqRing = nullptr;
+  void *cqRing = nullptr;
+  size_t sqRingSize = 0;
+  size_t cqRingSize = 0;
+  size_t sqesSize = 0;
+
+  io_uring_buf_ring *bufferRing = nullptr;
+  char *bufferPool = nullptr;
+  unsigned bufferCount = 0;
+  unsigned bufferSize = 0;
+  unsigned short bufferTail = 0;
+
+public:
+  /**
+   * @brief Creates the ring and maps its queues.
+   *
+   * @param entries Submission queue size, rounded up to a power of two by the kernel.
+   * @throws std::runtime_error if io_uring is unavailable.
+   */
+  explicit IoUring(unsigned entries);
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+  ~IoUring();
+
+  /**
+   * @brief Returns a zeroed submission entry, submitting queued entries first if the queue is full.
+   *
+   * @return io_uring_sqe* The entry, or nullptr if the kernel has not consumed any entry yet.
+   */
+  io_uring_sqe* getSqe();
+
+  /**
+   * @brief Publishes every entry handed out since the last call and optionally waits for completions,
+   *        all in a single io_uring_enter().
+   *
+   * @param waitFor Number of completions to wait for.
+   * @return int Result of io_uring_enter().
+   */
+  int submit(unsigned waitFor = 0);
+
+  /**
+   * @brief Calls handler for every available completion, then releases them to the kernel.
+   */
+  template<typename Handler>
+  unsigned forEachCompletion(Handler &&handler) {
+    unsigned head = *cqHead;
+    unsigned tail = std::atomic_ref<unsigned>(*cqTail).load(std::memory_order_acquire);
+    unsigned seen = tail - head;
+    for(; head != tail; head++)
+      handler(cqes[head & cqMask]);
+    std::atomic_ref<unsigned>(*cqHead).store(head, std::memory_order_release);
+    return seen;
+  }
+
+  /**
+   * @brief Registers a provided-buffer ring the kernel picks receive buffers from.
+   *
+   * @param count Number of buffers, must be a power of two.
+   * @param size Size of every buffer in bytes.
+   * @param groupId Buffer group id referenced by IOSQE_BUFFER_SELECT submissions.
+   * @throws std::runtime_error if the kernel does not support buffer rings.
+   */
+  void registerBufferRing(unsigned count, unsigned size, unsigned short groupId);
+
+  /**
+   * @brief Gets the memory of a provided buffer selected by the kernel.
+   */
+  inline char* buffer(unsigned short bufferId) const { return bufferPool + static_cast<size_t>(bufferId) * bufferSize; }
+
+  /**
+   * @brief Hands a provided buffer back to the kernel once its data was consumed.
+   */
+  void recycleBuffer(unsigned short bufferId);
+
+  inline int fd() const { return ringFd; }
+};
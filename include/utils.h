@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 
 /**
  * @brief Trims whitespace from both ends of the input string.
@@ -11,6 +12,19 @@
  */
 std::string trim(const std::string_view view);
 
+/**
+ * @brief Strips whitespace from both ends of the input without copying it.
+ *
+ * @param view The text to trim.
+ * @return std::string_view The trimmed part of view.
+ */
+std::string_view trimView(std::string_view view);
+
+/**
+ * @brief Compares two ASCII strings ignoring case, the way HTTP compares header names and tokens.
+ */
+bool equalsIgnoreCase(std::string_view a, std::string_view b);
+
 /**
  * @brief Splits a string into a vector of substrings based on a delimiter.
  *
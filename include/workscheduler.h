@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+#include "workstealingdeque.h"
+
+/**
+ * @brief Hands tasks to a fixed set of worker threads through per-worker work-stealing deques.
+ *
+ * Producers drop tasks into the injection queue of the worker picked by their hint, so concurrent
+ * producers rarely meet on a lock. A worker moves its injected tasks into its Chase-Lev deque in one
+ * batch and runs them from there, workers that run dry steal from the others. An idle worker spins for
+ * a while before parking on an atomic, and producers only wake a parked worker when nobody is spinning.
+ */
+template<typename Task>
+class WorkScheduler {
+  struct alignas(64) Worker {
+    WorkStealingDeque<Task> deque;
+    std::mutex injectedMutex;
+    std::deque<Task*> injected;              ///< Tasks submitted for this worker, not yet in its deque.
+    std::atomic<size_t> injectedCount{0};
+    std::atomic<uint32_t> epoch{0};          ///< Bumped to wake the worker from park().
+    std::atomic<bool> sleeping{false};
+    std::vector<Task*> batch;                ///< Scratch space of takeInjected(), owner only.
+    uint32_t victimSeed;
+  };
+
+  static constexpr unsigned SPIN_ROUNDS = 64;  ///< Failed searches before an idle worker parks.
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::atomic<size_t> spinning{0};   ///< Workers currently searching for work.
+  std::atomic<size_t> sleepers{0};
+
+  /**
+   * @brief Moves up to limit injected tasks of victim into the deque of thief, oldest ending up on top.
+   */
+  bool takeInjected(Worker &victim, Worker &thief, size_t limit) {
+    if(victim.injectedCount.load(std::memory_order_seq_cst) == 0)
+      return false;
+    {
+      std::unique_lock<std::mutex> lock(victim.injectedMutex, std::defer_lock);
+      if(&victim == &thief)
+        lock.lock();
+      else if(!lock.try_lock())
+        return false;
+      size_t count = std::min(limit, victim.injected.size());
+      thief.batch.assign(victim.injected.begin(), victim.injected.begin() + count);
+      victim.injected.erase(victim.injected.begin(), victim.injected.begin() + count);
+      victim.injectedCount.store(victim.injected.size(), std::memory_order_seq_cst);
+    }
+    // The owner pops from the bottom, pushing newest first keeps a batch first-in first-out.
+    for(auto it = thief.batch.rbegin(); it != thief.batch.rend(); ++it)
+      thief.deque.push(*it);
+    bool taken = !thief.batch.empty();
+    // The rest of the batch is stealable now, get somebody to help if everybody else sleeps.
+    if(thief.batch.size() > 1 && spinning.load(std::memory_order_seq_cst) == 0)
+      wakeAny();
+    thief.batch.clear();
+    return taken;
+  }
+
+  Task* steal(size_t index) {
+    Worker &self = *workers[index];
+    size_t count = workers.size();
+    self.victimSeed = self.victimSeed * 1664525u + 1013904223u;
+    size_t start = self.victimSeed % count;
+    for(size_t i = 0; i < count; i++) {
+      size_t victim = (start + i) % count;
+      if(victim == index)
+        continue;
+      if(Task *task = workers[victim]->deque.steal())
+        return task;
+      // Tasks still waiting in a busy worker's injection queue are fair game too, take half of them.
+      Worker &other = *workers[victim];
+      if(takeInjected(other, self, other.injectedCount.load(std::memory_order_relaxed) / 2 + 1))
+        return self.deque.pop();
+    }
+    return nullptr;
+  }
+
+  bool anyWork() const {
+    for(const std::unique_ptr<Worker> &worker : workers) {
+      if(worker->injectedCount.load(std::memory_order_seq_cst) > 0 || worker->deque.size() > 0)
+        return true;
+    }
+    return false;
+  }
+
+  bool wake(Worker &worker) {
+    if(!worker.sleeping.exchange(false, std::memory_order_seq_cst))
+      return false;
+    sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    worker.epoch.fetch_add(1, std::memory_order_release);
+    worker.epoch.notify_one();
+    return true;
+  }
+
+  void wakeAny() {
+    if(sleepers.load(std::memory_order_seq_cst) == 0)
+      return;
+    for(std::unique_ptr<Worker> &worker : workers) {
+      if(wake(*worker))
+        return;
+    }
+  }
+
+  void park(Worker &self) {
+    uint32_t epoch = self.epoch.load(std::memory_order_acquire);
+    sleepers.fetch_add(1, std::memory_order_seq_cst);
+    self.sleeping.store(true, std::memory_order_seq_cst);
+    // Work submitted before sleeping became visible has to be seen here, anything later wakes us.
+    if(anyWork()) {
+      if(self.sleeping.exchange(false, std::memory_order_seq_cst))
+        sleepers.fetch_sub(1, std::memory_order_seq_cst);
+      return;
+    }
+    self.epoch.wait(epoch, std::memory_order_acquire);
+  }
+
+  static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+  }
+
+public:
+  /**
+   * @param workerCount Number of worker threads that will call next(), with indices 0 to workerCount - 1.
+   */
+  explicit WorkScheduler(size_t workerCount) {
+    for(size_t i = 0; i < std::max<size_t>(1, workerCount); i++) {
+      workers.push_back(std::make_unique<Worker>());
+      workers.back()->victimSeed = static_cast<uint32_t>(i * 2654435761u + 1);
+    }
+  }
+
+  WorkScheduler(const WorkScheduler&) = delete;
+  WorkScheduler& operator=(const WorkScheduler&) = delete;
+
+  ~WorkScheduler() {
+    for(std::unique_ptr<Worker> &worker : workers) {
+      while(Task *task = worker->deque.pop())
+        delete task;
+      for(Task *task : worker->injected)
+        delete task;
+    }
+  }
+
+  inline size_t workerCount() const { return workers.size(); }
+
+  /**
+   * @brief Queues a task. Safe from any thread.
+   *
+   * @param task The task, owned by the scheduler until next() hands it out.
+   * @param hint Picks the worker that receives the task, equal hints keep landing on the same worker.
+   */
+  void submit(std::unique_ptr<Task> task, size_t hint) {
+    Worker &target = *workers[hint % workers.size()];
+    {
+      std::lock_guard<std::mutex> lock(target.injectedMutex);
+      target.injected.push_back(task.release());
+      target.injectedCount.store(target.injected.size(), std::memory_order_seq_cst);
+    }
+    if(!wake(target) && spinning.load(std::memory_order_seq_cst) == 0)
+      wakeAny();
+  }
+
+  /**
+   * @brief Gets the next task for a worker, blocking while there is none. Worker thread only.
+   *
+   * @param index Index of the calling worker.
+   */
+  std::unique_ptr<Task> next(size_t index) {
+    Worker &self = *workers[index];
+    unsigned rounds = 0;
+    while(true) {
+      Task *task = self.deque.pop();
+      if(!task && takeInjected(self, self, SIZE_MAX))
+        task = self.deque.pop();
+      if(!task)
+        task = steal(index);
+      if(task) {
+        if(rounds > 0)
+          spinning.fetch_sub(1, std::memory_order_seq_cst);
+        return std::unique_ptr<Task>(task);
+      }
+
+      if(rounds++ == 0)
+        spinning.fetch_add(1, std::memory_order_seq_cst);
+      if(rounds < SPIN_ROUNDS) {
+        if(rounds % 16 == 0)
+          std::this_thread::yield();
+        else
+          cpuRelax();
+        continue;
+      }
+      spinning.fetch_sub(1, std::memory_order_seq_cst);
+      rounds = 0;
+      park(self);
+    }
+  }
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Chase-Lev work-stealing deque of task pointers.
+ *
+ * The owning thread pushes and pops at the bottom without locks, any other thread may steal from the
+ * top. Memory orderings follow Lê, Pop, Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing
+ * for Weak Memory Models" (PPoPP 2013). The deque never owns the tasks it holds.
+ */
+template<typename T>
+class WorkStealingDeque {
+  struct Array {
+    int64_t capacity;
+    std::unique_ptr<std::atomic<T*>[]> slots;
+
+    explicit Array(int64_t capacity) : capacity(capacity), slots(new std::atomic<T*>[capacity]) {}
+
+    inline T* get(int64_t index) const { return slots[index & (capacity - 1)].load(std::memory_order_relaxed); }
+    inline void put(int64_t index, T *item) { slots[index & (capacity - 1)].store(item, std::memory_order_relaxed); }
+  };
+
+  alignas(64) std::atomic<int64_t> top{0};
+  alignas(64) std::atomic<int64_t> bottom{0};
+  std::atomic<Array*> array;
+  std::vector<std::unique_ptr<Array>> arrays;  ///< Every array ever used, thieves may still read a replaced one.
+
+  Array* grow(Array *current, int64_t bottomIndex, int64_t topIndex) {
+    arrays.push_back(std::make_unique<Array>(current->capacity * 2));
+    Array *next = arrays.back().get();
+    for(int64_t i = topIndex; i < bottomIndex; i++)
+      next->put(i, current->get(i));
+    array.store(next, std::memory_order_release);
+    return next;
+  }
+
+public:
+  /**
+   * @param capacity Initial capacity, must be a power of two. The deque grows when it fills up.
+   */
+  explicit WorkStealingDeque(int64_t capacity = 256) {
+    arrays.push_back(std::make_unique<Array>(capacity));
+    array.store(arrays.back().get(), std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  /**
+   * @brief Pushes a task at the bottom. Owner thread only.
+   */
+  void push(T *item) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    Array *a = array.load(std::memory_order_relaxed);
+    if(b - t > a->capacity - 1)
+      a = grow(a, b, t);
+    a->put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Pops the most recently pushed task. Owner thread only.
+   *
+   * @return T* The task, or nullptr if the deque is empty or a thief took the last one.
+   */
+  T* pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Array *a = array.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if(t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    T *item = a->get(b);
+    if(t == b) {
+      // Last task, race the thieves for it.
+      if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        item = nullptr;
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  /**
+   * @brief Takes the oldest task. Safe from any thread.
+   *
+   * @return T* The task, or nullptr if the deque is empty or another thread won the race for it.
+   */
+  T* steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if(t >= b)
+      return nullptr;
+
+    Array *a = array.load(std::memory_order_acquire);
+    T *item = a->get(t);
+    if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      return nullptr;
+    return item;
+  }
+
+  /**
+   * @brief Approximate number of tasks, exact only when called by the owner with no thief active.
+   */
+  inline int64_t size() const {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_relaxed);
+    return b > t ? b - t : 0;
+  }
+};
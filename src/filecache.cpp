@@ -0,0 +1,131 @@
+#include "filecache.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+FileCache::File::~File() {
+#ifdef _WIN32
+  if(handle != INVALID_HANDLE_VALUE)
+    CloseHandle(handle);
+#else
+  if(mapping)
+    munmap(const_cast<char*>(mapping), size);
+  if(fd != -1)
+    close(fd);
+#endif
+}
+
+#ifdef _WIN32
+bool FileCache::statPath(const std::string &path, Stamp &stamp) {
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if(!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+    return false;
+  if(attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+    return false;
+  stamp.modified = (static_cast<int64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+                   attributes.ftLastWriteTime.dwLowDateTime;
+  stamp.size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+  return true;
+}
+
+std::shared_ptr<const FileCache::File> FileCache::openFile(const std::string &path) const {
+  std::shared_ptr<File> file = std::make_shared<File>();
+  // Sharing delete and write keeps the cached handle from blocking updates of the file on disk.
+  file->handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                             nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if(file->handle == INVALID_HANDLE_VALUE)
+    return nullptr;
+
+  BY_HANDLE_FILE_INFORMATION info;
+  if(!GetFileInformationByHandle(file->handle, &info) || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+    return nullptr;
+  file->stamp.modified = (static_cast<int64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+                         info.ftLastWriteTime.dwLowDateTime;
+  file->stamp.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+  file->size = static_cast<size_t>(file->stamp.size);
+  return file;
+}
+#else
+static FileCache::Stamp makeStamp(const struct stat &status) {
+  FileCache::Stamp stamp;
+  stamp.device = status.st_dev;
+  stamp.inode = status.st_ino;
+  stamp.modified = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+  stamp.size = status.st_size;
+  return stamp;
+}
+
+bool FileCache::statPath(const std::string &path, Stamp &stamp) {
+  struct stat status;
+  if(stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+    return false;
+  stamp = makeStamp(status);
+  return true;
+}
+
+std::shared_ptr<const FileCache::File> FileCache::openFile(const std::string &path) const {
+  std::shared_ptr<File> file = std::make_shared<File>();
+  file->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(file->fd == -1)
+    return nullptr;
+
+  struct stat status;
+  if(fstat(file->fd, &status) != 0 || !S_ISREG(status.st_mode))
+    return nullptr;
+  file->stamp = makeStamp(status);
+  file->size = static_cast<size_t>(status.st_size);
+
+  // Start reading the file in now, so the reactor later sends it from the page cache instead of waiting on disk.
+  posix_fadvise(file->fd, 0, 0, POSIX_FADV_WILLNEED);
+
+  if(mapContents && file->size > 0) {
+    void *mapping = mmap(nullptr, file->size, PROT_READ, MAP_SHARED, file->fd, 0);
+    if(mapping == MAP_FAILED)
+      return nullptr;
+    file->mapping = static_cast<const char*>(mapping);
+  }
+  return file;
+}
+#endif
+
+std::shared_ptr<const FileCache::File> FileCache::open(const std::string &path) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  std::shared_ptr<const File> cached;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(path);
+    if(it != entries.end()) {
+      it->second.lastUsed = ++useCounter;
+      if(now - it->second.validatedAt < REVALIDATE_INTERVAL)
+        return it->second.file;
+      cached = it->second.file;
+    }
+  }
+
+  // Disk access happens outside the lock, concurrent misses on one path at worst open it twice.
+  Stamp stamp;
+  if(!statPath(path, stamp)) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase(path);
+    return nullptr;
+  }
+
+  std::shared_ptr<const File> file = cached && cached->stamp == stamp ? cached : openFile(path);
+  if(!file)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if(entries.find(path) == entries.end() && entries.size() >= capacity) {
+    auto oldest = entries.begin();
+    for(auto it = entries.begin(); it != entries.end(); ++it) {
+      if(it->second.lastUsed < oldest->second.lastUsed)
+        oldest = it;
+    }
+    entries.erase(oldest);
+  }
+  entries[path] = Entry{file, now, ++useCounter};
+  return file;
+}
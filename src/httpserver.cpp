@@ -1,89 +1,12 @@
 #include <thread>
-#include <charconv>
 #include <algorithm>
+#include <charconv>
 #include <iostream>
-#include <fstream>
-#include <filesystem>
 
 #include "errors.h"
 #include "utils.h"
 #include "httpserver.h"
 
-void HttpServer::PathTree::addPath(const std::string &path) {
-  auto segments = split(path, '/');
-  auto node = root;
-
-  for(const auto &segment : segments) {
-    if(!segment.empty() && segment[0] == ':') {
-      if(!node->paramChild) {
-        node->paramChild = std::make_shared<Trie>();
-        node->paramChild->paramName = std::string_view(segment.c_str() + 1);
-      }
-      node = node->paramChild;
-    } else {
-      if(node->children.find(segment) == node->children.end())
-        node->children[segment] = std::make_shared<Trie>();
-      node = node->children[segment];
-    }
-  }
-
-  node->isEndOfPath = true;
-}
-
-std::unordered_map<std::string, std::string> HttpServer::PathTree::getPathParams(const std::string &path) {
-  std::vector<std::string> segments = split(path, '/');
-  std::shared_ptr<HttpServer::PathTree::Trie> node = root;
-  std::unordered_map<std::string, std::string> params;
-
-  for(const auto &segment : segments) {
-    if(node->children.find(segment) != node->children.end()) {
-      node = node->children[segment];
-    } else if(node->paramChild) {
-      params[node->paramChild->paramName] = segment;
-      node = node->paramChild;
-    } else {
-      return {};
-    }
-  }
-
-  if(node->isEndOfPath)
-    return params;
-  return {};
-}
-
-std::string HttpServer::PathTree::getNormalisedPath(const std::string &path) {
-  auto segments = split(path, '/');
-  auto node = root;
-
-  std::string normalisedPath;
-  normalisedPath.reserve(path.size());
-  normalisedPath.push_back('/');
-
-  for(const auto &segment : segments) {
-    if(node->children.find(segment) != node->children.end()) {
-      normalisedPath.push_back('/');
-      normalisedPath.append(segment);
-      node = node->children[segment];
-    } else if(node->paramChild) {
-      normalisedPath.append("/:");
-      normalisedPath.append(node->paramChild->paramName);
-      node = node->paramChild;
-    } else {
-      return "";
-    }
-  }
-
-  if(node->isEndOfPath) {
-    if(normalisedPath.size() > 1) {
-      std::string finalNormalisedPath;
-      finalNormalisedPath = std::string_view(normalisedPath.c_str() + 1);
-      return finalNormalisedPath;
-    }
-    return normalisedPath;
-  }
-  return "";
-}
-
 std::string HttpServer::getStatusCodeWord(const int statusCode) {
   switch(statusCode) {
     // 1xx Informational
@@ -157,41 +80,47 @@ std::string HttpServer::getStatusCodeWord(const int statusCode) {
   return "Not Found";
 }
 
-std::string makeHttpResponseHeader(Response &res) {
-  if(res.getIsFileResponse()) {
-    res.setHeader("Content-Length", std::to_string(std::filesystem::file_size(res.getFilePath())));
-  } else {
-    res.setHeader("Content-Length", std::to_string(res.getPayload().size()));
-  }
+std::string HttpServer::makeHttpResponseHeader(Response &res, size_t contentLength) {
+  static const std::string_view DEFAULT_CONTENT_TYPE = "Content-Type: text/plain; charset=UTF-8\r\n";
+
+  size_t headerSize = res.getProtocol().size() + DEFAULT_CONTENT_TYPE.size() + 96;
+  res.forEachHeader([&](std::string_view name, std::string_view value) { headerSize += name.size() + value.size() + 4; });
 
   std::string headers_str;
-  headers_str.reserve(8192);
-  
+  headers_str.reserve(headerSize);
+
+  char number[24];
   headers_str.append(res.getProtocol());
   headers_str.push_back(' ');
-  headers_str.append(std::to_string(res.getStatusCode()));
+  headers_str.append(number, std::to_chars(number, number + sizeof(number), res.getStatusCode()).ptr);
   headers_str.append("\r\n");
 
-  if(res.headers.find("Connection") == res.headers.end()) {
+  if(!res.hasHeader(HttpHeader::Connection))
     headers_str.append("Connection: keep-alive\r\n");
-  }
+  if(!res.hasHeader(HttpHeader::ContentType))
+    headers_str.append(DEFAULT_CONTENT_TYPE);
+  headers_str.append("Content-Length: ");
+  headers_str.append(number, std::to_chars(number, number + sizeof(number), contentLength).ptr);
+  headers_str.append("\r\n");
 
-  for(const auto &it : res.headers) {
-    headers_str.append(it.first);
+  res.forEachHeader([&](std::string_view name, std::string_view value) {
+    // The length always comes from the body that is actually sent.
+    if(equalsIgnoreCase(name, "Content-Length"))
+      return;
+    headers_str.append(name);
     headers_str.append(": ");
-    headers_str.append(it.second);
+    headers_str.append(value);
     headers_str.append("\r\n");
-  }
+  });
 
   headers_str.append("\r\n");
   return headers_str;
 }
 
 std::string HttpServer::makeHttpResponse(Response &res) {
-  std::string response = makeHttpResponseHeader(res);
-  if(!res.getIsFileResponse()) {
+  std::string response = makeHttpResponseHeader(res, res.announcedLength(res.getPayload().size()));
+  if(!res.isHeadResponse())
     response.append(res.getPayload());
-  }
   return response;
 }
 
@@ -230,17 +159,13 @@ std::string HttpServer::decodeUrl(std::string_view in) {
 }
 
 void HttpServer::parseQueryParameters(Request &req) {
-  std::string_view url = req.url;
-  size_t qmPos = url.find('?');
-  
-  if (qmPos == std::string_view::npos) {
-    req.path = url;
-    return;
-  }
-
-  req.path = url.substr(0, qmPos);
+  std::string_view url = req.getUrl();
+  req.path = url.substr(0, url.find('?'));
+  req.deferMaps(&decodeQueryParameters);
+}
 
-  std::string_view queryStr = url.substr(qmPos + 1);
+void HttpServer::decodeQueryParameters(const Request &req, LazyStringMap::Map &parameters) {
+  std::string_view queryStr = req.getQueryString();
   while (!queryStr.empty()) {
     size_t keyEnd = queryStr.find('=');
     size_t pairEnd = queryStr.find('&');
@@ -258,138 +183,59 @@ void HttpServer::parseQueryParameters(Request &req) {
       value = "";
     }
 
-    req.query_parameters[decodeUrl(key)] = decodeUrl(value);
+    parameters[decodeUrl(key)] = decodeUrl(value);
 
     if (pairEnd == queryStr.size()) break;
     queryStr = queryStr.substr(pairEnd + 1);
   }
 }
 
-void HttpServer::sendErrorResponse(Response &res, const SOCKET &clientSocket) {
+Response& HttpServer::makeErrorResponse(Response &res) {
   std::string errorMessage = getStatusCodeWord(res.getStatusCode());
   JSONValue::Object message;
   message["message"] = errorMessage;
   JSONValue jsonMessage(message);
-  res.json(jsonMessage).status(res.getStatusCode());
-  std::string responseMessage = makeHttpResponse(res);
-  send(clientSocket, responseMessage.c_str(), responseMessage.length(), 0);
+  return res.json(jsonMessage).status(res.getStatusCode());
 }
 
-Request HttpServer::sendBadRequest(Request& req, SOCKET clientSocket) {
-  Response res;
-  res.status(400);
-  res.setProtocol(req.protocol.empty() ? "HTTP/1.1" : req.protocol).send("Bad Request");
-  sendErrorResponse(res, clientSocket);
-  req.payload = "Bad Request";
-  return req;
-}
-
-Request HttpServer::parseHttpRequest(const std::string &raw, const SOCKET &clientSocket, HttpServer::PathTree &registeredPaths) {
-  Request req;
-  std::string_view request(raw);
-  size_t pos = 0;
-
-  size_t methodEnd = request.find(' ');
-  if (methodEnd == std::string_view::npos)
-    return sendBadRequest(req, clientSocket);
-
-  req.method = std::string(request.substr(0, methodEnd));
-
-  size_t urlStart = methodEnd + 1;
-  size_t urlEnd = request.find(' ', urlStart);
-  if (urlEnd == std::string_view::npos)
-    return sendBadRequest(req, clientSocket);
-
-  std::string_view fullUrl = request.substr(urlStart, urlEnd - urlStart);
-  req.url = std::string(fullUrl);
-
-  size_t protoStart = urlEnd + 1;
-  size_t lineEnd = request.find("\r\n", protoStart);
-  if (lineEnd == std::string_view::npos)
-    return sendBadRequest(req, clientSocket);
-
-  req.protocol = std::string(request.substr(protoStart, lineEnd - protoStart));
-
-  parseQueryParameters(req);
-  req.path_parameters = registeredPaths.getPathParams(req.path);
-
-  pos = lineEnd + 2;
-
-  while (pos < request.size()) {
-    size_t end = request.find("\r\n", pos);
-    if (end == pos) {
-      pos += 2;
-      break;
-    }
-
-    if (end == std::string_view::npos)
-      return sendBadRequest(req, clientSocket);
-
-    std::string_view line = request.substr(pos, end - pos);
-    size_t colon = line.find(':');
-    if (colon == std::string_view::npos)
-      return sendBadRequest(req, clientSocket);
-
-    std::string_view key = line.substr(0, colon);
-    std::string_view value = line.substr(colon + 1);
-
-    req.headers[trim(key)] = trim(value);
-    pos = end + 2;
-  }
-
-  if (auto it = req.headers.find("Content-Length"); it != req.headers.end()) {
-    int cLength = 0;
-    auto [ptr, ec] = std::from_chars(it->second.data(), it->second.data() + it->second.size(), cLength);
-    if (ec != std::errc() || ptr != it->second.data() + it->second.size()) {
-      Response res;
-      res.status(400).send("Malformed request");
-      sendErrorResponse(res, clientSocket);
-      req.payload = "Bad Request";
-      return req;
-    }
-    req.payload.reserve(cLength);
-  }
-
-  if (pos < request.size())
-    req.payload = raw.substr(pos);
-
-  return req;
+void HttpServer::sendErrorResponse(Response &res, const SOCKET &clientSocket) {
+  std::string responseMessage = makeHttpResponse(makeErrorResponse(res));
+  send(clientSocket, responseMessage.c_str(), responseMessage.length(), SEND_FLAGS);
 }
 
 bool HttpServer::validateCors(Request &req) {
-  auto originIt = req.headers.find("Origin");
-  if (originIt == req.headers.end())
+  if (!req.hasHeader(HttpHeader::Origin))
     return true;
 
-  std::string_view origin = originIt->second;
+  std::string_view origin = req.getHeader(HttpHeader::Origin);
   bool isWildOrigin = corsConfig.allowedOrigins.find("*") != corsConfig.allowedOrigins.end();
   bool isOriginAllowed = corsConfig.allowedOrigins.find(std::string(origin)) != corsConfig.allowedOrigins.end();
 
-  std::string_view method = req.method;
+  std::string_view method = req.getMethod();
   bool isMethodAllowed = corsConfig.allowedMethods.find(std::string(method)) != corsConfig.allowedMethods.end();
 
   if (method == "OPTIONS") {
-    auto acrmIt = req.headers.find("Access-Control-Request-Method");
-    if (acrmIt != req.headers.end()) {
-      std::string_view requestedMethod = acrmIt->second;
+    if (req.hasHeader(HttpHeader::AccessControlRequestMethod)) {
+      std::string_view requestedMethod = req.getHeader(HttpHeader::AccessControlRequestMethod);
       if (corsConfig.allowedMethods.find(std::string(requestedMethod)) == corsConfig.allowedMethods.end()) {
         return false;
       }
     }
 
-    auto acrhIt = req.headers.find("Access-Control-Request-Headers");
-    if (acrhIt != req.headers.end()) {
-      std::string_view headersStr = acrhIt->second;
+    if (req.hasHeader(HttpHeader::AccessControlRequestHeaders)) {
+      std::string_view headersStr = req.getHeader(HttpHeader::AccessControlRequestHeaders);
       size_t start = 0;
       while (start < headersStr.size()) {
         size_t end = headersStr.find(',', start);
         if (end == std::string_view::npos) end = headersStr.size();
 
         std::string_view header = headersStr.substr(start, end - start);
-        header = trim(header);
+        header = trimView(header);
 
+        // Browsers list the names in lower case, the configuration usually has them capitalized.
         if (!header.empty() &&
-            corsConfig.allowedHeaders.find(std::string(header)) == corsConfig.allowedHeaders.end()) {
+            std::none_of(corsConfig.allowedHeaders.begin(), corsConfig.allowedHeaders.end(),
+                         [header](const std::string &allowed) { return equalsIgnoreCase(allowed, header); })) {
           return false;
         }
 
@@ -401,330 +247,305 @@ bool HttpServer::validateCors(Request &req) {
   return (isWildOrigin || isOriginAllowed) && isMethodAllowed;
 }
 
-void HttpServer::workerThreadFunction() {
-  while (true) {
-    RequestPackage task;
-    {
-      std::unique_lock<std::mutex> lock(incoming_request_mutex);
-      incoming_request_variable.wait(lock, [&]() { return !incoming_request_queue.empty(); });
-      task = incoming_request_queue.front();
-      incoming_request_queue.pop();
-    }
-    Request req = parseHttpRequest(task.rawRequest, task.socket, registeredPaths);
-    if(req.payload == "Bad Request")
-      continue;
-    bool isValidRequest = !corsEnabled || validateCors(req);
-    Response res;
-    if(isValidRequest) {
-      res.setProtocol("HTTP/1.1");
-      std::string requestPath = registeredPaths.getNormalisedPath(req.path);
-      std::string key = req.method + "::" + registeredPaths.getNormalisedPath(req.path);
-      if (requestPath.empty() || allowedRoutes.find(key) == allowedRoutes.end()) {
-        res.status(404).send("Not found");
+void HttpServer::submitRequest(std::unique_ptr<RequestPackage> task) {
+  size_t hint = static_cast<size_t>(task->connectionId + task->reactor);
+  scheduler->submit(std::move(task), hint);
+}
+
+void HttpServer::startWorkers() {
+  scheduler = std::make_unique<WorkScheduler<RequestPackage>>(MAX_THREADS);
+  for(size_t i = 0; i < scheduler->workerCount(); i++)
+    std::thread(&HttpServer::workerThreadFunction, this, i).detach();
+}
+
+HttpServer::Routing HttpServer::findRoute(const RouteTable &table, Request &req) {
+  HttpMethod method = lookupHttpMethod(req.getMethod());
+  RouteTree::Match match;
+  req.path_parameters.clear();
+  req.parameterSlices.clear();
+  req.routeParameters = nullptr;
+  // A pattern whose last route was just removed stays in the tree until the next change, it allows nothing.
+  if(!table.tree.match(req.getPath(), match) || table.allowed[match.route].empty())
+    return {};
+  Routing routing{nullptr, &table.allowed[match.route]};
+  if(method == HttpMethod::Unknown)
+    return routing;
+  const Endpoint &endpoint = table.endpoints[match.route];
+  Route *route = endpoint[static_cast<size_t>(method)].get();
+  if(!route && method == HttpMethod::Head)
+    route = endpoint[static_cast<size_t>(HttpMethod::Get)].get();
+  if(!route)
+    return routing;
+  // Only where the values are is noted, path_parameters is filled from it once a handler uses it.
+  std::string_view path = req.getPath();
+  for(size_t i = 0; i < match.parameterCount; i++) {
+    std::string_view value = match.parameters[i];
+    req.parameterSlices.push_back({static_cast<size_t>(value.data() - path.data()), value.size()});
+  }
+  if(match.parameterCount > 0)
+    req.deferPathParameters(route->parameterNames);
+  if(route->bindParameters && !route->bindParameters(req, match)) {
+    // Parameters that don't convert make the path unknown, not the method.
+    req.path_parameters.clear();
+    return {};
+  }
+  routing.route = route;
+  return routing;
+}
+
+bool HttpServer::handleRequest(Request &req, Response &res, const Routing &routing) {
+  Route *route = routing.route;
+  res.headResponse = req.getMethod() == "HEAD";
+  bool isValidRequest = !corsEnabled || validateCors(req);
+  if(isValidRequest) {
+    res.setProtocol("HTTP/1.1");
+    if (!routing.allow) {
+      res.status(404).send("Not found");
+    } else if (!route) {
+      res.setHeader(HttpHeader::Allow, *routing.allow);
+      if(req.getMethod() != "OPTIONS") {
+        res.status(405).send("Method Not Allowed");
       } else {
-        if(req.method == "OPTIONS") {
-          res.status(204);
-          auto originIt = req.headers.find("Origin");
-          if (originIt != req.headers.end()) {
-            const std::string &origin = originIt->second;
-
-            if (corsConfig.allowedOrigins.find("*") != corsConfig.allowedOrigins.end()) {
-              res.setHeader("Access-Control-Allow-Origin", "*");
-            } else if (corsConfig.allowedOrigins.find(origin) != corsConfig.allowedOrigins.end()) {
-              res.setHeader("Access-Control-Allow-Origin", origin);
-            }
-
-            if (corsConfig.withCredentials) {
-              res.setHeader("Access-Control-Allow-Credentials", "true");
-            }
-
-            std::string allowedMethods;
-            for (const auto &method : corsConfig.allowedMethods) {
-              if (!allowedMethods.empty()) allowedMethods.append(", ");
-              allowedMethods.append(method);
-            }
-            res.setHeader("Access-Control-Allow-Methods", allowedMethods);
-
-            std::string allowedHeaders;
-            for (const auto &hdr : corsConfig.allowedHeaders) {
-              if (!allowedHeaders.empty()) allowedHeaders.append(", ");
-              allowedHeaders.append(hdr);
-            }
-            if (!allowedHeaders.empty()) {
-              res.setHeader("Access-Control-Allow-Headers", allowedHeaders);
-            }
+        res.status(204);
+        if (req.hasHeader(HttpHeader::Origin)) {
+          std::string origin(req.getHeader(HttpHeader::Origin));
+
+          if (corsConfig.allowedOrigins.find("*") != corsConfig.allowedOrigins.end()) {
+            res.setHeader(HttpHeader::AccessControlAllowOrigin, "*");
+          } else if (corsConfig.allowedOrigins.find(origin) != corsConfig.allowedOrigins.end()) {
+            res.setHeader(HttpHeader::AccessControlAllowOrigin, origin);
           }
-        } else {
-          long long i = 0;
-          size_t globalMiddles = globalMiddlewares.size();
-          while(i < globalMiddles) {
-            globalMiddlewares[i](req, res, i);
-            if(i < 0)
-              break;
-            i++;
+
+          if (corsConfig.withCredentials) {
+            res.setHeader(HttpHeader::AccessControlAllowCredentials, "true");
           }
-          if (i >= 0) {
-            i = 0;
-            auto &route = allowedRoutes[key];
-            size_t routeMiddles = route.middlewares.size();
-            while(i < routeMiddles) {
-              route.middlewares[i](req, res, i);
-              if(i < 0)
-                break;
-              i++;
-            }
-            if (i >= 0) {
-              route.handler(req, res);
-            }
+
+          std::string allowedMethods;
+          for (const auto &method : corsConfig.allowedMethods) {
+            if (!allowedMethods.empty()) allowedMethods.append(", ");
+            allowedMethods.append(method);
+          }
+          res.setHeader(HttpHeader::AccessControlAllowMethods, allowedMethods);
+
+          std::string allowedHeaders;
+          for (const auto &hdr : corsConfig.allowedHeaders) {
+            if (!allowedHeaders.empty()) allowedHeaders.append(", ");
+            allowedHeaders.append(hdr);
+          }
+          if (!allowedHeaders.empty()) {
+            res.setHeader(HttpHeader::AccessControlAllowHeaders, allowedHeaders);
           }
         }
       }
     } else {
-      res.setProtocol("HTTP/1.1");
-      res.status(403);
-
-      res.setHeader("Content-Type", "text/plain");
-
-      if (corsConfig.allowedOrigins.find("*") != corsConfig.allowedOrigins.end())
-        res.setHeader("Access-Control-Allow-Origin", "*");
-      else if (!corsConfig.allowedOrigins.empty())
-        res.setHeader("Access-Control-Allow-Origin", *corsConfig.allowedOrigins.begin());
+      // An exception of a middleware or handler answers this request, it must not reach the thread running it.
+      // Headers, body or file the handler set before it threw are discarded.
+      try {
+        // Global, group and route middlewares count their steps separately, as if they were separate chains.
+        const Middleware *const *chain = route->chain.data();
+        bool complete = true;
+        for(uint32_t length : route->segments) {
+          if(!runMiddlewares(chain, length, req, res)) {
+            complete = false;
+            break;
+          }
+          chain += length;
+        }
+        if(complete)
+          route->handler(req, res);
+      } catch(const json_parse_error &) {
+        res.reset();
+        res.status(400).send("Bad Request");
+      } catch(...) {
+        res.reset();
+        res.status(500).send("Internal Server Error");
+      }
+    }
+  } else {
+    res.setProtocol("HTTP/1.1");
+    res.status(403);
 
-      if (corsConfig.withCredentials)
-        res.setHeader("Access-Control-Allow-Credentials", "true");
+    res.setHeader(HttpHeader::ContentType, "text/plain");
 
-      std::string allowedMethods;
-      for (const auto& method : corsConfig.allowedMethods) {
-        if (!allowedMethods.empty()) allowedMethods.append(", ");
-        allowedMethods.append(method);
-      }
-      res.setHeader("Access-Control-Allow-Methods", allowedMethods);
+    if (corsConfig.allowedOrigins.find("*") != corsConfig.allowedOrigins.end())
+      res.setHeader(HttpHeader::AccessControlAllowOrigin, "*");
+    else if (!corsConfig.allowedOrigins.empty())
+      res.setHeader(HttpHeader::AccessControlAllowOrigin, *corsConfig.allowedOrigins.begin());
 
-      std::string allowedHeaders;
-      for (const auto& header : corsConfig.allowedHeaders) {
-        if (!allowedHeaders.empty()) allowedHeaders.append(", ");
-        allowedHeaders.append(header);
-      }
-      res.setHeader("Access-Control-Allow-Headers", allowedHeaders);
+    if (corsConfig.withCredentials)
+      res.setHeader(HttpHeader::AccessControlAllowCredentials, "true");
 
-      res.send("CORS Policy Error: Origin or Method or headers not allowed");
+    std::string allowedMethods;
+    for (const auto& method : corsConfig.allowedMethods) {
+      if (!allowedMethods.empty()) allowedMethods.append(", ");
+      allowedMethods.append(method);
     }
-    bool terminate_socket = false;
-    if (req.headers.find("Connection") != req.headers.end()) {
-      std::string connectionHeader = req.headers["Connection"];
-      std::transform(connectionHeader.begin(), connectionHeader.end(), connectionHeader.begin(), ::tolower);
-      if(connectionHeader.compare("close") == 0)
-        terminate_socket = true;
-    }
-    {
-      std::lock_guard<std::mutex> lock(outgoing_response_mutex);
-      outgoing_responses.push({task.socket, res, terminate_socket});
+    res.setHeader(HttpHeader::AccessControlAllowMethods, allowedMethods);
+
+    std::string allowedHeaders;
+    for (const auto& header : corsConfig.allowedHeaders) {
+      if (!allowedHeaders.empty()) allowedHeaders.append(", ");
+      allowedHeaders.append(header);
     }
-    outgoing_response_variable.notify_one();
+    res.setHeader(HttpHeader::AccessControlAllowHeaders, allowedHeaders);
+
+    res.send("CORS Policy Error: Origin or Method or headers not allowed");
   }
+  return equalsIgnoreCase(req.getHeader(HttpHeader::Connection), "close");
 }
 
-void HttpServer::responseDispatcherThread() {
-  while(true) {
-    SocketResponse outgoing_response;
+void HttpServer::workerThreadFunction(size_t index) {
+  EpochDomain::Reader &routeReader = routeEpochs.registerReader();
+  while (true) {
+    std::unique_ptr<RequestPackage> task = scheduler->next(index);
+    Response res(task->arena.resource());
+    bool terminate_socket;
     {
-      std::unique_lock<std::mutex> queue_lock(outgoing_response_mutex);
-      outgoing_response_variable.wait(queue_lock, [&]() { return !outgoing_responses.empty(); });
-      outgoing_response = outgoing_responses.front();
-      outgoing_responses.pop();
-    }
-    Response &res = outgoing_response.response;
-    if(!res.getIsFileResponse()) {
-      std::string response_str = makeHttpResponse(res);
-      send(outgoing_response.socket, response_str.c_str(), response_str.size(), 0);
-    } else {
-      std::ifstream file(res.getFilePath(), std::ios::binary);
-      if(!file.is_open()) {
-        Response errorRes;
-        errorRes.status(404).send("File Not Found");
-        std::string errorResponseStr = makeHttpResponse(errorRes);
-        send(outgoing_response.socket, errorResponseStr.c_str(), errorResponseStr.size(), 0);
-      } else {
-        std::string headers = makeHttpResponseHeader(res);
-        send(outgoing_response.socket, headers.c_str(), headers.size(), 0);
-    
-        const size_t bufferSize = 8192;
-        std::vector<char> buffer(bufferSize);
-        while(file.read(buffer.data(), bufferSize)) {
-          if(send(outgoing_response.socket, buffer.data(), bufferSize, 0) == SOCKET_ERROR) {
-            break;
-          }
-        }
-    
-        if(file.gcount() > 0) {
-          send(outgoing_response.socket, buffer.data(), file.gcount(), 0);
-        }
-      }
-    }
-    if(outgoing_response.terminate_socket)
-      closesocket(outgoing_response.socket);
-    else {
-      PerIoData* ioData = new PerIoData();
-      ioData->socket = outgoing_response.socket;
-      ioData->wsabuff.buf = ioData->buffer;
-      ioData->wsabuff.len = BUFFER_SIZE;
-      ioData->receiving = true;
-      DWORD flags = 0;
-      WSARecv(outgoing_response.socket, &ioData->wsabuff, 1, nullptr, &flags, &ioData->overlapped, nullptr);
+      // The snapshot and the route stay alive until the response is built, even if the routes change meanwhile.
+      EpochDomain::Section section(routeReader);
+      Routing routing = findRoute(*routeTable.load(std::memory_order_seq_cst), task->request);
+      terminate_socket = handleRequest(task->request, res, routing);
     }
+    dispatchResponse(*task, res, terminate_socket);
   }
 }
 
-void HttpServer::receiverThreadFunction() {
-  while (true) {
-    DWORD bytesTransfered;
-    ULONG_PTR completionKey;
-    OVERLAPPED* overlapped;
-    BOOL result = GetQueuedCompletionStatus(iocp, &bytesTransfered, &completionKey, &overlapped, INFINITE);
-    PerIoData* ioData = reinterpret_cast<PerIoData*>(overlapped);
-    if (!result || bytesTransfered == 0) {
-      closesocket(ioData->socket);
-      socketBuffers.erase(ioData->socket);
-      delete ioData;
-      continue;
-    }
-    socketBuffers[ioData->socket].buffer.append(ioData->buffer, bytesTransfered);
-    std::string fullBuffer = socketBuffers[ioData->socket].buffer;
-    size_t headerEnd = fullBuffer.find("\r\n\r\n");
-    if (headerEnd != std::string::npos) {
-      size_t contentLength = 0;
-      size_t pos = fullBuffer.find("Content-Length:");
-      if (pos != std::string::npos) {
-        pos += contentLengthStringLength;
-        while (isspace(fullBuffer[pos])) pos++;
-        size_t endPos = fullBuffer.find("\r\n", pos);
-        auto [convPtr, ec] = std::from_chars(fullBuffer.c_str() + pos, fullBuffer.c_str() + endPos, contentLength);
-        if(convPtr != fullBuffer.c_str() + endPos || ec == std::errc()) {
-          Response res;
-          res.status(400).send("Content length header invalid");
-          sendErrorResponse(res, ioData->socket);
-        }
-      }
-      size_t receivedBodyLength = fullBuffer.size() - (headerEnd + 4);
-      if (contentLength == 0 || receivedBodyLength >= contentLength) {
-        {
-          std::lock_guard<std::mutex> lock(incoming_request_mutex);
-          incoming_request_queue.push({ ioData->socket, fullBuffer });
-        }
-        incoming_request_variable.notify_one();
-        socketBuffers.erase(ioData->socket);
-      } else {
-        DWORD flags = 0;
-        ioData->receiving = true;
-        WSARecv(ioData->socket, &ioData->wsabuff, 1, nullptr, &flags, &ioData->overlapped, nullptr);
-        continue;
-      }
-    } else if (fullBuffer.size() < MAX_HEADER_SIZE) {
-      DWORD flags = 0;
-      ioData->receiving = true;
-      WSARecv(ioData->socket, &ioData->wsabuff, 1, nullptr, &flags, &ioData->overlapped, nullptr);
-    } else {
-      closesocket(ioData->socket);
-    }
-  }
+void HttpServer::setWorkerThreads(unsigned int threads) {
+  MAX_THREADS = threads;
 }
 
-void HttpServer::serverListen() {
-  while(true) {
-    sockaddr_in clientAddr;
-    int addrlen = sizeof(clientAddr);
-    SOCKET clientSocket = accept(serverSocket, (sockaddr*)&clientAddr, &addrlen);
-    if(clientSocket == INVALID_SOCKET)
-      continue;
-    HANDLE result = CreateIoCompletionPort((HANDLE)clientSocket, iocp, (ULONG_PTR)clientSocket, 0);
-    if(result == INVALID_HANDLE_VALUE)
-      continue;
-    PerIoData* ioData = new PerIoData();
-    ioData->socket = clientSocket;
-    ioData->wsabuff.buf = ioData->buffer;
-    ioData->wsabuff.len = BUFFER_SIZE;
-    ioData->receiving = true;
-    DWORD flags = 0;
-    WSARecv(clientSocket, &ioData->wsabuff, 1, nullptr, &flags, &ioData->overlapped, nullptr);
-  }
+void HttpServer::initServer(int port, std::function<void()> callback = []() {}) {
+  initServer(port, callback, AF_INET, SOCK_STREAM, IPPROTO_TCP);
 }
 
-void HttpServer::setWorkerThreads(unsigned int threads) {
-  MAX_THREADS = threads;
+void HttpServer::initServer(int port) {
+  initServer(port, []() {}, AF_INET, SOCK_STREAM, IPPROTO_TCP);
 }
 
-void HttpServer::initServer(int port, std::function<void()> callback = []() {}, int addressFamily = AF_INET, int type = SOCK_STREAM, int protocol = IPPROTO_TCP) {
-  WSADATA wsadata;
-  int result = WSAStartup(MAKEWORD(2, 2), &wsadata);
-  if(result != 0) {
-    throw std::runtime_error("DLL not found");
-  }
+void HttpServer::createCorsConfig(std::function<void(CorsConfig&)> configurer) {
+  configurer(corsConfig);
+  if(corsConfig.allowedOrigins.find("*") != corsConfig.allowedOrigins.end() && corsConfig.withCredentials)
+    throw std::runtime_error("Can't have \"*\" in allowedOrigins with withCredentials as true");
+  corsEnabled = true;
+}
 
-  SOCKET initialSocket = socket(addressFamily, type, protocol);
-  if(initialSocket == INVALID_SOCKET) {
-    WSACleanup();
-    throw std::runtime_error(std::string("Error in socket ") + std::to_string(WSAGetLastError()));
+void HttpServer::addRoute(HttpMethod method, const std::string &path,
+                          const std::vector<std::function<void(Request&, Response&, long long&)>> &middlewares,
+                          std::function<void(Request&, Response&)> handler,
+                          bool (*bindParameters)(Request &req, const RouteTree::Match &match)) {
+  auto route = std::make_shared<Route>(middlewares, handler);
+  route->method = method;
+  route->pattern = path;
+  route->bindParameters = bindParameters;
+  updateRoutes([&](RouteTable &table) {
+    uint32_t pattern = table.tree.insert(path, &route->parameterNames);
+    if(pattern == table.endpoints.size())
+      table.endpoints.emplace_back();
+    if(routesPublished())
+      compileChain(*route);
+    table.endpoints[pattern][static_cast<size_t>(method)] = std::move(route);
+  });
+}
+
+void HttpServer::updateRoutes(const std::function<void(RouteTable&)> &change) {
+  std::lock_guard<std::mutex> lock(routesMutex);
+  if(!routesPublished()) {
+    change(*pendingRoutes);
+    return;
   }
-
-  sockaddr_in serverAddr;
-  serverAddr.sin_family = addressFamily;
-  serverAddr.sin_addr.s_addr = INADDR_ANY;
-  serverAddr.sin_port = htons(port);
-  int addrSize = sizeof(serverAddr);
-
-  result = bind(initialSocket, (const sockaddr *)&serverAddr, addrSize);
-  if(result == SOCKET_ERROR) {
-    closesocket(initialSocket);
-    WSACleanup();
-    throw std::runtime_error(std::string("Error in binding ") + std::to_string(WSAGetLastError()));
+  const RouteTable *current = routeTable.load(std::memory_order_relaxed);
+  std::unique_ptr<RouteTable> next = copyRoutes(*current);
+  change(*next);
+  next->tree.freeze();
+  listAllowedMethods(*next);
+  routeTable.store(next.release(), std::memory_order_seq_cst);
+  // Deleted once every reader that could have loaded it has left its read section.
+  routeEpochs.retire(current);
+}
+
+std::unique_ptr<HttpServer::RouteTable> HttpServer::copyRoutes(const RouteTable &table) {
+  auto copy = std::make_unique<RouteTable>();
+  for(const Endpoint &endpoint : table.endpoints) {
+    auto route = std::find_if(endpoint.begin(), endpoint.end(), [](const std::shared_ptr<Route> &route) { return route != nullptr; });
+    if(route == endpoint.end())
+      continue;  // Patterns whose routes were all removed leave the tree.
+    uint32_t pattern = copy->tree.insert((*route)->pattern);
+    if(pattern == copy->endpoints.size())
+      copy->endpoints.emplace_back();
+    copy->endpoints[pattern] = endpoint;
   }
+  return copy;
+}
 
-  int listenResult = listen(initialSocket, 10);
-  if(listenResult == SOCKET_ERROR) {
-    closesocket(initialSocket);
-    WSACleanup();
-    throw std::runtime_error(std::string("Error in listening ") + std::to_string(WSAGetLastError()));
+void HttpServer::listAllowedMethods(RouteTable &table) {
+  table.allowed.clear();
+  for(const Endpoint &endpoint : table.endpoints) {
+    std::string &allow = table.allowed.emplace_back();
+    if(std::none_of(endpoint.begin(), endpoint.end(), [](const std::shared_ptr<Route> &route) { return route != nullptr; }))
+      continue;
+    for(size_t method = 0; method < HTTP_METHOD_COUNT; method++) {
+      bool answered = endpoint[method] || (method == static_cast<size_t>(HttpMethod::Head) && endpoint[0]) ||
+                      method == static_cast<size_t>(HttpMethod::Options);
+      if(!answered)
+        continue;
+      if(!allow.empty())
+        allow.append(", ");
+      allow.append(HTTP_METHOD_NAMES[method]);
+    }
   }
+}
 
-  serverSocket = initialSocket;
+void HttpServer::compileChain(Route &route) {
+  route.chain.clear();
+  route.segments.clear();
+  for(const Middleware &middleware : globalMiddlewares)
+    route.chain.push_back(&middleware);
+  route.segments.push_back(static_cast<uint32_t>(route.chain.size()));
 
-  iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
-  if(!iocp) {
-    throw std::runtime_error("CreateIoCompletionPort failed");
+  // Groups beneath the prefix of another group run after it, groups of one prefix in registration order.
+  std::vector<std::pair<std::string, const Middleware*>> groups;
+  for(const PrefixMiddleware &group : prefixMiddlewares) {
+    if(RouteTree::covers(group.prefix, route.pattern))
+      groups.emplace_back(RouteTree::shapeOf(group.prefix), &group.middleware);
+  }
+  std::stable_sort(groups.begin(), groups.end(), [](const auto &a, const auto &b) { return a.first.size() < b.first.size(); });
+  for(size_t i = 0; i < groups.size(); i++) {
+    if(i == 0 || groups[i].first != groups[i - 1].first)
+      route.segments.push_back(0);
+    route.chain.push_back(groups[i].second);
+    route.segments.back()++;
   }
 
-  for(int i = 0; i < MAX_THREADS; i++)
-    std::thread(&HttpServer::workerThreadFunction, this).detach();
-  
-  std::thread(&HttpServer::responseDispatcherThread, this).detach();
-  
-  std::thread(&HttpServer::receiverThreadFunction, this).detach();
-
-  callback();
-
-  serverListen();
+  for(const Middleware &middleware : route.middlewares)
+    route.chain.push_back(&middleware);
+  route.segments.push_back(static_cast<uint32_t>(route.middlewares.size()));
 }
 
-void HttpServer::initServer(int port, std::function<void()> callback = []() {}) {
-  initServer(port, callback, AF_INET, SOCK_STREAM, IPPROTO_TCP);
+Router& HttpServer::group(const std::string &prefix, const std::vector<Middleware> &middlewares) {
+  return router.group(prefix, middlewares);
 }
 
-void HttpServer::initServer(int port) {
-  initServer(port, []() {}, AF_INET, SOCK_STREAM, IPPROTO_TCP);
+void HttpServer::mount(const std::string &prefix, const Router &mounted) {
+  router.mount(prefix, mounted);
 }
 
-void HttpServer::createCorsConfig(std::function<void(CorsConfig&)> configurer) {
-  configurer(corsConfig);
-  if(corsConfig.allowedOrigins.find("*") != corsConfig.allowedOrigins.end() && corsConfig.withCredentials)
-    throw std::runtime_error("Can't have \"*\" in allowedOrigins with withCredentials as true");
-  corsEnabled = true;
+void HttpServer::freeze() {
+  std::lock_guard<std::mutex> lock(routesMutex);
+  if(routesPublished())
+    return;
+  pendingRoutes->tree.freeze();
+  for(Endpoint &endpoint : pendingRoutes->endpoints) {
+    for(std::shared_ptr<Route> &route : endpoint) {
+      if(route)
+        compileChain(*route);
+    }
+  }
+  listAllowedMethods(*pendingRoutes);
+  routeTable.store(pendingRoutes.release(), std::memory_order_seq_cst);
 }
 
 void HttpServer::Get(const std::string path, const std::vector<std::function<void(Request&, Response&, long long&)>> middlewares, std::function<void(Request&, Response&)> handler) {
-  std::string key = "GET::";
-  key.append(path.c_str(), path.length());
-  registeredPaths.addPath(path);
-  allowedRoutes[key] = Route(middlewares, handler);
+  addRoute(HttpMethod::Get, path, middlewares, handler);
 }
 
 void HttpServer::Get(const std::string path, std::function<void(Request&, Response&)> handler) {
@@ -732,10 +553,7 @@ void HttpServer::Get(const std::string path, std::function<void(Request&, Respon
 }
 
 void HttpServer::Post(const std::string path, const std::vector<std::function<void(Request&, Response&, long long&)>> middlewares, std::function<void(Request&, Response&)> handler) {
-  std::string key = "POST::";
-  key.append(path.c_str(), path.length());
-  registeredPaths.addPath(path);
-  allowedRoutes[key] = Route(middlewares, handler);
+  addRoute(HttpMethod::Post, path, middlewares, handler);
 }
 
 void HttpServer::Post(const std::string path, std::function<void(Request&, Response&)> handler) {
@@ -743,10 +561,7 @@ void HttpServer::Post(const std::string path, std::function<void(Request&, Respo
 }
 
 void HttpServer::Put(const std::string path, const std::vector<std::function<void(Request&, Response&, long long&)>> middlewares, std::function<void(Request&, Response&)> handler) {
-  std::string key = "PUT::";
-  key.append(path.c_str(), path.length());
-  registeredPaths.addPath(path);
-  allowedRoutes[key] = Route(middlewares, handler);
+  addRoute(HttpMethod::Put, path, middlewares, handler);
 }
 
 void HttpServer::Put(const std::string path, std::function<void(Request&, Response&)> handler) {
@@ -754,10 +569,7 @@ void HttpServer::Put(const std::string path, std::function<void(Request&, Respon
 }
 
 void HttpServer::Patch(const std::string path, const std::vector<std::function<void(Request&, Response&, long long&)>> middlewares, std::function<void(Request&, Response&)> handler) {
-  std::string key = "PATCH::";
-  key.append(path.c_str(), path.length());
-  registeredPaths.addPath(path);
-  allowedRoutes[key] = Route(middlewares, handler);
+  addRoute(HttpMethod::Patch, path, middlewares, handler);
 }
 
 void HttpServer::Patch(const std::string path, std::function<void(Request&, Response&)> handler) {
@@ -765,12 +577,34 @@ void HttpServer::Patch(const std::string path, std::function<void(Request&, Resp
 }
 
 void HttpServer::Delete(const std::string path, const std::vector<std::function<void(Request&, Response&, long long&)>> middlewares, std::function<void(Request&, Response&)> handler) {
-  std::string key = "DELETE::";
-  key.append(path.c_str(), path.length());
-  registeredPaths.addPath(path);
-  allowedRoutes[key] = Route(middlewares, handler);
+  addRoute(HttpMethod::Delete, path, middlewares, handler);
 }
 
 void HttpServer::Delete(const std::string path, std::function<void(Request&, Response&)> handler) {
   Delete(path, {}, handler);
 }
+
+std::shared_ptr<HttpServer::Route>& HttpServer::registeredRoute(RouteTable &table, const std::string &method,
+                                                                const std::string &path) {
+  uint32_t pattern = table.tree.find(path);
+  HttpMethod id = lookupHttpMethod(method);
+  if(pattern == RouteTree::NO_ROUTE || id == HttpMethod::Unknown || !table.endpoints[pattern][static_cast<size_t>(id)])
+    throw std::runtime_error("No route registered for " + method + " " + path);
+  return table.endpoints[pattern][static_cast<size_t>(id)];
+}
+
+void HttpServer::setBlocking(const std::string method, const std::string path, bool blocking) {
+  updateRoutes([&](RouteTable &table) {
+    std::shared_ptr<Route> &route = registeredRoute(table, method, path);
+    if(routesPublished()) {
+      // Published routes are in use by requests, the change goes into a copy.
+      route = std::make_shared<Route>(*route);
+      compileChain(*route);
+    }
+    route->blocking = blocking;
+  });
+}
+
+void HttpServer::removeRoute(const std::string method, const std::string path) {
+  updateRoutes([&](RouteTable &table) { registeredRoute(table, method, path).reset(); });
+}
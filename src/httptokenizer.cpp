@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#include "httptokenizer.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define BOLTPP_TOKENIZER_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define BOLTPP_TOKENIZER_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define BOLTPP_ALWAYS_INLINE __forceinline
+#else
+#define BOLTPP_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+/**
+ * @brief Bit i of every mask describes byte i of a block.
+ */
+struct BlockMasks {
+  uint32_t lineFeeds;
+  uint32_t colons;
+  uint32_t invalid;
+};
+
+enum : uint8_t { LINE_FEED = 1, COLON = 2, CONTROL = 4, CARRIAGE_RETURN = 8 };
+
+static constexpr std::array<uint8_t, 256> CLASSES = []() {
+  std::array<uint8_t, 256> table{};
+  for(int c = 0; c < 0x20; c++)
+    table[c] = c == '\t' ? 0 : CONTROL;
+  table[0x7F] = CONTROL;
+  table['\n'] |= LINE_FEED;
+  table['\r'] |= CARRIAGE_RETURN;
+  table[':'] = COLON;
+  return table;
+}();
+
+static BOLTPP_ALWAYS_INLINE size_t appendOffsets(uint32_t mask, uint32_t base, uint32_t *offsets, size_t count) {
+  while(mask) {
+    offsets[count++] = base + static_cast<uint32_t>(std::countr_zero(mask));
+    mask &= mask - 1;
+  }
+  return count;
+}
+
+// The loop every indexer runs, a macro rather than a template because GCC refuses to inline the AVX2 mask
+// function into code compiled for the baseline. masks(block) looks at 33 bytes, the extra one tells whether
+// a CR at the end of the block is followed by LF. The last block is copied into a buffer padded with an LF,
+// so a CR at the very end of the data is not taken for invalid, and the padding is masked off again.
+#define BOLTPP_INDEX_BLOCKS(masks)                                                              \
+  const size_t BLOCK = HttpTokenizer::BLOCK_SIZE;                                               \
+  index.lineFeedCount = index.colonCount = 0;                                                   \
+  index.invalid = SIZE_MAX;                                                                     \
+  const char *block = begin;                                                                    \
+  const char *limit = begin + std::min<size_t>(end - begin, HttpTokenizer::Index::MAX_BYTES);   \
+  while(block < limit && index.lineFeedCount + BLOCK <= HttpTokenizer::Index::CAPACITY &&       \
+        index.colonCount + BLOCK <= HttpTokenizer::Index::CAPACITY) {                           \
+    size_t length = static_cast<size_t>(end - block);                                           \
+    BlockMasks found;                                                                           \
+    if(length > BLOCK) {                                                                        \
+      found = masks(block);                                                                     \
+      length = BLOCK;                                                                           \
+    } else {                                                                                    \
+      alignas(32) char padded[BLOCK + 1] = {};                                                  \
+      std::memcpy(padded, block, length);                                                       \
+      padded[length] = '\n';                                                                    \
+      found = masks(padded);                                                                    \
+      uint32_t valid = length == BLOCK ? ~0u : (1u << length) - 1;                              \
+      found.lineFeeds &= valid;                                                                 \
+      found.colons &= valid;                                                                    \
+      found.invalid &= valid;                                                                   \
+    }                                                                                           \
+    uint32_t base = static_cast<uint32_t>(block - begin);                                       \
+    index.lineFeedCount = appendOffsets(found.lineFeeds, base, index.lineFeeds, index.lineFeedCount); \
+    index.colonCount = appendOffsets(found.colons, base, index.colons, index.colonCount);       \
+    if(found.invalid && index.invalid == SIZE_MAX)                                              \
+      index.invalid = base + static_cast<size_t>(std::countr_zero(found.invalid));              \
+    block += length;                                                                            \
+  }                                                                                             \
+  index.length = static_cast<size_t>(block - begin);
+
+static BOLTPP_ALWAYS_INLINE BlockMasks masksScalar(const char *block) {
+  BlockMasks found{0, 0, 0};
+  for(size_t i = 0; i < HttpTokenizer::BLOCK_SIZE; i++) {
+    uint8_t classes = CLASSES[static_cast<unsigned char>(block[i])];
+    // Almost every byte is plain text, keep the common case a single predictable branch.
+    if(classes == 0)
+      continue;
+    uint32_t bit = 1u << i;
+    if(classes & LINE_FEED)
+      found.lineFeeds |= bit;
+    else if(classes & COLON)
+      found.colons |= bit;
+    else if(!(classes & CARRIAGE_RETURN) || block[i + 1] != '\n')
+      found.invalid |= bit;
+  }
+  return found;
+}
+
+static void indexScalar(const char *begin, const char *end, HttpTokenizer::Index &index) {
+  BOLTPP_INDEX_BLOCKS(masksScalar)
+}
+
+#ifdef BOLTPP_TOKENIZER_SSE2
+// The masks of the 16 bytes at block. Always inlined, so the AVX2 indexer would get it VEX encoded.
+static BOLTPP_ALWAYS_INLINE BlockMasks masks16(const char *block) {
+  const __m128i controlLimit = _mm_set1_epi8(0x1F);
+  __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+  __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 1));
+  __m128i lineFeeds = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'));
+  // Unsigned x <= 0x1F, so bytes of 0x80 and above (obs-text) pass.
+  __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(bytes, controlLimit), controlLimit);
+  control = _mm_andnot_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')), control);
+  control = _mm_or_si128(control, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x7F)));
+  __m128i lineEnds = _mm_and_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(next, _mm_set1_epi8('\n')));
+  __m128i invalid = _mm_andnot_si128(_mm_or_si128(lineFeeds, lineEnds), control);
+  return {static_cast<uint32_t>(_mm_movemask_epi8(lineFeeds)),
+          static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(':')))),
+          static_cast<uint32_t>(_mm_movemask_epi8(invalid))};
+}
+
+static BOLTPP_ALWAYS_INLINE BlockMasks masksSSE2(const char *block) {
+  BlockMasks low = masks16(block), high = masks16(block + 16);
+  return {low.lineFeeds | high.lineFeeds << 16, low.colons | high.colons << 16, low.invalid | high.invalid << 16};
+}
+
+static void indexSSE2(const char *begin, const char *end, HttpTokenizer::Index &index) {
+  BOLTPP_INDEX_BLOCKS(masksSSE2)
+}
+#endif
+
+#ifdef BOLTPP_TOKENIZER_AVX2
+__attribute__((target("avx2,bmi"))) static BOLTPP_ALWAYS_INLINE BlockMasks masksAVX2(const char *block) {
+  const __m256i controlLimit = _mm256_set1_epi8(0x1F);
+  __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+  __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 1));
+  __m256i lineFeeds = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'));
+  __m256i control = _mm256_cmpeq_epi8(_mm256_max_epu8(bytes, controlLimit), controlLimit);
+  control = _mm256_andnot_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t')), control);
+  control = _mm256_or_si256(control, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(0x7F)));
+  __m256i lineEnds = _mm256_and_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r')),
+                                      _mm256_cmpeq_epi8(next, _mm256_set1_epi8('\n')));
+  __m256i invalid = _mm256_andnot_si256(_mm256_or_si256(lineFeeds, lineEnds), control);
+  return {static_cast<uint32_t>(_mm256_movemask_epi8(lineFeeds)),
+          static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(':')))),
+          static_cast<uint32_t>(_mm256_movemask_epi8(invalid))};
+}
+
+__attribute__((target("avx2,bmi")))
+static void indexAVX2(const char *begin, const char *end, HttpTokenizer::Index &index) {
+  BOLTPP_INDEX_BLOCKS(masksAVX2)
+}
+#endif
+
+#undef BOLTPP_INDEX_BLOCKS
+
+HttpTokenizer::Indexer HttpTokenizer::indexer(Isa isa) {
+  switch(isa) {
+  case Isa::Scalar:
+    return &indexScalar;
+  case Isa::SSE2:
+#ifdef BOLTPP_TOKENIZER_SSE2
+    return &indexSSE2;
+#else
+    return nullptr;
+#endif
+  case Isa::AVX2:
+#ifdef BOLTPP_TOKENIZER_AVX2
+    // May run during static initialization, ahead of the CPU feature detection of the runtime.
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi"))
+      return &indexAVX2;
+#endif
+    return nullptr;
+  }
+  return nullptr;
+}
+
+HttpTokenizer::Isa HttpTokenizer::best() {
+  if(indexer(Isa::AVX2))
+    return Isa::AVX2;
+  if(indexer(Isa::SSE2))
+    return Isa::SSE2;
+  return Isa::Scalar;
+}
+
+const char* HttpTokenizer::isaName(Isa isa) {
+  switch(isa) {
+  case Isa::Scalar: return "scalar";
+  case Isa::SSE2: return "sse2";
+  case Isa::AVX2: return "avx2";
+  }
+  return "unknown";
+}
+
+const HttpTokenizer::Indexer HttpTokenizer::active = HttpTokenizer::indexer(HttpTokenizer::best());
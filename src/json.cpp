@@ -1,7 +1,187 @@
 #include "errors.h"
+#include <array>
+#include <bit>
 #include <charconv>
+#include <cmath>
+#include <cstring>
 #include "json.h"
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define BOLTPP_JSON_SSE2
+#include <emmintrin.h>
+#endif
+
+// Bytes a JSON string can't hold as they are: quotes, backslashes and control characters.
+static constexpr std::array<bool, 256> NEEDS_ESCAPE = []() {
+  std::array<bool, 256> table{};
+  for(int c = 0; c < 0x20; c++)
+    table[c] = true;
+  table['"'] = table['\\'] = true;
+  return table;
+}();
+
+// The number of bytes at the start of text that need no escaping, 16 per step where SSE2 is available.
+static size_t safeRun(const char *text, size_t length) {
+  size_t at = 0;
+#ifdef BOLTPP_JSON_SSE2
+  const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), controlLimit = _mm_set1_epi8(0x1F);
+  for(; at + 16 <= length; at += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + at));
+    __m128i unsafe = _mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash));
+    // Unsigned x <= 0x1F, so bytes of UTF-8 sequences pass.
+    unsafe = _mm_or_si128(unsafe, _mm_cmpeq_epi8(_mm_max_epu8(bytes, controlLimit), controlLimit));
+    if(uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(unsafe)))
+      return at + std::countr_zero(mask);
+  }
+#endif
+  while(at < length && !NEEDS_ESCAPE[static_cast<uint8_t>(text[at])])
+    at++;
+  return at;
+}
+
+// Appends text as a quoted JSON string. Runs of safe bytes are copied in one piece, only the bytes in between
+// are escaped, control characters without a short form as \\u00XX.
+static void appendString(std::string &out, std::string_view text) {
+  static const char HEX[] = "0123456789abcdef";
+  out.push_back('"');
+  while(true) {
+    size_t run = safeRun(text.data(), text.size());
+    out.append(text.data(), run);
+    if(run == text.size())
+      break;
+    unsigned char c = text[run];
+    switch(c) {
+      case '"': out.append("\\\""); break;
+      case '\\': out.append("\\\\"); break;
+      case '\b': out.append("\\b"); break;
+      case '\f': out.append("\\f"); break;
+      case '\n': out.append("\\n"); break;
+      case '\r': out.append("\\r"); break;
+      case '\t': out.append("\\t"); break;
+      default: {
+        const char escape[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+        out.append(escape, sizeof(escape));
+      }
+    }
+    text.remove_prefix(run + 1);
+  }
+  out.push_back('"');
+}
+
+// Appends the shortest text that parses back to the same double. NaN and infinities have no JSON form and
+// become null, as in JSON.stringify.
+static void appendNumber(std::string &out, double number) {
+  if(!std::isfinite(number)) {
+    out.append("null");
+    return;
+  }
+  char buffer[32];
+  std::to_chars_result result;
+  // Integers up to 2^53 are exact, formatting them as int64_t skips the search for the shortest digits. -0 keeps
+  // its sign through the double path.
+  constexpr double EXACT = 9007199254740992.0;
+  if(number >= -EXACT && number <= EXACT && number == static_cast<double>(static_cast<int64_t>(number)) &&
+     !(number == 0 && std::signbit(number)))
+    result = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<int64_t>(number));
+  else
+    result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+  out.append(buffer, result.ptr);
+}
+
+JSONObject::JSONObject(std::initializer_list<value_type> init, std::pmr::memory_resource *resource)
+    : members(resource), slots(resource) {
+  reserve(init.size());
+  for(const value_type &member : init)
+    insert_or_assign(member.first, member.second);
+}
+
+size_t JSONObject::locate(std::string_view key) const {
+  // Sizes first, most keys of an object differ in length.
+  auto matches = [key](const std::string &name) {
+    return name.size() == key.size() && std::memcmp(name.data(), key.data(), key.size()) == 0;
+  };
+  if(slots.empty()) {
+    for(size_t position = 0; position < members.size(); position++) {
+      if(matches(members[position].first))
+        return position;
+    }
+    return NOT_FOUND;
+  }
+  size_t mask = slots.size() - 1;
+  for(size_t slot = std::hash<std::string_view>()(key) & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+    size_t position = slots[slot] - 1;
+    if(matches(members[position].first))
+      return position;
+  }
+  return NOT_FOUND;
+}
+
+void JSONObject::rebuildIndex(size_t count) {
+  if(count <= INDEX_THRESHOLD) {
+    slots.clear();
+    return;
+  }
+  // At most half of the slots are taken, probe sequences stay short.
+  slots.assign(std::bit_ceil(count * 2), 0);
+  size_t mask = slots.size() - 1;
+  for(size_t position = 0; position < members.size(); position++) {
+    size_t slot = std::hash<std::string_view>()(members[position].first) & mask;
+    while(slots[slot] != 0)
+      slot = (slot + 1) & mask;
+    slots[slot] = static_cast<uint32_t>(position + 1);
+  }
+}
+
+void JSONObject::indexLast() {
+  if(slots.empty() ? members.size() > INDEX_THRESHOLD : members.size() * 2 > slots.size()) {
+    rebuildIndex(members.size());
+    return;
+  }
+  if(slots.empty())
+    return;
+  size_t mask = slots.size() - 1;
+  size_t slot = std::hash<std::string_view>()(members.back().first) & mask;
+  while(slots[slot] != 0)
+    slot = (slot + 1) & mask;
+  slots[slot] = static_cast<uint32_t>(members.size());
+}
+
+void JSONObject::reserve(size_type count) {
+  members.reserve(count);
+  if(count > INDEX_THRESHOLD && slots.size() < count * 2)
+    rebuildIndex(count);
+}
+
+JSONValue& JSONObject::operator[](std::string_view key) {
+  return try_emplace(key, nullptr).first->second;
+}
+
+JSONValue& JSONObject::at(std::string_view key) {
+  size_t position = locate(key);
+  if(position == NOT_FOUND)
+    throw std::out_of_range("No member named " + std::string(key) + " in JSON object");
+  return members[position].second;
+}
+
+const JSONValue& JSONObject::at(std::string_view key) const {
+  return const_cast<JSONObject*>(this)->at(key);
+}
+
+JSONObject::size_type JSONObject::erase(std::string_view key) {
+  size_t position = locate(key);
+  if(position == NOT_FOUND)
+    return 0;
+  members.erase(members.begin() + position);
+  if(!slots.empty())
+    rebuildIndex(members.size());
+  return 1;
+}
+
+void JSONObject::clear() {
+  members.clear();
+  slots.clear();
+}
+
 void JSONValue::stringifyTo(std::string &out) const {
   std::visit([&out](auto&& arg) {
     using T = std::decay_t<decltype(arg)>;
@@ -10,12 +190,10 @@ void JSONValue::stringifyTo(std::string &out) const {
     else if constexpr (std::is_same_v<T, bool>)
       out.append(arg ? "true" : "false");
     else if constexpr (std::is_same_v<T, double>)
-      out.append(std::to_string(arg));
-    else if constexpr (std::is_same_v<T, std::string>) {
-      out.push_back('"');
-      out.append(arg);
-      out.push_back('"');
-    } else if constexpr (std::is_same_v<T, Array>) {
+      appendNumber(out, arg);
+    else if constexpr (std::is_same_v<T, std::string>)
+      appendString(out, arg);
+    else if constexpr (std::is_same_v<T, Array>) {
       out.push_back('[');
       for (size_t i = 0; i < arg.size(); ++i) {
         if (i > 0) out.push_back(',');
@@ -28,9 +206,8 @@ void JSONValue::stringifyTo(std::string &out) const {
       for (const auto& kv : arg) {
         if (!first) out.push_back(',');
         first = false;
-        out.push_back('"');
-        out.append(kv.first);
-        out.append("\":");
+        appendString(out, kv.first);
+        out.push_back(':');
         kv.second.stringifyTo(out);
       }
       out.push_back('}');
@@ -38,8 +215,8 @@ void JSONValue::stringifyTo(std::string &out) const {
   }, value);
 }
 
-JSONValue& JSONValue::operator=(const JSONValue json) {
-  value = json.value;
+JSONValue& JSONValue::operator=(JSONValue json) {
+  value = std::move(json.value);
   return *this;
 }
 
@@ -78,24 +255,9 @@ JSONValue& JSONValue::operator=(const std::nullptr_t null) {
   return *this;
 }
 
-JSONValue& JSONValue::operator[](const char* str) {
-  std::string key(str);
-  if(JSONValue::Object* object = std::get_if<JSONValue::Object>(&this->value)) {
-    auto it = object->find(key);
-    if(it == object->end()) {
-      object->insert({key, JSONValue(nullptr)});
-    }
-    it = object->find(key);
-    return it->second;
-  } else {
-    throw json_type_error("Invalid [std::string] operator on a non object value");
-  }
-}
-
-JSONValue& JSONValue::operator[](const std::string& key) {
+JSONValue& JSONValue::operator[](std::string_view key) {
   if(JSONValue::Object* object = std::get_if<JSONValue::Object>(&this->value)) {
-    auto [it, _] = object->try_emplace(key, nullptr);
-    return it->second;
+    return (*object)[key];
   } else {
     throw json_type_error("Invalid [std::string] operator on a non object value");
   }
@@ -152,213 +314,131 @@ std::string JSONValue::stringify() const {
   return output;
 }
 
-JSONValue JSONParser::parseBoolean() {
-  if (input.compare(pos, 4, "true") == 0) {
-    pos += 4;
-    return JSONValue(true);
-  }
-  if (input.compare(pos, 5, "false") == 0) {
-    pos += 5;
-    return JSONValue(false);
-  }
-  else
-    throw json_parse_error("Unexpected value caught, expected boolean");
+size_t JSONDocument::Element::size() const {
+  const JSONTape::Node &value = node();
+  return value.type == JSONTape::Type::Array || value.type == JSONTape::Type::Object ? value.size : 0;
 }
 
-JSONValue JSONParser::parseNull() {
-  if(pos <= size - 4 && get() == 'n' && get() == 'u' && get() == 'l' && get() == 'l')
-    return JSONValue(nullptr);
-  else
-    throw json_parse_error("Unexpected value caught, expected 'null'");
+uint32_t JSONDocument::Element::skip(uint32_t position) const {
+  const JSONTape::Node &value = tape().nodes()[position];
+  return value.type == JSONTape::Type::Array || value.type == JSONTape::Type::Object ? value.next : position + 1;
 }
 
-JSONValue JSONParser::parseString() {
-  if(get() != '"')
-    throw json_parse_error("Expected '\"' at beginning of the string");
-  std::string output;
-  output.reserve(1000);
-  while(true) {
-    if(pos >= size)
-      throw json_parse_error("Unterminated string");
-    char c = get();
-    if(c == '"')
-      break;
-    if(c == '\\') {
-      if(pos >= size)
-        throw json_parse_error("Invalid escape sequence in string");
-      char esc = get();
-      switch(esc) {
-        case '"': output.push_back('"'); break;
-        case '\\': output.push_back('\\'); break;
-        case '/': output.push_back('/'); break;
-        case 'b': output.push_back('b'); break;
-        case 'f': output.push_back('f'); break;
-        case 'n': output.push_back('n'); break;
-        case 'r': output.push_back('r'); break;
-        case 't': output.push_back('t'); break;
-        default:
-          throw json_parse_error("Invalid escape character in string");
-      }
-    } else
-      output.push_back(c);
+uint32_t JSONDocument::Element::find(std::string_view key) const {
+  const JSONTape::Node &object = node();
+  const JSONTape::Node *nodes = tape().nodes().data();
+  uint32_t found = 0;
+  uint32_t member = index + 1;
+  for(uint32_t i = 0; i < object.size; i++) {
+    const JSONTape::Node &name = nodes[member];
+    if(name.escaped ? string(name) == key : name.size == key.size() && tape().rawString(name) == key)
+      found = member + 1;
+    member = skip(member + 1);
   }
-  return JSONValue(output);
+  return found;
 }
 
-JSONValue JSONParser::parseNumber() {
-  const char* start = &input[pos];
-  while (pos < size && (std::isdigit(input[pos]) || input[pos] == '-' || input[pos] == '+' || input[pos] == '.' || input[pos] == 'e' || input[pos] == 'E')) {
-    pos++;
-  }
-  std::string_view numberView(start, &input[pos] - start);
-  double num;
-  auto res = std::from_chars(numberView.data(), numberView.data() + numberView.size(), num);
-  if (res.ec != std::errc()) throw json_parse_error("Invalid number");
-  return JSONValue(num);
-}
-
-JSONValue JSONParser::parseObject() {
-  JSONValue::Object obj;
-  obj.reserve(128);
-  get();
-  skipWhitespaces();
-  if(peek() == '}') {
-    get();
-    return JSONValue(obj);
-  }
-  if(peek() != '"')
-    throw json_parse_error("Expected \" as starting of key in JSON object");
-  else {
-    while(true) {
-      JSONValue keyObj = parseString(), value;
-      if(!std::holds_alternative<std::string>(keyObj.value))
-        throw json_parse_error("Object key is not a string");
-      std::string key = std::get<std::string>(keyObj.value);
-      skipWhitespaces();
-      if(get() != ':')
-        throw json_parse_error("Missing : after key value");
-      else {
-        skipWhitespaces();
-        char c = peek();
-        switch(c) {
-          case '"': value = parseString(); break;
-          case '{': value = parseObject(); break;
-          case '[': value = parseArray(); break;
-          case 'n': value = parseNull(); break;
-          case 't':
-          case 'f': value = parseBoolean(); break;
-          case '-':
-          case '1':
-          case '2':
-          case '3':
-          case '4':
-          case '5':
-          case '6':
-          case '7':
-          case '8':
-          case '9':
-          case '0': value = parseNumber(); break;
-          default: throw json_parse_error(std::string("Unexpected symbol caught: ") + c);
-        }
-      }
-      obj[key] = value;
-      skipWhitespaces();
-      char c = get();
-      if(c == '}')
-        break;
-      else if(c == ',') {
-        skipWhitespaces();
-        if(peek() == '}')
-          throw json_parse_error("Trailing commas not allowed in JSON object");
-        if(peek() != '"')
-          throw json_parse_error("Expected \" as starting of key in JSON object");
-      }
-      else
-        throw json_parse_error(std::string("Expected '}' or ',' but encountered unexpected symbol: ") + c);
-    }
-  }
-  return JSONValue(obj);
+bool JSONDocument::Element::contains(std::string_view key) const {
+  return node().type == JSONTape::Type::Object && find(key) != 0;
 }
 
-JSONValue JSONParser::parseArray() {
-  JSONValue::Array arr;
-  arr.reserve(128);
-  get();
-  skipWhitespaces();
-  if(peek() == ']') {
-    get();
-    return JSONValue(arr);
-  }
-  while(true) {
-    char c = peek();
-    JSONValue value;
-    switch(c) {
-      case '"': value = parseString(); break;
-      case '{': value = parseObject(); break;
-      case '[': value = parseArray(); break;
-      case 'n': value = parseNull(); break;
-      case 'f':
-      case 't': value = parseBoolean(); break;
-      case '-':
-      case '0':
-      case '1':
-      case '2':
-      case '3':
-      case '4':
-      case '5':
-      case '6':
-      case '7':
-      case '8':
-      case '9': value = parseNumber(); break;
-      default: throw json_parse_error(std::string("Unexpected symbol caught: ") + c);
-    }
-    skipWhitespaces();
-    c = get();
-    if(c == ']') {
-      arr.emplace_back(value);
-      break;
+JSONDocument::Element JSONDocument::Element::operator[](std::string_view key) const {
+  if(node().type != JSONTape::Type::Object)
+    throw json_type_error("Used [std::string_view] operator on a non object value");
+  uint32_t found = find(key);
+  if(found == 0)
+    throw std::out_of_range("No member named " + std::string(key) + " in JSON object");
+  return Element(document, found);
+}
+
+JSONDocument::Element JSONDocument::Element::operator[](size_t position) const {
+  const JSONTape::Node &array = node();
+  if(array.type != JSONTape::Type::Array)
+    throw json_type_error("Used [size_t] operator on a non array value");
+  if(position >= array.size)
+    throw std::out_of_range("Out of bounds index for array value");
+  uint32_t value = index + 1;
+  for(size_t i = 0; i < position; i++)
+    value = skip(value);
+  return Element(document, value);
+}
+
+double JSONDocument::Element::asDouble() const {
+  const JSONTape::Node &value = node();
+  if(value.type != JSONTape::Type::Number)
+    throw json_type_error("asDouble() used on a non number JSON value");
+  return value.number;
+}
+
+bool JSONDocument::Element::asBool() const {
+  JSONTape::Type type = node().type;
+  if(type != JSONTape::Type::True && type != JSONTape::Type::False)
+    throw json_type_error("asBool() used on a non boolean JSON value");
+  return type == JSONTape::Type::True;
+}
+
+std::string JSONDocument::Element::asString() const {
+  const JSONTape::Node &value = node();
+  if(value.type != JSONTape::Type::String)
+    throw json_type_error("asString() used on a non string JSON value");
+  return string(value);
+}
+
+std::string_view JSONDocument::Element::asStringView() const {
+  const JSONTape::Node &value = node();
+  if(value.type != JSONTape::Type::String)
+    throw json_type_error("asStringView() used on a non string JSON value");
+  std::string_view raw = tape().rawString(value);
+  if(!value.escaped)
+    return raw;
+  std::pmr::string &output = document->decoded.emplace_front(raw.size(), '\0');
+  output.resize(JSONTape::decodeString(raw, output.data()));
+  return output;
+}
+
+std::string JSONDocument::Element::string(const JSONTape::Node &node) const {
+  std::string_view raw = tape().rawString(node);
+  if(!node.escaped)
+    return std::string(raw);
+  std::string output(raw.size(), '\0');
+  output.resize(JSONTape::decodeString(raw, output.data()));
+  return output;
+}
+
+JSONValue JSONDocument::Element::build(uint32_t &position, std::pmr::memory_resource *resource) const {
+  const JSONTape::Node &node = tape().nodes()[position++];
+  switch(node.type) {
+    case JSONTape::Type::Null: return JSONValue(nullptr);
+    case JSONTape::Type::True: return JSONValue(true);
+    case JSONTape::Type::False: return JSONValue(false);
+    case JSONTape::Type::Number: return JSONValue(node.number);
+    case JSONTape::Type::String: return JSONValue(string(node));
+    case JSONTape::Type::Array: {
+      JSONValue::Array arr(resource);
+      arr.reserve(node.size);
+      for(uint32_t i = 0; i < node.size; i++)
+        arr.emplace_back(build(position, resource));
+      return JSONValue(std::move(arr));
     }
-    else if(c == ',') {
-      arr.emplace_back(value);
-      skipWhitespaces();
-      if(peek() == ']')
-        throw json_parse_error("Trailing commas not allowed in JSON arrays");
+    case JSONTape::Type::Object: {
+      JSONValue::Object obj(resource);
+      obj.reserve(node.size);
+      for(uint32_t i = 0; i < node.size; i++) {
+        std::string key = string(tape().nodes()[position++]);
+        obj.insert_or_assign(std::move(key), build(position, resource));
+      }
+      return JSONValue(std::move(obj));
     }
-    else
-      throw json_parse_error(std::string("Unexpected symbol caught: ") + c);
   }
-  return JSONValue(arr);
+  return JSONValue();
+}
+
+JSONValue JSONDocument::Element::toValue(std::pmr::memory_resource *resource) const {
+  uint32_t position = index;
+  return build(position, resource);
 }
 
 JSONValue JSONParser::parse() {
-  skipWhitespaces();
-  if(pos >= size || input == "")
-    return JSONValue();
-  JSONValue json;
-  char c = peek();
-  switch(c) {
-    case '"': json = parseString(); break;
-    case '{': json = parseObject(); break;
-    case '[': json = parseArray(); break;
-    case 'n': json = parseNull(); break;
-    case 'f':
-    case 't': json = parseBoolean(); break;
-    case '-':
-    case '0':
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9': json = parseNumber(); break;
-    default: throw json_parse_error(std::string("Unexpected symbol caught: ") + c);
-  }
-  skipWhitespaces();
-  if(pos >= size)
-    return json;
-  else
-    throw json_parse_error("Invalid JSON string value");
-}
\ No newline at end of file
+  document.parse(input);
+  return document.root().toValue(resource);
+}
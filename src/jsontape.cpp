@@ -0,0 +1,522 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+#include "errors.h"
+#include "jsontape.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BOLTPP_JSON_X86
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define BOLTPP_ALWAYS_INLINE __forceinline
+#else
+#define BOLTPP_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+/**
+ * @brief Bit i of every mask describes byte i of a block, strings are not taken into account yet.
+ */
+struct BlockMasks {
+  uint64_t backslashes;
+  uint64_t quotes;
+  uint64_t operators;  ///< { } [ ] : , and a few control characters the shuffle tables can't tell apart.
+  uint64_t whitespace;
+  uint64_t control;
+};
+
+/**
+ * @brief What a block hands on to the next one.
+ */
+struct BlockCarry {
+  uint64_t escaped = 0;   ///< 1 if the first byte of the next block is escaped.
+  uint64_t inString = 0;  ///< All ones if the next block starts inside a string.
+  uint64_t scalar = 0;    ///< 1 if the last byte was part of a number or literal.
+  uint64_t invalid = 0;   ///< Nonzero once a control character was found inside a string.
+};
+
+enum : uint8_t { BACKSLASH = 1, QUOTE = 2, OPERATOR = 4, WHITESPACE = 8, CONTROL = 16 };
+
+static constexpr std::array<uint8_t, 256> CLASSES = []() {
+  std::array<uint8_t, 256> table{};
+  for(int c = 0; c < 0x20; c++)
+    table[c] = CONTROL;
+  for(char c : {' ', '\t', '\n', '\r'})
+    table[static_cast<unsigned char>(c)] |= WHITESPACE;
+  for(char c : {'{', '}', '[', ']', ':', ','})
+    table[static_cast<unsigned char>(c)] = OPERATOR;
+  table['\\'] = BACKSLASH;
+  table['"'] = QUOTE;
+  return table;
+}();
+
+static BOLTPP_ALWAYS_INLINE uint64_t prefixXor(uint64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+}
+
+// The bytes following a backslash that is not escaped itself. Backslashes are rare in most documents, the
+// loop runs once per backslash and not at all for blocks without one.
+static BOLTPP_ALWAYS_INLINE uint64_t escapedBits(uint64_t backslashes, uint64_t &carry) {
+  uint64_t escaped = carry;
+  carry = 0;
+  backslashes &= ~escaped;
+  while(backslashes) {
+    uint64_t backslash = backslashes & -backslashes;
+    if(backslash >> 63) {
+      carry = 1;
+      break;
+    }
+    escaped |= backslash << 1;
+    backslashes &= ~(backslash | backslash << 1);
+  }
+  return escaped;
+}
+
+static BOLTPP_ALWAYS_INLINE uint64_t structuralBits(const BlockMasks &found, BlockCarry &carry) {
+  uint64_t quotes = found.quotes & ~escapedBits(found.backslashes, carry.escaped);
+  // Set from an opening quote up to, not including, its closing quote.
+  uint64_t inString = prefixXor(quotes) ^ carry.inString;
+  carry.inString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+  carry.invalid |= found.control & inString;
+  uint64_t operators = found.operators & ~inString;
+  uint64_t scalars = ~(operators | found.whitespace | quotes | inString);
+  uint64_t atomStarts = scalars & ~(scalars << 1 | carry.scalar);
+  carry.scalar = scalars >> 63;
+  return operators | quotes | atomStarts;
+}
+
+static BOLTPP_ALWAYS_INLINE size_t appendOffsets(uint64_t bits, uint32_t base, uint32_t *offsets, size_t count) {
+  while(bits) {
+    offsets[count++] = base + static_cast<uint32_t>(std::countr_zero(bits));
+    bits &= bits - 1;
+  }
+  return count;
+}
+
+// The loop every indexer runs, a macro like the one of HttpTokenizer because GCC refuses to inline the
+// vectorized mask functions into code compiled for the baseline. The last block is padded with spaces, which
+// are neither structural nor part of a value.
+#define BOLTPP_JSON_INDEX_BLOCKS(masks)                                                             \
+  const size_t BLOCK = JSONTape::BLOCK_BYTES;                                                        \
+  BlockCarry carry;                                                                                 \
+  size_t count = 0;                                                                                 \
+  for(size_t at = 0; at < length; at += BLOCK) {                                                    \
+    BlockMasks found;                                                                               \
+    if(length - at >= BLOCK) {                                                                      \
+      found = masks(begin + at);                                                                    \
+    } else {                                                                                        \
+      alignas(64) char padded[BLOCK];                                                               \
+      std::memset(padded, ' ', BLOCK);                                                              \
+      std::memcpy(padded, begin + at, length - at);                                                 \
+      found = masks(padded);                                                                        \
+    }                                                                                               \
+    uint64_t structurals = structuralBits(found, carry);                                            \
+    if(offsets.size() < count + BLOCK)                                                              \
+      offsets.resize(std::max(count + BLOCK, offsets.size() * 2));                                  \
+    count = appendOffsets(structurals, static_cast<uint32_t>(at), offsets.data(), count);           \
+  }                                                                                                 \
+  offsets.resize(count);                                                                            \
+  return !carry.inString && !carry.invalid;
+
+static BOLTPP_ALWAYS_INLINE BlockMasks masksScalar(const char *block) {
+  BlockMasks found{0, 0, 0, 0, 0};
+  for(size_t i = 0; i < JSONTape::BLOCK_BYTES; i++) {
+    uint8_t classes = CLASSES[static_cast<unsigned char>(block[i])];
+    if(classes == 0)
+      continue;
+    uint64_t bit = uint64_t(1) << i;
+    found.backslashes |= classes & BACKSLASH ? bit : 0;
+    found.quotes |= classes & QUOTE ? bit : 0;
+    found.operators |= classes & OPERATOR ? bit : 0;
+    found.whitespace |= classes & WHITESPACE ? bit : 0;
+    found.control |= classes & CONTROL ? bit : 0;
+  }
+  return found;
+}
+
+static bool indexScalar(const char *begin, size_t length, std::pmr::vector<uint32_t> &offsets) {
+  BOLTPP_JSON_INDEX_BLOCKS(masksScalar)
+}
+
+#ifdef BOLTPP_JSON_X86
+// Whitespace and operators are looked up by the low nibble of a byte, the table holds the one byte of that
+// nibble which belongs to the class, see simdjson. '[' and ']' differ from '{' and '}' by 0x20, or-ing it in
+// folds them together. Bytes with the high bit set shuffle to 0 and match neither class.
+#define BOLTPP_JSON_WHITESPACE_TABLE ' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100
+#define BOLTPP_JSON_OPERATOR_TABLE 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0
+
+__attribute__((target("sse4.2"))) static BOLTPP_ALWAYS_INLINE BlockMasks masksSSE42(const char *block) {
+  const __m128i whitespaceTable = _mm_setr_epi8(BOLTPP_JSON_WHITESPACE_TABLE);
+  const __m128i operatorTable = _mm_setr_epi8(BOLTPP_JSON_OPERATOR_TABLE);
+  const __m128i controlLimit = _mm_set1_epi8(0x1F);
+  BlockMasks found{0, 0, 0, 0, 0};
+  for(int part = 0; part < 4; part++) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + part * 16));
+#define BOLTPP_JSON_BITS(mask) (static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(mask))) << (part * 16))
+    found.backslashes |= BOLTPP_JSON_BITS(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\')));
+    found.quotes |= BOLTPP_JSON_BITS(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')));
+    found.whitespace |= BOLTPP_JSON_BITS(_mm_cmpeq_epi8(bytes, _mm_shuffle_epi8(whitespaceTable, bytes)));
+    found.operators |= BOLTPP_JSON_BITS(_mm_cmpeq_epi8(_mm_or_si128(bytes, _mm_set1_epi8(0x20)),
+                                                       _mm_shuffle_epi8(operatorTable, bytes)));
+    found.control |= BOLTPP_JSON_BITS(_mm_cmpeq_epi8(_mm_max_epu8(bytes, controlLimit), controlLimit));
+#undef BOLTPP_JSON_BITS
+  }
+  return found;
+}
+
+__attribute__((target("sse4.2")))
+static bool indexSSE42(const char *begin, size_t length, std::pmr::vector<uint32_t> &offsets) {
+  BOLTPP_JSON_INDEX_BLOCKS(masksSSE42)
+}
+
+__attribute__((target("avx2,bmi"))) static BOLTPP_ALWAYS_INLINE BlockMasks masksAVX2(const char *block) {
+  const __m256i whitespaceTable = _mm256_setr_epi8(BOLTPP_JSON_WHITESPACE_TABLE, BOLTPP_JSON_WHITESPACE_TABLE);
+  const __m256i operatorTable = _mm256_setr_epi8(BOLTPP_JSON_OPERATOR_TABLE, BOLTPP_JSON_OPERATOR_TABLE);
+  const __m256i controlLimit = _mm256_set1_epi8(0x1F);
+  BlockMasks found{0, 0, 0, 0, 0};
+  for(int part = 0; part < 2; part++) {
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + part * 32));
+#define BOLTPP_JSON_BITS(mask) (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(mask))) << (part * 32))
+    found.backslashes |= BOLTPP_JSON_BITS(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\')));
+    found.quotes |= BOLTPP_JSON_BITS(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')));
+    found.whitespace |= BOLTPP_JSON_BITS(_mm256_cmpeq_epi8(bytes, _mm256_shuffle_epi8(whitespaceTable, bytes)));
+    found.operators |= BOLTPP_JSON_BITS(_mm256_cmpeq_epi8(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)),
+                                                          _mm256_shuffle_epi8(operatorTable, bytes)));
+    found.control |= BOLTPP_JSON_BITS(_mm256_cmpeq_epi8(_mm256_max_epu8(bytes, controlLimit), controlLimit));
+#undef BOLTPP_JSON_BITS
+  }
+  return found;
+}
+
+__attribute__((target("avx2,bmi")))
+static bool indexAVX2(const char *begin, size_t length, std::pmr::vector<uint32_t> &offsets) {
+  BOLTPP_JSON_INDEX_BLOCKS(masksAVX2)
+}
+
+#undef BOLTPP_JSON_WHITESPACE_TABLE
+#undef BOLTPP_JSON_OPERATOR_TABLE
+#endif
+
+#undef BOLTPP_JSON_INDEX_BLOCKS
+
+JSONTape::Indexer JSONTape::indexer(Isa isa) {
+  switch(isa) {
+  case Isa::Scalar:
+    return &indexScalar;
+  case Isa::SSE42:
+#ifdef BOLTPP_JSON_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2"))
+      return &indexSSE42;
+#endif
+    return nullptr;
+  case Isa::AVX2:
+#ifdef BOLTPP_JSON_X86
+    // May run during static initialization, ahead of the CPU feature detection of the runtime.
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi"))
+      return &indexAVX2;
+#endif
+    return nullptr;
+  }
+  return nullptr;
+}
+
+JSONTape::Isa JSONTape::best() {
+  if(indexer(Isa::AVX2))
+    return Isa::AVX2;
+  if(indexer(Isa::SSE42))
+    return Isa::SSE42;
+  return Isa::Scalar;
+}
+
+const char* JSONTape::isaName(Isa isa) {
+  switch(isa) {
+  case Isa::Scalar: return "scalar";
+  case Isa::SSE42: return "sse4.2";
+  case Isa::AVX2: return "avx2";
+  }
+  return "unknown";
+}
+
+const JSONTape::Indexer JSONTape::active = JSONTape::indexer(JSONTape::best());
+
+// A number or literal ends where whitespace, an operator, a quote or the document begins.
+static inline bool endsAtom(std::string_view json, size_t at) {
+  return at == json.size() || (CLASSES[static_cast<unsigned char>(json[at])] & (QUOTE | OPERATOR | WHITESPACE));
+}
+
+// The character a single letter escape stands for, 0 for letters that are no escape. \\u is handled apart.
+static inline char unescape(char c) {
+  switch(c) {
+    case '"': return '"';
+    case '\\': return '\\';
+    case '/': return '/';
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 't': return '\t';
+    default: return 0;
+  }
+}
+
+// The value of the four hex digits at p, -1 if one of them is not a hex digit.
+static inline int32_t hex4(const char *p) {
+  int32_t value = 0;
+  for(int i = 0; i < 4; i++) {
+    char c = p[i], lower = c | 0x20;
+    int32_t digit;
+    if(c >= '0' && c <= '9')
+      digit = c - '0';
+    else if(lower >= 'a' && lower <= 'f')
+      digit = lower - 'a' + 10;
+    else
+      return -1;
+    value = value << 4 | digit;
+  }
+  return value;
+}
+
+// The code point of the \\u escape at p, which points at its backslash, and of the low surrogate escape after it
+// if it is a high surrogate. Advances p past them. -1 if the digits are invalid or a surrogate is unpaired.
+static int32_t codePoint(const char *&p, const char *end) {
+  if(end - p < 6)
+    return -1;
+  int32_t unit = hex4(p + 2);
+  if(unit < 0)
+    return -1;
+  p += 6;
+  if(unit < 0xD800 || unit > 0xDFFF)
+    return unit;
+  if(unit >= 0xDC00 || end - p < 6 || p[0] != '\\' || p[1] != 'u')
+    return -1;
+  int32_t low = hex4(p + 2);
+  if(low < 0xDC00 || low > 0xDFFF)
+    return -1;
+  p += 6;
+  return 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+}
+
+// Writes the UTF-8 encoding of code to out, returns the bytes written.
+static inline size_t encodeUtf8(uint32_t code, char *out) {
+  if(code < 0x80) {
+    out[0] = char(code);
+    return 1;
+  }
+  if(code < 0x800) {
+    out[0] = char(0xC0 | code >> 6);
+    out[1] = char(0x80 | (code & 0x3F));
+    return 2;
+  }
+  if(code < 0x10000) {
+    out[0] = char(0xE0 | code >> 12);
+    out[1] = char(0x80 | (code >> 6 & 0x3F));
+    out[2] = char(0x80 | (code & 0x3F));
+    return 3;
+  }
+  out[0] = char(0xF0 | code >> 18);
+  out[1] = char(0x80 | (code >> 12 & 0x3F));
+  out[2] = char(0x80 | (code >> 6 & 0x3F));
+  out[3] = char(0x80 | (code & 0x3F));
+  return 4;
+}
+
+// The end of the number at p by the JSON grammar, nullptr if there is none.
+static const char* scanNumber(const char *p, const char *end) {
+  auto digits = [&]() {
+    const char *start = p;
+    while(p < end && *p >= '0' && *p <= '9')
+      p++;
+    return p != start;
+  };
+  if(p < end && *p == '-')
+    p++;
+  if(p < end && *p == '0')
+    p++;
+  else if(!digits())
+    return nullptr;
+  if(p < end && *p == '.') {
+    p++;
+    if(!digits())
+      return nullptr;
+  }
+  if(p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    if(p < end && (*p == '+' || *p == '-'))
+      p++;
+    if(!digits())
+      return nullptr;
+  }
+  return p;
+}
+
+size_t JSONTape::decodeString(std::string_view raw, char *out) {
+  const char *text = raw.data(), *end = text + raw.size();
+  char *written = out;
+  while(true) {
+    const char *backslash = static_cast<const char*>(std::memchr(text, '\\', end - text));
+    const char *run = backslash ? backslash : end;
+    std::memcpy(written, text, run - text);
+    written += run - text;
+    if(!backslash)
+      return written - out;
+    if(backslash[1] == 'u') {
+      text = backslash;
+      int32_t code = codePoint(text, end);
+      if(code < 0)
+        throw json_parse_error("Invalid \\u escape in string");
+      written += encodeUtf8(code, written);
+      continue;
+    }
+    char escape = unescape(backslash[1]);
+    if(!escape)
+      throw json_parse_error("Invalid escape character in string");
+    *written++ = escape;
+    text = backslash + 2;
+  }
+}
+
+void JSONTape::parse(std::string_view document) {
+  if(document.size() > MAX_BYTES)
+    throw json_parse_error("JSON document too large");
+  json = document;
+  tape.clear();
+  open.clear();
+  if(!index(json, structurals))
+    throw json_parse_error("Unterminated string or control character in string");
+  build();
+}
+
+void JSONTape::pushString(uint32_t quote, const uint32_t *&offset) {
+  // Stage one found every string closed, the next offset is the closing quote.
+  uint32_t begin = quote + 1, closing = *offset++;
+  Node node;
+  node.type = Type::String;
+  node.size = closing - begin;
+  node.offset = begin;
+  // A backslash is never the last byte, it would have escaped the closing quote.
+  const char *text = json.data() + begin, *end = text + node.size;
+  for(const char *backslash = text; (backslash = static_cast<const char*>(std::memchr(backslash, '\\', end - backslash)));) {
+    node.escaped = true;
+    if(backslash[1] == 'u') {
+      if(codePoint(backslash, end) < 0)
+        throw json_parse_error("Invalid \\u escape or unpaired surrogate in string");
+    } else if(!unescape(backslash[1]))
+      throw json_parse_error("Invalid escape character in string");
+    else
+      backslash += 2;
+  }
+  tape.push_back(node);
+}
+
+void JSONTape::pushKey(const uint32_t *&offset, const uint32_t *last) {
+  if(offset == last || json[*offset] != '"')
+    throw json_parse_error("Expected \" as starting of key in JSON object");
+  uint32_t quote = *offset++;
+  pushString(quote, offset);
+  if(offset == last || json[*offset] != ':')
+    throw json_parse_error("Missing : after key value");
+  offset++;
+}
+
+void JSONTape::pushAtom(uint32_t at) {
+  Node node;
+  std::string_view literal;
+  switch(json[at]) {
+    case 't': node.type = Type::True; literal = "true"; break;
+    case 'f': node.type = Type::False; literal = "false"; break;
+    case 'n': node.type = Type::Null; literal = "null"; break;
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9': {
+      const char *begin = json.data() + at, *end = scanNumber(begin, json.data() + json.size());
+      if(!end || !endsAtom(json, end - json.data()) || std::from_chars(begin, end, node.number).ec != std::errc())
+        throw json_parse_error("Invalid number");
+      node.type = Type::Number;
+      tape.push_back(node);
+      return;
+    }
+    default: throw json_parse_error(std::string("Unexpected symbol caught: ") + json[at]);
+  }
+  if(json.compare(at, literal.size(), literal) != 0 || !endsAtom(json, at + literal.size()))
+    throw json_parse_error("Unexpected value caught, expected '" + std::string(literal) + "'");
+  tape.push_back(node);
+}
+
+void JSONTape::build() {
+  const uint32_t *offset = structurals.data(), *last = offset + structurals.size();
+  if(offset == last) {
+    tape.emplace_back();
+    return;
+  }
+  // Every turn reads one value, then the separators and closing brackets up to the next value.
+  while(true) {
+    if(offset == last)
+      throw json_parse_error("Unexpected end of JSON");
+    uint32_t at = *offset++;
+    char c = json[at];
+    if(c == '{' || c == '[') {
+      if(open.size() == MAX_DEPTH)
+        throw json_parse_error("JSON nested too deeply");
+      char closing = c == '{' ? '}' : ']';
+      Node node;
+      node.type = c == '{' ? Type::Object : Type::Array;
+      tape.push_back(node);
+      if(offset != last && json[*offset] == closing) {
+        offset++;
+        tape.back().next = static_cast<uint32_t>(tape.size());
+      } else {
+        open.push_back(static_cast<uint32_t>(tape.size() - 1));
+        if(c == '{')
+          pushKey(offset, last);
+        continue;
+      }
+    } else if(c == '"') {
+      pushString(at, offset);
+    } else {
+      pushAtom(at);
+    }
+
+    while(true) {
+      if(open.empty()) {
+        if(offset != last)
+          throw json_parse_error("Invalid JSON string value");
+        return;
+      }
+      Node &container = tape[open.back()];
+      container.size++;
+      if(offset == last)
+        throw json_parse_error("Unexpected end of JSON");
+      char separator = json[*offset++];
+      bool object = container.type == Type::Object;
+      if(separator == ',') {
+        if(object)
+          pushKey(offset, last);
+        break;
+      }
+      if(separator != (object ? '}' : ']'))
+        throw json_parse_error(std::string("Expected ',' or '") + (object ? '}' : ']') + "' but encountered unexpected symbol: " + separator);
+      container.next = static_cast<uint32_t>(tape.size());
+      open.pop_back();
+    }
+  }
+}
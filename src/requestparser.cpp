@@ -0,0 +1,168 @@
+#include <charconv>
+#include <algorithm>
+
+#include "utils.h"
+#include "httptokenizer.h"
+#include "httpserver.h"
+
+void HttpServer::RequestParser::reset() {
+  state = State::RequestLine;
+  scanOffset = lineStart = requestStart = bodyStart = contentLength = consumedLength = 0;
+  colon = std::string_view::npos;
+  hasContentLength = connectionClose = false;
+  errorCode = 400;
+  package.reset();
+}
+
+HttpServer::RequestParser::Status HttpServer::RequestParser::fail(int statusCode) {
+  errorCode = statusCode;
+  return Status::Error;
+}
+
+bool HttpServer::RequestParser::parseRequestLine(std::string_view line) {
+  size_t methodEnd = line.find(' ');
+  if(methodEnd == std::string_view::npos || methodEnd == 0)
+    return false;
+
+  size_t urlStart = methodEnd + 1;
+  size_t urlEnd = line.find(' ', urlStart);
+  if(urlEnd == std::string_view::npos || urlEnd == urlStart)
+    return false;
+
+  std::string_view protocol = line.substr(urlEnd + 1);
+  if(protocol.substr(0, 5) != "HTTP/")
+    return false;
+
+  Request &parsed = request();
+  parsed.method = std::string(line.substr(0, methodEnd));
+  parsed.url = std::string(line.substr(urlStart, urlEnd - urlStart));
+  parsed.protocol = std::string(protocol);
+  // Growing the vector in the arena would leave every outgrown copy behind, most requests fit into this.
+  parsed.headerSlices.reserve(16);
+  parseQueryParameters(parsed);
+  return true;
+}
+
+bool HttpServer::RequestParser::parseHeaderLine(std::string_view line, size_t colon, size_t offset) {
+  if(colon == std::string_view::npos || colon == 0)
+    return false;
+
+  std::string_view key = trimView(line.substr(0, colon));
+  std::string_view value = trimView(line.substr(colon + 1));
+  HttpHeader header = lookupHttpHeader(key);
+
+  // Chunked bodies are not supported, framing them by Content-Length would desync the connection.
+  if(header == HttpHeader::TransferEncoding) {
+    errorCode = 501;
+    return false;
+  }
+
+  if(header == HttpHeader::ContentLength) {
+    size_t length = 0;
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+    if(value.empty() || ec != std::errc() || ptr != value.data() + value.size())
+      return false;
+    if(hasContentLength && length != contentLength)
+      return false;
+    hasContentLength = true;
+    contentLength = length;
+  }
+
+  if(header == HttpHeader::Connection && equalsIgnoreCase(value, "close"))
+    connectionClose = true;
+
+  // Only remember where name and value are, the bytes are copied in one piece once the header block is complete.
+  Request::Slice name{offset + static_cast<size_t>(key.data() - line.data()), key.size()};
+  Request::Slice content{offset + static_cast<size_t>(value.data() - line.data()), value.size()};
+  Request &parsed = request();
+  // Header slots hold 16 bit indices, no sane client sends that many fields.
+  if(parsed.headerSlices.size() == UINT16_MAX) {
+    errorCode = 431;
+    return false;
+  }
+  parsed.headerSlices.push_back({name, content});
+  if(header != HttpHeader::Unknown)
+    parsed.knownHeaders[static_cast<size_t>(header)] = static_cast<uint16_t>(parsed.headerSlices.size());
+  return true;
+}
+
+HttpServer::RequestParser::Status HttpServer::RequestParser::parse(std::string_view data, size_t maxHeaderSize,
+                                                                    size_t maxBodySize) {
+  HttpTokenizer::Index index;
+  size_t base = scanOffset, nextLineFeed = 0, nextColon = 0;
+
+  while(state != State::Body) {
+    if(nextLineFeed == index.lineFeedCount) {
+      // No line ends in the indexed range any more, the colons left belong to the unfinished line.
+      if(state == State::Headers && colon == std::string_view::npos) {
+        for(; nextColon < index.colonCount; nextColon++) {
+          if(base + index.colons[nextColon] >= lineStart) {
+            colon = base + index.colons[nextColon] - lineStart;
+            break;
+          }
+        }
+      }
+      if(index.invalid != SIZE_MAX)
+        return fail(400);
+      base = scanOffset = base + index.length;
+      if(base >= data.size()) {
+        if(data.size() > maxHeaderSize)
+          return fail(431);
+        return Status::Incomplete;
+      }
+      HttpTokenizer::index(data.data() + base, data.data() + data.size(), index);
+      nextLineFeed = nextColon = 0;
+      continue;
+    }
+
+    size_t lineFeed = base + index.lineFeeds[nextLineFeed++];
+    // Lines end in CRLF, a bare LF is as invalid as any other control character.
+    if(lineFeed == lineStart || data[lineFeed - 1] != '\r')
+      return fail(400);
+    size_t lineEnd = lineFeed - 1;
+    if(index.invalid != SIZE_MAX && base + index.invalid < lineEnd)
+      return fail(400);
+    if(lineEnd > maxHeaderSize)
+      return fail(431);
+    if(state == State::Headers && colon == std::string_view::npos) {
+      while(nextColon < index.colonCount && base + index.colons[nextColon] < lineStart)
+        nextColon++;
+      if(nextColon < index.colonCount && base + index.colons[nextColon] < lineEnd)
+        colon = base + index.colons[nextColon] - lineStart;
+    }
+
+    size_t lineOffset = lineStart;
+    size_t lineColon = colon;
+    std::string_view line = data.substr(lineStart, lineEnd - lineStart);
+    lineStart = lineFeed + 1;
+    colon = std::string_view::npos;
+
+    if(state == State::RequestLine) {
+      // Empty lines ahead of the request line are ignored (RFC 9112 section 2.2).
+      if(line.empty())
+        continue;
+      if(!package)
+        package = std::make_unique<RequestPackage>();
+      requestStart = lineOffset;
+      if(!parseRequestLine(line))
+        return fail(400);
+      state = State::Headers;
+    } else if(line.empty()) {
+      // Refused before any of the body is buffered, the bytes already sent are discarded with the connection.
+      if(contentLength > maxBodySize)
+        return fail(413);
+      bodyStart = lineStart;
+      request().head.assign(data.substr(requestStart, bodyStart - requestStart));
+      state = State::Body;
+    } else if(!parseHeaderLine(line, lineColon, lineOffset - requestStart)) {
+      return fail(errorCode);
+    }
+  }
+
+  if(data.size() - bodyStart < contentLength)
+    return Status::Incomplete;
+
+  request().payload.assign(data.substr(bodyStart, contentLength));
+  consumedLength = bodyStart + contentLength;
+  return Status::Complete;
+}
@@ -1,4 +1,5 @@
 #include "response.h"
+#include "utils.h"
 
 #include <filesystem>
 #include <functional>
@@ -15,24 +16,84 @@ Response& Response::status(int statusCode) {
 }
 
 Response& Response::json(const JSONValue &j) {
-  std::string jsonString = j.stringify();
-  this->payload = jsonString;
-  headers["Content-Type"] = "application/json";
-  headers["Content-Length"] = std::to_string(jsonString.length());
+  this->payload = j.stringify();
+  setHeader(HttpHeader::ContentType, "application/json");
   return *this;
 }
 
 Response& Response::send(const std::string_view dataView) {
+  if(headResponse) {
+    // Only the length of the body is sent, there is no need to keep a copy of it.
+    contentLength = dataView.size();
+    return *this;
+  }
   this->payload = dataView;
-  headers["Content-Length"] = std::to_string(dataView.length());
   return *this;
 }
 
 Response& Response::setHeader(const std::string_view key, const std::string_view value) {
-  headers[std::string(key)] = value;
+  HttpHeader header = lookupHttpHeader(key);
+  if(header != HttpHeader::Unknown)
+    return setHeader(header, value);
+  for(auto &it : headers) {
+    if(equalsIgnoreCase(it.first, key)) {
+      it.second = value;
+      return *this;
+    }
+  }
+  headers.emplace(std::string(key), std::string(value));
   return *this;
 }
 
+Response& Response::setHeader(HttpHeader header, const std::string_view value) {
+  uint8_t &slot = knownSlots[static_cast<size_t>(header)];
+  if(slot == 0) {
+    knownHeaders.push_back({header, std::pmr::string(value, knownHeaders.get_allocator())});
+    slot = static_cast<uint8_t>(knownHeaders.size());
+  } else {
+    knownHeaders[slot - 1].value.assign(value);
+  }
+  return *this;
+}
+
+std::string_view Response::getHeader(const std::string_view key) const {
+  HttpHeader header = lookupHttpHeader(key);
+  if(header != HttpHeader::Unknown)
+    return getHeader(header);
+  const std::string *value = findCustomHeader(key);
+  return value ? std::string_view(*value) : std::string_view();
+}
+
+std::string_view Response::getHeader(HttpHeader header) const {
+  uint8_t slot = knownSlots[static_cast<size_t>(header)];
+  if(slot != 0)
+    return knownHeaders[slot - 1].value;
+  // Handlers may still have written a well-known header into the map directly.
+  const std::string *value = headers.empty() ? nullptr : findCustomHeader(httpHeaderName(header));
+  return value ? std::string_view(*value) : std::string_view();
+}
+
+bool Response::hasHeader(HttpHeader header) const {
+  return knownSlots[static_cast<size_t>(header)] != 0 ||
+         (!headers.empty() && findCustomHeader(httpHeaderName(header)) != nullptr);
+}
+
+const std::string* Response::findCustomHeader(const std::string_view key) const {
+  for(const auto &it : headers) {
+    if(equalsIgnoreCase(it.first, key))
+      return &it.second;
+  }
+  return nullptr;
+}
+
+void Response::reset() {
+  // The arena of the request keeps what the handler allocated, the fresh containers draw from it again.
+  Response fresh(knownHeaders.get_allocator().resource());
+  fresh.protocol = std::move(protocol);
+  fresh.headResponse = headResponse;
+  *this = std::move(fresh);
+}
+
 const std::string Response::getMimeType(const std::string& extension) {
   static const std::unordered_map<std::string, std::string> mime_types = {
     {".html", "text/html"},
@@ -64,9 +125,9 @@ Response& Response::sendFile(const std::string_view file_path) {
   std::string extension = fsPath.has_extension() ? fsPath.extension().string() : "";
   std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
 
-  headers["Content-Type"] = getMimeType(extension);
+  setHeader(HttpHeader::ContentType, getMimeType(extension));
 
-  headers["Content-Disposition"] = "inline; filename=\"" + fsPath.filename().string() + "\"";
+  setHeader(HttpHeader::ContentDisposition, "inline; filename=\"" + fsPath.filename().string() + "\"");
 
   return *this;
 }
@@ -79,9 +140,9 @@ Response& Response::download(const std::string_view file_path) {
   std::string extension = fsPath.has_extension() ? fsPath.extension().string() : "";
   std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
 
-  headers["Content-Type"] = getMimeType(extension);
+  setHeader(HttpHeader::ContentType, getMimeType(extension));
 
-  headers["Content-Disposition"] = "attachment; filename=\"" + fsPath.filename().string() + "\"";
+  setHeader(HttpHeader::ContentDisposition, "attachment; filename=\"" + fsPath.filename().string() + "\"");
 
   return *this;
 }
\ No newline at end of file
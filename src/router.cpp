@@ -0,0 +1,80 @@
+#include <stdexcept>
+
+#include "httpserver.h"
+#include "router.h"
+
+void Router::use(Middleware middleware) {
+  if(!server) {
+    middlewares.push_back(std::move(middleware));
+    return;
+  }
+  if(server->routesPublished())
+    throw std::runtime_error("Middlewares can't be added once the server is initialized");
+  server->prefixMiddlewares.push_back({prefix.empty() ? "/" : prefix, std::move(middleware)});
+}
+
+Router& Router::group(const std::string &path, const std::vector<Middleware> &groupMiddlewares) {
+  std::unique_ptr<Router> group = server ? std::unique_ptr<Router>(new Router(server, joinPath(prefix, path)))
+                                         : std::make_unique<Router>();
+  for(const Middleware &middleware : groupMiddlewares)
+    group->use(middleware);
+  groups.emplace_back(path, std::move(group));
+  return *groups.back().second;
+}
+
+void Router::mount(const std::string &path, const Router &router) {
+  Router &target = group(path, router.middlewares);
+  for(const Definition &route : router.routes)
+    target.add(route);
+  for(const auto &[groupPath, group] : router.groups)
+    target.mount(groupPath, *group);
+}
+
+void Router::add(Definition route) {
+  if(!server) {
+    routes.push_back(std::move(route));
+    return;
+  }
+  server->addRoute(route.method, joinPath(prefix, route.path), route.middlewares, std::move(route.handler),
+                   route.bindParameters);
+}
+
+void Router::Get(const std::string &path, const std::vector<Middleware> &middlewares, std::function<void(Request&, Response&)> handler) {
+  add({HttpMethod::Get, path, middlewares, std::move(handler)});
+}
+
+void Router::Get(const std::string &path, std::function<void(Request&, Response&)> handler) {
+  add({HttpMethod::Get, path, {}, std::move(handler)});
+}
+
+void Router::Post(const std::string &path, const std::vector<Middleware> &middlewares, std::function<void(Request&, Response&)> handler) {
+  add({HttpMethod::Post, path, middlewares, std::move(handler)});
+}
+
+void Router::Post(const std::string &path, std::function<void(Request&, Response&)> handler) {
+  add({HttpMethod::Post, path, {}, std::move(handler)});
+}
+
+void Router::Patch(const std::string &path, const std::vector<Middleware> &middlewares, std::function<void(Request&, Response&)> handler) {
+  add({HttpMethod::Patch, path, middlewares, std::move(handler)});
+}
+
+void Router::Patch(const std::string &path, std::function<void(Request&, Response&)> handler) {
+  add({HttpMethod::Patch, path, {}, std::move(handler)});
+}
+
+void Router::Put(const std::string &path, const std::vector<Middleware> &middlewares, std::function<void(Request&, Response&)> handler) {
+  add({HttpMethod::Put, path, middlewares, std::move(handler)});
+}
+
+void Router::Put(const std::string &path, std::function<void(Request&, Response&)> handler) {
+  add({HttpMethod::Put, path, {}, std::move(handler)});
+}
+
+void Router::Delete(const std::string &path, const std::vector<Middleware> &middlewares, std::function<void(Request&, Response&)> handler) {
+  add({HttpMethod::Delete, path, middlewares, std::move(handler)});
+}
+
+void Router::Delete(const std::string &path, std::function<void(Request&, Response&)> handler) {
+  add({HttpMethod::Delete, path, {}, std::move(handler)});
+}
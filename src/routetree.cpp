@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+
+#include "routetree.h"
+
+struct RouteTree::BuildNode {
+  std::string label;
+  std::vector<std::unique_ptr<BuildNode>> children;
+  std::unique_ptr<BuildNode> parameterChild;
+  uint32_t route = NO_ROUTE;
+};
+
+RouteTree::RouteTree() : root(std::make_unique<BuildNode>()) {}
+
+RouteTree::~RouteTree() = default;
+
+std::string RouteTree::parsePattern(std::string_view pattern, std::vector<std::string> *parameterNames) {
+  std::string shape;
+  size_t parameters = 0;
+  size_t start = 0;
+  while(start < pattern.size()) {
+    size_t end = pattern.find('/', start);
+    if(end == std::string_view::npos)
+      end = pattern.size();
+    std::string_view segment = pattern.substr(start, end - start);
+    start = end + 1;
+    if(segment.empty())
+      continue;
+
+    shape.push_back('/');
+    if(segment[0] != ':') {
+      shape.append(segment);
+      continue;
+    }
+    if(segment.size() == 1)
+      throw std::runtime_error("Route parameter without a name in " + std::string(pattern));
+    if(++parameters > MAX_PARAMETERS)
+      throw std::runtime_error("Too many route parameters in " + std::string(pattern));
+    shape.push_back(':');
+    if(parameterNames)
+      parameterNames->emplace_back(segment.substr(1));
+  }
+  if(shape.empty())
+    shape.push_back('/');
+  return shape;
+}
+
+uint32_t RouteTree::insert(std::string_view pattern, std::vector<std::string> *parameterNames) {
+  if(isFrozen)
+    throw std::runtime_error("Routes can't be added to a frozen route table: " + std::string(pattern));
+  if(parameterNames)
+    parameterNames->clear();
+  std::string shape = parsePattern(pattern, parameterNames);
+  auto [it, inserted] = shapes.emplace(shape, static_cast<uint32_t>(shapes.size()));
+  if(!inserted)
+    return it->second;
+
+  BuildNode *node = root.get();
+  std::string_view rest = shape;
+  while(!rest.empty()) {
+    // A parameter is a ':' right after a '/', it stands for the whole segment.
+    if(rest[0] == ':') {
+      if(!node->parameterChild)
+        node->parameterChild = std::make_unique<BuildNode>();
+      node = node->parameterChild.get();
+      rest.remove_prefix(1);
+      continue;
+    }
+
+    size_t literalEnd = 0;
+    while(literalEnd < rest.size() && !(rest[literalEnd] == ':' && literalEnd > 0 && rest[literalEnd - 1] == '/'))
+      literalEnd++;
+    std::string_view literal = rest.substr(0, literalEnd);
+    rest.remove_prefix(literalEnd);
+
+    while(!literal.empty()) {
+      std::unique_ptr<BuildNode> *next = nullptr;
+      for(std::unique_ptr<BuildNode> &child : node->children) {
+        if(child->label[0] == literal[0]) {
+          next = &child;
+          break;
+        }
+      }
+      if(!next) {
+        node->children.push_back(std::make_unique<BuildNode>());
+        node->children.back()->label = std::string(literal);
+        node = node->children.back().get();
+        break;
+      }
+
+      std::string &label = (*next)->label;
+      size_t common = 0;
+      while(common < label.size() && common < literal.size() && label[common] == literal[common])
+        common++;
+      if(common < label.size()) {
+        // The new pattern leaves the edge midway, the shared part becomes a node of its own.
+        auto split = std::make_unique<BuildNode>();
+        split->label = label.substr(0, common);
+        label.erase(0, common);
+        split->children.push_back(std::move(*next));
+        *next = std::move(split);
+      }
+      node = next->get();
+      literal.remove_prefix(common);
+    }
+  }
+
+  node->route = it->second;
+  stale = true;
+  return it->second;
+}
+
+bool RouteTree::covers(std::string_view prefix, std::string_view pattern) {
+  std::string outer = shapeOf(prefix);
+  std::string inner = shapeOf(pattern);
+  if(outer == "/")
+    return true;
+  return inner.compare(0, outer.size(), outer) == 0 && (inner.size() == outer.size() || inner[outer.size()] == '/');
+}
+
+uint32_t RouteTree::find(std::string_view pattern) const {
+  auto it = shapes.find(parsePattern(pattern, nullptr));
+  return it == shapes.end() ? NO_ROUTE : it->second;
+}
+
+void RouteTree::flatten() const {
+  stale = false;
+  nodes.clear();
+  labels.clear();
+  // Breadth first, so the children of every node end up next to each other.
+  std::deque<std::pair<const BuildNode*, uint32_t>> pending{{root.get(), 0}};
+  nodes.emplace_back();
+  while(!pending.empty()) {
+    auto [built, index] = pending.front();
+    pending.pop_front();
+
+    Node flat;
+    flat.labelOffset = static_cast<uint32_t>(labels.size());
+    flat.labelLength = static_cast<uint32_t>(built->label.size());
+    labels.append(built->label);
+    flat.route = built->route;
+    flat.firstChild = static_cast<uint32_t>(nodes.size());
+    flat.childCount = static_cast<uint32_t>(built->children.size());
+    for(const std::unique_ptr<BuildNode> &child : built->children) {
+      pending.emplace_back(child.get(), static_cast<uint32_t>(nodes.size()));
+      nodes.emplace_back();
+    }
+    if(built->parameterChild) {
+      flat.parameterChild = static_cast<uint32_t>(nodes.size());
+      pending.emplace_back(built->parameterChild.get(), flat.parameterChild);
+      nodes.emplace_back();
+    }
+    nodes[index] = flat;
+  }
+}
+
+uint64_t RouteTree::hashPath(std::string_view path, uint64_t seed) {
+  uint64_t hash = seed ^ (path.size() * 0x9E3779B97F4A7C15ull);
+  const char *data = path.data();
+  size_t left = path.size();
+  // Eight bytes per multiplication, paths are short and this runs on every request.
+  for(; left >= 8; data += 8, left -= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    hash = (hash ^ word) * 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 31;
+  }
+  if(left > 0) {
+    uint64_t word = 0;
+    for(size_t i = 0; i < left; i++)
+      word |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    hash = (hash ^ word) * 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 31;
+  }
+  hash *= 0x94D049BB133111EBull;
+  return hash ^ (hash >> 32);
+}
+
+void RouteTree::freeze() {
+  if(isFrozen)
+    return;
+  if(stale)
+    flatten();
+
+  std::vector<std::pair<std::string_view, uint32_t>> keys;
+  for(const auto &[shape, route] : shapes) {
+    if(shape.find("/:") == std::string::npos)
+      keys.emplace_back(shape, route);
+  }
+
+  // Hash and displace: keys are grouped into buckets, and the largest buckets first get the smallest
+  // displacement that puts all of their keys into slots still free. Two keys per bucket on average keep
+  // the search short, a seed that leaves some bucket without a displacement is replaced.
+  const size_t slots = keys.size();
+  const size_t buckets = std::max<size_t>(1, (slots + 1) / 2);
+  const uint32_t MAX_DISPLACEMENT = 1u << 20;
+  for(uint64_t seed = 0x5EED; slots > 0 && seed < 0x5EED + 64; seed++) {
+    std::vector<uint64_t> hashes(slots);
+    std::vector<std::vector<size_t>> members(buckets);
+    for(size_t i = 0; i < slots; i++) {
+      hashes[i] = hashPath(keys[i].first, seed);
+      members[reduce(static_cast<uint32_t>(hashes[i] >> 32), buckets)].push_back(i);
+    }
+    std::vector<size_t> order(buckets);
+    for(size_t i = 0; i < buckets; i++)
+      order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return members[a].size() > members[b].size(); });
+
+    std::vector<uint32_t> displacements(buckets, 0);
+    std::vector<bool> taken(slots, false);
+    std::vector<uint32_t> candidate;
+    bool complete = true;
+    for(size_t bucket : order) {
+      if(members[bucket].empty())
+        break;
+      bool placed = false;
+      for(uint32_t displacement = 0; displacement < MAX_DISPLACEMENT && !placed; displacement++) {
+        candidate.clear();
+        placed = true;
+        for(size_t key : members[bucket]) {
+          uint32_t slot = staticSlot(hashes[key], displacement, slots);
+          if(taken[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+            placed = false;
+            break;
+          }
+          candidate.push_back(slot);
+        }
+        if(placed) {
+          for(uint32_t slot : candidate)
+            taken[slot] = true;
+          displacements[bucket] = displacement;
+        }
+      }
+      if(!placed) {
+        complete = false;
+        break;
+      }
+    }
+    if(!complete)
+      continue;
+
+    staticSeed = seed;
+    staticDisplacements = std::move(displacements);
+    staticSlots.assign(slots, StaticSlot());
+    staticKeys.clear();
+    for(size_t i = 0; i < slots; i++) {
+      StaticSlot &slot = staticSlots[staticSlot(hashes[i], staticDisplacements[reduce(static_cast<uint32_t>(hashes[i] >> 32), buckets)], slots)];
+      slot.keyOffset = static_cast<uint32_t>(staticKeys.size());
+      slot.keyLength = static_cast<uint32_t>(keys[i].first.size());
+      slot.route = keys[i].second;
+      staticKeys.append(keys[i].first);
+    }
+    isFrozen = true;
+    return;
+  }
+  if(slots > 0)
+    throw std::runtime_error("Could not build the static route table");
+  isFrozen = true;
+}
+
+uint32_t RouteTree::findStatic(std::string_view path) const {
+  uint64_t hash = hashPath(path, staticSeed);
+  uint32_t bucket = reduce(static_cast<uint32_t>(hash >> 32), staticDisplacements.size());
+  const StaticSlot &slot = staticSlots[staticSlot(hash, staticDisplacements[bucket], staticSlots.size())];
+  if(std::string_view(staticKeys.data() + slot.keyOffset, slot.keyLength) != path)
+    return NO_ROUTE;
+  return slot.route;
+}
+
+bool RouteTree::match(std::string_view path, Match &match) const {
+  match.route = NO_ROUTE;
+  match.parameterCount = 0;
+  if(stale)
+    flatten();
+  // Paths spelled like a static pattern skip the tree, everything else, also "/health/", takes the walk.
+  if(!staticSlots.empty()) {
+    uint32_t route = findStatic(path);
+    if(route != NO_ROUTE) {
+      match.route = route;
+      return true;
+    }
+  }
+  return matchBelow(nodes[0], path, 0, match);
+}
+
+bool RouteTree::matchLiteral(const Node &node, std::string_view path, size_t position, Match &match) const {
+  const char *label = labels.data() + node.labelOffset;
+  for(uint32_t i = 0; i < node.labelLength; i++) {
+    if(position == path.size() || path[position] != label[i])
+      return false;
+    position++;
+    if(label[i] == '/') {
+      while(position < path.size() && path[position] == '/')
+        position++;
+    }
+  }
+  return matchBelow(node, path, position, match);
+}
+
+bool RouteTree::matchBelow(const Node &node, std::string_view path, size_t position, Match &match) const {
+  if(position < path.size()) {
+    char next = path[position];
+    // Literal edges leaving a node start with distinct characters, at most one of them can match.
+    for(uint32_t i = 0; i < node.childCount; i++) {
+      const Node &child = nodes[node.firstChild + i];
+      if(labels[child.labelOffset] == next) {
+        if(matchLiteral(child, path, position, match))
+          return true;
+        break;
+      }
+    }
+
+    if(node.parameterChild != NO_NODE && next != '/') {
+      size_t end = path.find('/', position);
+      if(end == std::string_view::npos)
+        end = path.size();
+      size_t parameter = match.parameterCount++;
+      match.parameters[parameter] = path.substr(position, end - position);
+      if(matchBelow(nodes[node.parameterChild], path, end, match))
+        return true;
+      match.parameterCount = parameter;
+    }
+
+    if(path.find_first_not_of('/', position) != std::string_view::npos)
+      return false;
+  }
+
+  if(node.route == NO_ROUTE)
+    return false;
+  match.route = node.route;
+  return true;
+}
@@ -0,0 +1,529 @@
+#include <thread>
+#include <algorithm>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+
+#include "httpserver.h"
+
+static const uint32_t CONNECTION_EVENTS = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+
+HttpServer::ReactorResponse HttpServer::makeReactorResponse(const RequestPackage &task, Response &res,
+                                                            bool terminate_socket) {
+  std::string head, body;
+  std::shared_ptr<const FileCache::File> file;
+  if(!res.getIsFileResponse()) {
+    head = makeHttpResponseHeader(res, res.announcedLength(res.getPayload().size()));
+    // Copying a small body is cheaper than giving it a send segment of its own.
+    if(!res.isHeadResponse()) {
+      if(res.getPayload().size() <= INLINE_BODY_SIZE)
+        head.append(res.getPayload());
+      else
+        body = res.takePayload();
+    }
+  } else if(!(file = fileCache.open(res.getFilePath()))) {
+    Response errorRes;
+    errorRes.headResponse = res.headResponse;
+    errorRes.status(404).send("File Not Found");
+    head = makeHttpResponse(errorRes);
+  } else {
+    // A HEAD response announces the size of the file without sending it.
+    head = makeHttpResponseHeader(res, res.announcedLength(file->size));
+    if(file->size == 0 || res.isHeadResponse())
+      file.reset();
+  }
+  return {task.socket, task.connectionId, task.sequence, std::move(head), std::move(body), std::move(file),
+          terminate_socket};
+}
+
+void HttpServer::dispatchResponse(const RequestPackage &task, Response &res, bool terminate_socket) {
+  ReactorResponse response = makeReactorResponse(task, res, terminate_socket);
+  Reactor &reactor = *reactors[task.reactor];
+  {
+    std::lock_guard<std::mutex> lock(reactor.completedMutex);
+    reactor.completed.push_back(std::move(response));
+  }
+  uint64_t signal = 1;
+  [[maybe_unused]] ssize_t written = write(reactor.eventFd, &signal, sizeof(signal));
+}
+
+void HttpServer::closeConnection(Reactor &reactor, SOCKET socket) {
+#ifdef BOLTPP_IO_URING
+  if(reactor.ring) {
+    if(Connection *connection = reactor.connections.find(socket))
+      closeUringConnection(reactor, *connection);
+    return;
+  }
+#endif
+  epoll_ctl(reactor.epollFd, EPOLL_CTL_DEL, socket, nullptr);
+  closesocket(socket);
+  if(Connection *connection = reactor.connections.find(socket))
+    eraseConnection(reactor, *connection);
+}
+
+void HttpServer::parkBuffers(Reactor &reactor, Connection &connection) {
+  if(connection.buffer.empty())
+    reactor.inputBuffers.release(connection.buffer);
+  if(connection.outgoing.empty() && !connection.writeInFlight) {
+    reactor.outputBuffers.release(connection.outgoing.chunks);
+#ifdef BOLTPP_IO_URING
+    reactor.segmentBuffers.release(connection.sendSegments);
+#endif
+  }
+}
+
+void HttpServer::eraseConnection(Reactor &reactor, Connection &connection) {
+  connection.buffer.clear();
+  connection.outgoing.chunks.clear();
+  connection.outgoing.head = 0;
+  connection.outgoing.bufferedBytes = 0;
+  connection.writeInFlight = false;
+  parkBuffers(reactor, connection);
+  reactor.connections.erase(connection.socket);
+}
+
+bool HttpServer::flushConnection(Reactor &reactor, Connection &connection) {
+#ifdef BOLTPP_IO_URING
+  if(reactor.ring)
+    return submitUringSend(reactor, connection);
+#endif
+  while(!connection.outgoing.empty()) {
+    OutgoingChunk &chunk = connection.outgoing.front();
+    ssize_t sent;
+    if(chunk.file) {
+      off_t offset = static_cast<off_t>(chunk.offset);
+      sent = sendfile(connection.socket, chunk.file->fd, &offset, chunk.size() - chunk.offset);
+      // The file shrank after its Content-Length went out, the response can no longer be completed.
+      if(sent == 0) {
+        closeConnection(reactor, connection.socket);
+        return false;
+      }
+    } else {
+      iovec segments[MAX_SEND_SEGMENTS];
+      msghdr message{};
+      message.msg_iov = segments;
+      message.msg_iovlen = gatherOutgoing(connection, segments, false);
+      sent = sendmsg(connection.socket, &message, SEND_FLAGS);
+    }
+    if(sent > 0) {
+      consumeOutgoing(connection, sent);
+      continue;
+    }
+    if(sent < 0 && errno == EINTR)
+      continue;
+    if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return true;  // EPOLLOUT resumes the write once the socket drains.
+    closeConnection(reactor, connection.socket);
+    return false;
+  }
+  return finishWrite(reactor, connection);
+}
+
+bool HttpServer::finishWrite(Reactor &reactor, Connection &connection) {
+  if(connection.lastOutput()) {
+    closeConnection(reactor, connection.socket);
+    return false;
+  }
+  if(!dispatchBufferedRequest(reactor, connection))
+    return false;
+  if(connection.readPaused && !connection.dispatchBlocked())
+    resumeReading(reactor, connection);
+  return true;
+}
+
+void HttpServer::pauseReading([[maybe_unused]] Reactor &reactor, Connection &connection) {
+  connection.readPaused = true;
+#ifdef BOLTPP_IO_URING
+  if(reactor.ring)
+    cancelUringRecv(reactor, connection);
+#endif
+}
+
+void HttpServer::resumeReading(Reactor &reactor, Connection &connection) {
+  connection.readPaused = false;
+#ifdef BOLTPP_IO_URING
+  if(reactor.ring)
+    return submitUringRecv(reactor, connection);
+#endif
+  // Modifying an edge-triggered registration reports input that is already waiting as a new event.
+  epoll_event event{};
+  event.events = CONNECTION_EVENTS;
+  event.data.fd = connection.socket;
+  epoll_ctl(reactor.epollFd, EPOLL_CTL_MOD, connection.socket, &event);
+}
+
+void HttpServer::appendOutgoing(Connection &connection, std::string &&data) {
+  if(!data.empty())
+    connection.outgoing.push_back(OutgoingChunk{std::move(data), nullptr, 0});
+}
+
+size_t HttpServer::gatherOutgoing(const Connection &connection, iovec *segments, bool withFiles) {
+  size_t count = 0;
+  for(const OutgoingChunk &chunk : connection.outgoing) {
+    if(count == MAX_SEND_SEGMENTS || (chunk.file && (!withFiles || !chunk.file->mapping)))
+      break;
+    const char *data = chunk.file ? chunk.file->mapping : chunk.data.data();
+    segments[count].iov_base = const_cast<char*>(data + chunk.offset);
+    segments[count].iov_len = chunk.size() - chunk.offset;
+    count++;
+  }
+  return count;
+}
+
+void HttpServer::consumeOutgoing(Connection &connection, size_t written) {
+  while(written > 0) {
+    OutgoingChunk &chunk = connection.outgoing.front();
+    size_t remaining = chunk.size() - chunk.offset;
+    if(written < remaining) {
+      connection.outgoing.advance(written);
+      return;
+    }
+    written -= remaining;
+    connection.outgoing.pop_front();
+  }
+}
+
+void HttpServer::collectOrderedResponses(Reactor &reactor, Connection &connection) {
+  auto it = connection.reordered.begin();
+  if(it != connection.reordered.end() && it->first == connection.nextToWrite)
+    reactor.outputBuffers.acquire(connection.outgoing.chunks);
+  while(!connection.closeAfterWrite && it != connection.reordered.end() && it->first == connection.nextToWrite) {
+    appendOutgoing(connection, std::move(it->second.head));
+    appendOutgoing(connection, std::move(it->second.body));
+    if(it->second.file)
+      connection.outgoing.push_back(OutgoingChunk{{}, std::move(it->second.file), 0});
+    connection.closeAfterWrite = it->second.terminate_socket;
+    connection.nextToWrite++;
+    it = connection.reordered.erase(it);
+  }
+  // Nothing after a closing response is ever written.
+  if(connection.closeAfterWrite) {
+    connection.noMoreRequests = true;
+    connection.reordered.clear();
+  }
+}
+
+bool HttpServer::dispatchBufferedRequest(Reactor &reactor, Connection &connection) {
+  if(connection.noMoreRequests || connection.closing)
+    return true;
+
+  size_t consumed = 0;
+  bool answered = false;
+  RequestParser::Status status = RequestParser::Status::Incomplete;
+  while(!connection.dispatchBlocked()) {
+    status = connection.parser.parse(std::string_view(connection.buffer).substr(consumed), MAX_HEADER_SIZE, MAX_BODY_SIZE);
+    if(status != RequestParser::Status::Complete)
+      break;
+
+    std::unique_ptr<RequestPackage> task = connection.parser.takeRequest();
+    task->socket = connection.socket;
+    task->reactor = reactor.index;
+    task->connectionId = connection.id;
+    task->sequence = connection.nextSequence++;
+    consumed += connection.parser.consumed();
+    connection.noMoreRequests = connection.parser.closeRequested();
+    connection.parser.reset();
+
+    bool handled = false;
+    if(runToCompletion) {
+      EpochDomain::Section section(*reactor.routeReader);
+      Routing routing = findRoute(*routeTable.load(std::memory_order_seq_cst), task->request);
+      if(!routing.route || !routing.route->blocking) {
+        // Answered on this thread, the response is ordered right away and frees its pipeline slot.
+        Response res(task->arena.resource());
+        bool terminate_socket = handleRequest(task->request, res, routing);
+        connection.reordered.emplace(task->sequence, makeReactorResponse(*task, res, terminate_socket));
+        handled = true;
+      }
+    }
+    if(handled) {
+      collectOrderedResponses(reactor, connection);
+      answered = true;
+    } else {
+      // The worker routes the request again, the route may be gone once the read section ended.
+      submitRequest(std::move(task));
+    }
+    if(connection.noMoreRequests)
+      break;
+  }
+  connection.buffer.erase(0, consumed);
+
+  if(status == RequestParser::Status::Error) {
+    // The error answer takes its place behind the responses of the requests before it.
+    Response res;
+    res.setProtocol("HTTP/1.1").status(connection.parser.errorStatus()).setHeader(HttpHeader::Connection, "close");
+    ReactorResponse error{connection.socket, connection.id, connection.nextSequence,
+                          makeHttpResponse(makeErrorResponse(res)), {}, nullptr, true};
+    connection.reordered.emplace(connection.nextSequence++, std::move(error));
+    connection.buffer.clear();
+    connection.noMoreRequests = true;
+    collectOrderedResponses(reactor, connection);
+    return flushConnection(reactor, connection);
+  }
+
+  if(connection.noMoreRequests)
+    connection.buffer.clear();
+  else if(status == RequestParser::Status::Incomplete && connection.peerClosed && !connection.dispatchBlocked())
+    connection.noMoreRequests = true;
+
+  if(answered)
+    return flushConnection(reactor, connection);
+
+  if(connection.lastOutput() && connection.outgoing.empty() && !connection.writeInFlight) {
+    closeConnection(reactor, connection.socket);
+    return false;
+  }
+  parkBuffers(reactor, connection);
+  return true;
+}
+
+bool HttpServer::readConnection(Reactor &reactor, Connection &connection) {
+  char buffer[BUFFER_SIZE];
+  while(!connection.peerClosed) {
+    // Past the cap only dispatching makes room. A connection that cannot dispatch leaves its input in the socket,
+    // so a client that never reads its responses stalls instead of growing the buffers, until finishWrite resumes.
+    if(connection.buffer.size() >= MAX_BUFFERED_INPUT) {
+      if(!dispatchBufferedRequest(reactor, connection))
+        return false;
+      if(connection.buffer.size() >= MAX_BUFFERED_INPUT && connection.dispatchBlocked()) {
+        pauseReading(reactor, connection);
+        return true;
+      }
+    }
+    ssize_t received = recv(connection.socket, buffer, BUFFER_SIZE, 0);
+    if(received > 0) {
+      // Nothing behind a request that ends the connection is processed, its bytes are dropped.
+      if(!connection.noMoreRequests) {
+        reactor.inputBuffers.acquire(connection.buffer);
+        connection.buffer.append(buffer, received);
+      }
+      continue;
+    }
+    if(received == 0) {
+      connection.peerClosed = true;
+      break;
+    }
+    if(errno == EINTR)
+      continue;
+    if(errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    closeConnection(reactor, connection.socket);
+    return false;
+  }
+  return dispatchBufferedRequest(reactor, connection);
+}
+
+void HttpServer::drainCompletedResponses(Reactor &reactor) {
+  std::vector<ReactorResponse> completed;
+  {
+    std::lock_guard<std::mutex> lock(reactor.completedMutex);
+    completed.swap(reactor.completed);
+  }
+
+  // Order everything first, so a connection whose responses arrived together is written with one send.
+  std::vector<std::pair<SOCKET, unsigned long long>> touched;
+  for(ReactorResponse &response : completed) {
+    Connection *found = reactor.connections.find(response.socket);
+    if(!found || found->id != response.connectionId || found->closeAfterWrite)
+      continue;
+    Connection &connection = *found;
+    connection.reordered.emplace(response.sequence, std::move(response));
+    collectOrderedResponses(reactor, connection);
+    if(touched.empty() || touched.back().first != connection.socket)
+      touched.emplace_back(connection.socket, connection.id);
+  }
+
+  for(const std::pair<SOCKET, unsigned long long> &entry : touched) {
+    Connection *connection = reactor.connections.find(entry.first);
+    if(!connection || connection->id != entry.second)
+      continue;
+    flushConnection(reactor, *connection);
+  }
+}
+
+void HttpServer::acceptConnections(Reactor &reactor) {
+  while(true) {
+    SOCKET clientSocket = accept4(reactor.listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(clientSocket == INVALID_SOCKET) {
+      if(errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return;
+    }
+
+    int noDelay = 1;
+    setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    epoll_event event{};
+    event.events = CONNECTION_EVENTS;
+    event.data.fd = clientSocket;
+    if(epoll_ctl(reactor.epollFd, EPOLL_CTL_ADD, clientSocket, &event) == -1) {
+      closesocket(clientSocket);
+      continue;
+    }
+
+    Connection &connection = reactor.connections.emplace(clientSocket);
+    connection.socket = clientSocket;
+    connection.id = reactor.nextConnectionId++;
+  }
+}
+
+void HttpServer::pinToCore(unsigned int index) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+    return;
+  // Counts through the cores this process may use, so a restricted cpuset still gets one reactor per core.
+  unsigned int target = index % CPU_COUNT(&allowed);
+  for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if(!CPU_ISSET(cpu, &allowed) || target-- != 0)
+      continue;
+    cpu_set_t pinned;
+    CPU_ZERO(&pinned);
+    CPU_SET(cpu, &pinned);
+    pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+    return;
+  }
+}
+
+void HttpServer::reactorThreadFunction(Reactor &reactor) {
+  if(runToCompletion)
+    pinToCore(reactor.index);
+#ifdef BOLTPP_IO_URING
+  if(reactor.ring)
+    return uringReactorThreadFunction(reactor);
+#endif
+  static const int MAX_EVENTS = 256;
+  epoll_event events[MAX_EVENTS];
+  while(true) {
+    int ready = epoll_wait(reactor.epollFd, events, MAX_EVENTS, -1);
+    for(int i = 0; i < ready; i++) {
+      int fd = events[i].data.fd;
+      uint32_t flags = events[i].events;
+
+      if(fd == reactor.listenSocket) {
+        acceptConnections(reactor);
+        continue;
+      }
+      if(fd == reactor.eventFd) {
+        uint64_t signals;
+        [[maybe_unused]] ssize_t readBytes = read(reactor.eventFd, &signals, sizeof(signals));
+        drainCompletedResponses(reactor);
+        continue;
+      }
+
+      Connection *found = reactor.connections.find(fd);
+      if(!found)
+        continue;
+      Connection &connection = *found;
+
+      if(flags & EPOLLERR) {
+        closeConnection(reactor, fd);
+        continue;
+      }
+      if((flags & EPOLLOUT) && !flushConnection(reactor, connection))
+        continue;
+      if(flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+        readConnection(reactor, connection);
+    }
+  }
+}
+
+void HttpServer::openReactor(Reactor &reactor, int port, int addressFamily, int type, int protocol) {
+  // io_uring polls on its own, a non-blocking descriptor would make it fail with EAGAIN instead.
+  int nonBlocking = ioEngine == IoEngine::Epoll ? SOCK_NONBLOCK : 0;
+
+  reactor.listenSocket = socket(addressFamily, type | nonBlocking | SOCK_CLOEXEC, protocol);
+  if(reactor.listenSocket == INVALID_SOCKET)
+    throw std::runtime_error(std::string("Error in socket ") + std::to_string(errno));
+
+  int enable = 1;
+  setsockopt(reactor.listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  if(setsockopt(reactor.listenSocket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == SOCKET_ERROR)
+    throw std::runtime_error(std::string("Error in SO_REUSEPORT ") + std::to_string(errno));
+
+  sockaddr_in serverAddr{};
+  serverAddr.sin_family = addressFamily;
+  serverAddr.sin_addr.s_addr = INADDR_ANY;
+  serverAddr.sin_port = htons(port);
+
+  if(bind(reactor.listenSocket, (const sockaddr *)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR)
+    throw std::runtime_error(std::string("Error in binding ") + std::to_string(errno));
+
+  if(listen(reactor.listenSocket, SOMAXCONN) == SOCKET_ERROR)
+    throw std::runtime_error(std::string("Error in listening ") + std::to_string(errno));
+
+  reactor.eventFd = eventfd(0, (nonBlocking ? EFD_NONBLOCK : 0) | EFD_CLOEXEC);
+  if(reactor.eventFd == -1)
+    throw std::runtime_error(std::string("Error in eventfd ") + std::to_string(errno));
+
+  if(ioEngine == IoEngine::IoUring) {
+#ifdef BOLTPP_IO_URING
+    reactor.ring = std::make_unique<IoUring>(URING_ENTRIES);
+    reactor.ring->registerBufferRing(URING_BUFFER_COUNT, URING_BUFFER_SIZE, 0);
+    return;
+#else
+    throw std::runtime_error("io_uring engine requested but Boltpp was built without BOLTPP_IO_URING");
+#endif
+  }
+
+  reactor.epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if(reactor.epollFd == -1)
+    throw std::runtime_error(std::string("Error in epoll_create1 ") + std::to_string(errno));
+
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLET;
+  event.data.fd = reactor.listenSocket;
+  if(epoll_ctl(reactor.epollFd, EPOLL_CTL_ADD, reactor.listenSocket, &event) == -1)
+    throw std::runtime_error(std::string("Error in epoll_ctl ") + std::to_string(errno));
+
+  event.events = EPOLLIN;
+  event.data.fd = reactor.eventFd;
+  if(epoll_ctl(reactor.epollFd, EPOLL_CTL_ADD, reactor.eventFd, &event) == -1)
+    throw std::runtime_error(std::string("Error in epoll_ctl ") + std::to_string(errno));
+}
+
+void HttpServer::initServer(int port, std::function<void()> callback, int addressFamily, int type, int protocol) {
+  freeze();
+  unsigned int reactorCount = REACTOR_THREADS;
+  if(reactorCount == 0)
+    reactorCount = std::max(1u, std::thread::hardware_concurrency());
+
+  for(unsigned int i = 0; i < reactorCount; i++) {
+    reactors.push_back(std::make_unique<Reactor>());
+    reactors.back()->index = i;
+    reactors.back()->routeReader = &routeEpochs.registerReader();
+    openReactor(*reactors.back(), port, addressFamily, type, protocol);
+  }
+
+  serverSocket = reactors.front()->listenSocket;
+  // io_uring has no sendfile, its reactors send file bodies from a mapping of the page cache instead.
+  fileCache.setMapContents(ioEngine == IoEngine::IoUring);
+
+  startWorkers();
+
+  for(size_t i = 1; i < reactors.size(); i++)
+    std::thread(&HttpServer::reactorThreadFunction, this, std::ref(*reactors[i])).detach();
+
+  callback();
+
+  reactorThreadFunction(*reactors.front());
+}
+
+HttpServer::~HttpServer() {
+  if(reactors.empty() && serverSocket != INVALID_SOCKET)
+    closesocket(serverSocket);
+  for(std::unique_ptr<Reactor> &reactor : reactors) {
+    reactor->connections.forEach([](size_t socket, Connection&) { closesocket(static_cast<SOCKET>(socket)); });
+    reactor->connections.clear();
+    if(reactor->listenSocket != INVALID_SOCKET) closesocket(reactor->listenSocket);
+    if(reactor->epollFd != -1) close(reactor->epollFd);
+    if(reactor->eventFd != -1) close(reactor->eventFd);
+  }
+  reactors.clear();
+  globalMiddlewares.clear();
+  pendingRoutes.reset();
+  delete routeTable.exchange(nullptr);
+}
@@ -0,0 +1,327 @@
+#include <thread>
+
+#include "httpserver.h"
+
+void HttpServer::dispatchResponse(const RequestPackage &task, Response &res, bool terminate_socket) {
+  SocketResponse outgoing{task.socket, res, terminate_socket, task.connectionId, task.sequence};
+  // The file is opened here, so the single dispatcher thread never waits on the file system.
+  if(res.getIsFileResponse() && !(outgoing.file = fileCache.open(res.getFilePath()))) {
+    Response errorRes;
+    errorRes.headResponse = res.headResponse;
+    errorRes.status(404).send("File Not Found");
+    outgoing.response = errorRes;
+  }
+  {
+    std::lock_guard<std::mutex> lock(outgoing_response_mutex);
+    outgoing_responses.push(std::move(outgoing));
+  }
+  outgoing_response_variable.notify_one();
+}
+
+bool HttpServer::writeSocketResponse(SocketResponse &outgoing_response, SocketOrder &order) {
+  Response &res = outgoing_response.response;
+  if(!outgoing_response.file) {
+    // Header block and payload go out as two buffers of one WSASend, the payload is never copied.
+    std::string headers = makeHttpResponseHeader(res, res.announcedLength(res.getPayload().size()));
+    WSABUF buffers[2];
+    buffers[0].buf = headers.data();
+    buffers[0].len = static_cast<ULONG>(headers.size());
+    buffers[1].buf = const_cast<char*>(res.getPayload().data());
+    buffers[1].len = static_cast<ULONG>(res.getPayload().size());
+    return sendBuffers(outgoing_response.socket, buffers, res.isHeadResponse() ? 1 : 2);
+  }
+
+  const FileCache::File &file = *outgoing_response.file;
+  std::string headers = makeHttpResponseHeader(res, res.announcedLength(file.size));
+  if(res.isHeadResponse()) {
+    WSABUF buffer{static_cast<ULONG>(headers.size()), headers.data()};
+    return sendBuffers(outgoing_response.socket, &buffer, 1);
+  }
+
+  // TransmitFile sends the header block and the file from the system cache in one call, without copying the
+  // body through user space. It runs overlapped, so a slow client never holds up the dispatcher, and starts at
+  // the offset of its OVERLAPPED instead of the file pointer shared by every response of the cached handle.
+  TransmitData *transmit = new TransmitData();
+  transmit->socket = outgoing_response.socket;
+  transmit->receiving = false;
+  transmit->connectionId = outgoing_response.connectionId;
+  transmit->headers = std::move(headers);
+  transmit->file = outgoing_response.file;
+  transmit->buffers.Head = transmit->headers.data();
+  transmit->buffers.HeadLength = static_cast<DWORD>(transmit->headers.size());
+  if(!TransmitFile(transmit->socket, file.handle, 0, 0, &transmit->overlapped, &transmit->buffers, TF_USE_KERNEL_APC) &&
+     WSAGetLastError() != WSA_IO_PENDING) {
+    delete transmit;
+    return false;
+  }
+  // Even a call that finished right away queues its completion on the port.
+  order.transmitting = true;
+  return true;
+}
+
+bool HttpServer::finishSocketResponse(SocketOrder &order, bool written) {
+  SocketResponse &response = order.reordered.begin()->second;
+  order.nextToWrite++;
+  if(!written || response.terminate_socket) {
+    shutdown(response.socket, SD_BOTH);
+    order.finished = true;
+    order.reordered.clear();
+    return false;
+  }
+  order.reordered.erase(order.reordered.begin());
+  return true;
+}
+
+bool HttpServer::sendBuffers(SOCKET socket, WSABUF *buffers, DWORD count) {
+  while(count > 0) {
+    DWORD sent = 0;
+    if(WSASend(socket, buffers, count, &sent, 0, nullptr, nullptr) == SOCKET_ERROR)
+      return false;
+    // Skip what a partial send already wrote and retry with the rest.
+    while(count > 0 && sent >= buffers->len) {
+      sent -= buffers->len;
+      buffers++;
+      count--;
+    }
+    if(count > 0) {
+      buffers->buf += sent;
+      buffers->len -= sent;
+    }
+  }
+  return true;
+}
+
+void HttpServer::responseDispatcherThread() {
+  // Owned by this thread only, entries are reset once a socket handle shows up with a newer connection id.
+  std::unordered_map<SOCKET, SocketOrder> socketOrders;
+  while(true) {
+    SocketResponse outgoing_response;
+    {
+      std::unique_lock<std::mutex> queue_lock(outgoing_response_mutex);
+      outgoing_response_variable.wait(queue_lock, [&]() { return !outgoing_responses.empty(); });
+      outgoing_response = outgoing_responses.front();
+      outgoing_responses.pop();
+    }
+    SocketOrder &order = socketOrders[outgoing_response.socket];
+    if(outgoing_response.connectionId < order.connectionId)
+      continue;
+    if(outgoing_response.connectionId > order.connectionId)
+      order = SocketOrder{outgoing_response.connectionId};
+
+    if(outgoing_response.transmitted) {
+      // The file response waited at the front of the order, what queued up behind it can go out now.
+      order.transmitting = false;
+      if(!finishSocketResponse(order, !outgoing_response.terminate_socket))
+        continue;
+    } else if(order.finished) {
+      // The receiver posts nothing after the end marker, so the handle can be released now.
+      if(outgoing_response.endOfConnection)
+        closesocket(outgoing_response.socket);
+      continue;
+    } else {
+      order.reordered.emplace(outgoing_response.sequence, std::move(outgoing_response));
+    }
+
+    auto it = order.reordered.begin();
+    while(!order.transmitting && it != order.reordered.end() && it->first == order.nextToWrite) {
+      SocketResponse &next = it->second;
+      if(next.endOfConnection) {
+        closesocket(next.socket);
+        order.finished = true;
+        order.reordered.clear();
+        break;
+      }
+      bool written = writeSocketResponse(next, order);
+      if(order.transmitting || !finishSocketResponse(order, written))
+        break;
+      it = order.reordered.begin();
+    }
+  }
+}
+
+void HttpServer::endConnection(PerIoData *ioData, SocketBuffer &socketBuffer) {
+  SocketResponse end{ioData->socket, Response(), true, socketBuffer.id, socketBuffer.nextSequence++, true};
+  {
+    std::lock_guard<std::mutex> lock(outgoing_response_mutex);
+    outgoing_responses.push(std::move(end));
+  }
+  outgoing_response_variable.notify_one();
+  socketBuffer.buffer.clear();
+  inputBuffers.release(socketBuffer.buffer);
+  socketBuffers.erase(ioData->slot);
+  receiveBuffers.release(ioData->buffer);
+  delete ioData;
+}
+
+void HttpServer::postReceive(PerIoData *ioData, bool idle) {
+  if(idle) {
+    receiveBuffers.release(ioData->buffer);
+  } else {
+    receiveBuffers.acquire(ioData->buffer);
+    ioData->buffer.resize(BUFFER_SIZE);
+  }
+  ioData->wsabuff.buf = ioData->buffer.data();
+  ioData->wsabuff.len = static_cast<ULONG>(ioData->buffer.size());
+  ioData->receiving = true;
+  DWORD flags = 0;
+  WSARecv(ioData->socket, &ioData->wsabuff, 1, nullptr, &flags, &ioData->overlapped, nullptr);
+}
+
+void HttpServer::receiverThreadFunction() {
+  while (true) {
+    DWORD bytesTransfered;
+    ULONG_PTR completionKey;
+    OVERLAPPED* overlapped;
+    BOOL result = GetQueuedCompletionStatus(iocp, &bytesTransfered, &completionKey, &overlapped, INFINITE);
+    PerIoData* ioData = reinterpret_cast<PerIoData*>(overlapped);
+    if (!ioData->receiving) {
+      // A TransmitFile of the dispatcher finished, it learns about it in order with the responses.
+      TransmitData *transmit = static_cast<TransmitData*>(ioData);
+      SocketResponse done{transmit->socket, Response(), !result, transmit->connectionId, 0, false, nullptr, true};
+      {
+        std::lock_guard<std::mutex> lock(outgoing_response_mutex);
+        outgoing_responses.push(std::move(done));
+      }
+      outgoing_response_variable.notify_one();
+      delete transmit;
+      continue;
+    }
+    if (ioData->slot == PerIoData::NO_SLOT) {
+      ioData->slot = socketBuffers.insert();
+      SocketBuffer &created = *socketBuffers.find(ioData->slot);
+      created.socket = ioData->socket;
+      created.id = nextConnectionId++;
+    }
+    SocketBuffer &socketBuffer = *socketBuffers.find(ioData->slot);
+    bool wasIdle = ioData->buffer.empty();
+
+    // Closing goes through the dispatcher, so it happens only after the responses already in flight.
+    if (!result || (bytesTransfered == 0 && !wasIdle)) {
+      endConnection(ioData, socketBuffer);
+      continue;
+    }
+    // A finished zero-byte read only says that data (or the end of the stream) is there, read it for real.
+    if (wasIdle || socketBuffer.noMoreRequests) {
+      postReceive(ioData, false);
+      continue;
+    }
+
+    inputBuffers.acquire(socketBuffer.buffer);
+    socketBuffer.buffer.append(ioData->buffer.data(), bytesTransfered);
+    size_t consumed = 0;
+    RequestParser::Status status;
+    while ((status = socketBuffer.parser.parse(std::string_view(socketBuffer.buffer).substr(consumed), MAX_HEADER_SIZE,
+                                               MAX_BODY_SIZE)) == RequestParser::Status::Complete) {
+      std::unique_ptr<RequestPackage> task = socketBuffer.parser.takeRequest();
+      task->socket = ioData->socket;
+      task->connectionId = socketBuffer.id;
+      task->sequence = socketBuffer.nextSequence++;
+      submitRequest(std::move(task));
+      consumed += socketBuffer.parser.consumed();
+      socketBuffer.noMoreRequests = socketBuffer.parser.closeRequested();
+      socketBuffer.parser.reset();
+      if (socketBuffer.noMoreRequests)
+        break;
+    }
+    socketBuffer.buffer.erase(0, consumed);
+
+    if (status == RequestParser::Status::Error) {
+      Response res;
+      res.setProtocol("HTTP/1.1").status(socketBuffer.parser.errorStatus()).setHeader(HttpHeader::Connection, "close");
+      {
+        std::lock_guard<std::mutex> lock(outgoing_response_mutex);
+        outgoing_responses.push({ ioData->socket, makeErrorResponse(res), true, socketBuffer.id, socketBuffer.nextSequence++ });
+      }
+      outgoing_response_variable.notify_one();
+      socketBuffer.noMoreRequests = true;
+    }
+    if (socketBuffer.noMoreRequests)
+      socketBuffer.buffer.clear();
+    if (socketBuffer.buffer.empty())
+      inputBuffers.release(socketBuffer.buffer);
+
+    // Keep reading while earlier requests are processed, a closing response shuts the socket down and ends this loop.
+    postReceive(ioData, socketBuffer.buffer.empty());
+  }
+}
+
+void HttpServer::serverListen() {
+  while(true) {
+    sockaddr_in clientAddr;
+    int addrlen = sizeof(clientAddr);
+    SOCKET clientSocket = accept(serverSocket, (sockaddr*)&clientAddr, &addrlen);
+    if(clientSocket == INVALID_SOCKET)
+      continue;
+    HANDLE result = CreateIoCompletionPort((HANDLE)clientSocket, iocp, (ULONG_PTR)clientSocket, 0);
+    if(result == INVALID_HANDLE_VALUE)
+      continue;
+    // New sockets start out idle, their zero-byte read holds no buffer until the first request arrives.
+    PerIoData* ioData = new PerIoData();
+    ioData->socket = clientSocket;
+    ioData->receiving = true;
+    DWORD flags = 0;
+    WSARecv(clientSocket, &ioData->wsabuff, 1, nullptr, &flags, &ioData->overlapped, nullptr);
+  }
+}
+
+void HttpServer::initServer(int port, std::function<void()> callback = []() {}, int addressFamily = AF_INET, int type = SOCK_STREAM, int protocol = IPPROTO_TCP) {
+  freeze();
+  WSADATA wsadata;
+  int result = WSAStartup(MAKEWORD(2, 2), &wsadata);
+  if(result != 0) {
+    throw std::runtime_error("DLL not found");
+  }
+
+  SOCKET initialSocket = socket(addressFamily, type, protocol);
+  if(initialSocket == INVALID_SOCKET) {
+    WSACleanup();
+    throw std::runtime_error(std::string("Error in socket ") + std::to_string(WSAGetLastError()));
+  }
+
+  sockaddr_in serverAddr;
+  serverAddr.sin_family = addressFamily;
+  serverAddr.sin_addr.s_addr = INADDR_ANY;
+  serverAddr.sin_port = htons(port);
+  int addrSize = sizeof(serverAddr);
+
+  result = bind(initialSocket, (const sockaddr *)&serverAddr, addrSize);
+  if(result == SOCKET_ERROR) {
+    closesocket(initialSocket);
+    WSACleanup();
+    throw std::runtime_error(std::string("Error in binding ") + std::to_string(WSAGetLastError()));
+  }
+
+  int listenResult = listen(initialSocket, 10);
+  if(listenResult == SOCKET_ERROR) {
+    closesocket(initialSocket);
+    WSACleanup();
+    throw std::runtime_error(std::string("Error in listening ") + std::to_string(WSAGetLastError()));
+  }
+
+  serverSocket = initialSocket;
+
+  iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+  if(!iocp) {
+    throw std::runtime_error("CreateIoCompletionPort failed");
+  }
+
+  startWorkers();
+  
+  std::thread(&HttpServer::responseDispatcherThread, this).detach();
+  
+  std::thread(&HttpServer::receiverThreadFunction, this).detach();
+
+  callback();
+
+  serverListen();
+}
+
+HttpServer::~HttpServer() {
+  closesocket(serverSocket);
+  socketBuffers.forEach([](size_t, SocketBuffer &socketBuffer) { closesocket(socketBuffer.socket); });
+  socketBuffers.clear();
+  globalMiddlewares.clear();
+  pendingRoutes.reset();
+  delete routeTable.exchange(nullptr);
+  WSACleanup();
+}
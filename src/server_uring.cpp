@@ -0,0 +1,240 @@
+#include <cstring>
+
+#include "httpserver.h"
+
+/**
+ * @brief Kind of operation a submission belongs to, stored in the top byte of its user_data.
+ */
+enum class UringOp : uint8_t {
+  Accept = 1,
+  Wakeup,
+  Recv,
+  Send,
+  SendThenClose,
+  Close,
+  Cancel
+};
+
+/**
+ * @brief Packs the operation, the socket and the low half of the connection id into a user_data value,
+ *        so completions for a closed connection are never applied to a new one that reused its fd.
+ */
+static uint64_t uringData(UringOp op, SOCKET socket = 0, unsigned long long connectionId = 0) {
+  return (static_cast<uint64_t>(op) << 56) | ((static_cast<uint64_t>(socket) & 0xffffff) << 32) |
+         (connectionId & 0xffffffff);
+}
+
+static inline UringOp uringOp(uint64_t userData) { return static_cast<UringOp>(userData >> 56); }
+static inline SOCKET uringSocket(uint64_t userData) { return static_cast<SOCKET>((userData >> 32) & 0xffffff); }
+static inline uint32_t uringConnectionId(uint64_t userData) { return static_cast<uint32_t>(userData); }
+
+static io_uring_sqe* nextSqe(IoUring &ring) {
+  io_uring_sqe *sqe;
+  while(!(sqe = ring.getSqe()))
+    ring.submit();
+  return sqe;
+}
+
+static void submitAccept(IoUring &ring, SOCKET listenSocket) {
+  io_uring_sqe *sqe = nextSqe(ring);
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = listenSocket;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  sqe->user_data = uringData(UringOp::Accept);
+}
+
+static void submitWakeupRead(IoUring &ring, int eventFd, uint64_t *value) {
+  io_uring_sqe *sqe = nextSqe(ring);
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = eventFd;
+  sqe->addr = reinterpret_cast<uint64_t>(value);
+  sqe->len = sizeof(*value);
+  sqe->user_data = uringData(UringOp::Wakeup);
+}
+
+static void submitCancel(IoUring &ring, uint64_t target) {
+  io_uring_sqe *sqe = nextSqe(ring);
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->addr = target;
+  sqe->user_data = uringData(UringOp::Cancel);
+}
+
+void HttpServer::submitUringRecv(Reactor &reactor, Connection &connection) {
+  io_uring_sqe *sqe = nextSqe(*reactor.ring);
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = connection.socket;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = 0;
+  sqe->user_data = uringData(UringOp::Recv, connection.socket, connection.id);
+}
+
+bool HttpServer::submitUringSend(Reactor &reactor, Connection &connection) {
+  if(connection.writeInFlight || connection.closing)
+    return true;
+  if(connection.outgoing.empty())
+    return finishWrite(reactor, connection);
+
+  IoUring &ring = *reactor.ring;
+  // The segments and message live on the connection, the kernel reads them until the send completes.
+  reactor.segmentBuffers.acquire(connection.sendSegments);
+  connection.sendSegments.resize(MAX_SEND_SEGMENTS);
+  connection.sendMessage = msghdr{};
+  connection.sendMessage.msg_iov = connection.sendSegments.data();
+  connection.sendMessage.msg_iovlen = gatherOutgoing(connection, connection.sendSegments.data(), true);
+  bool lastResponse = connection.lastOutput() && connection.sendMessage.msg_iovlen == connection.outgoing.size();
+  if(lastResponse) {
+    submitCancel(ring, uringData(UringOp::Recv, connection.socket, connection.id));
+    connection.closing = true;
+  }
+
+  io_uring_sqe *sqe = nextSqe(ring);
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = connection.socket;
+  sqe->addr = reinterpret_cast<uint64_t>(&connection.sendMessage);
+  sqe->len = 1;
+  sqe->msg_flags = SEND_FLAGS | MSG_WAITALL;
+  sqe->user_data = uringData(lastResponse ? UringOp::SendThenClose : UringOp::Send, connection.socket, connection.id);
+
+  // The final response carries its close along, a failed or short send breaks the link and cancels it.
+  if(lastResponse) {
+    sqe->flags |= IOSQE_IO_LINK;
+    io_uring_sqe *closeSqe = nextSqe(ring);
+    closeSqe->opcode = IORING_OP_CLOSE;
+    closeSqe->fd = connection.socket;
+    closeSqe->user_data = uringData(UringOp::Close, connection.socket, connection.id);
+  }
+
+  connection.writeInFlight = true;
+  return true;
+}
+
+void HttpServer::cancelUringRecv(Reactor &reactor, Connection &connection) {
+  submitCancel(*reactor.ring, uringData(UringOp::Recv, connection.socket, connection.id));
+}
+
+void HttpServer::closeUringConnection(Reactor &reactor, Connection &connection) {
+  if(connection.closing)
+    return;
+  connection.closing = true;
+  cancelUringRecv(reactor, connection);
+  // The kernel may still be reading outgoing, the connection is released once that send completes.
+  if(!connection.writeInFlight) {
+    closesocket(connection.socket);
+    eraseConnection(reactor, connection);
+  }
+}
+
+void HttpServer::handleUringCompletion(Reactor &reactor, uint64_t userData, int result, uint32_t flags) {
+  IoUring &ring = *reactor.ring;
+  UringOp op = uringOp(userData);
+
+  if(op == UringOp::Accept) {
+    if(result >= 0) {
+      int noDelay = 1;
+      setsockopt(result, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+      Connection &connection = reactor.connections.emplace(result);
+      connection.socket = result;
+      connection.id = reactor.nextConnectionId++;
+      submitUringRecv(reactor, connection);
+    }
+    if(!(flags & IORING_CQE_F_MORE))
+      submitAccept(ring, reactor.listenSocket);
+    return;
+  }
+
+  if(op == UringOp::Wakeup) {
+    drainCompletedResponses(reactor);
+    submitWakeupRead(ring, reactor.eventFd, &reactor.wakeupValue);
+    return;
+  }
+
+  if(op == UringOp::Cancel)
+    return;
+
+  SOCKET socket = uringSocket(userData);
+  Connection *connection = reactor.connections.find(socket);
+  if(connection && static_cast<uint32_t>(connection->id) != uringConnectionId(userData))
+    connection = nullptr;
+
+  switch(op) {
+    case UringOp::Recv: {
+      // Provided buffers go back to the ring no matter what happened to the connection.
+      if(flags & IORING_CQE_F_BUFFER) {
+        unsigned short bufferId = static_cast<unsigned short>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if(connection && !connection->closing && !connection->noMoreRequests && result > 0) {
+          reactor.inputBuffers.acquire(connection->buffer);
+          connection->buffer.append(ring.buffer(bufferId), result);
+        }
+        ring.recycleBuffer(bufferId);
+      }
+      if(!connection || connection->closing)
+        return;
+      if(result > 0) {
+        if(!(flags & IORING_CQE_F_MORE) && !connection->readPaused)
+          submitUringRecv(reactor, *connection);
+        if(!dispatchBufferedRequest(reactor, *connection))
+          return;
+        // The cancelled receive may still deliver what the kernel already holds, the rest stays in the socket.
+        if(!connection->readPaused && connection->buffer.size() >= MAX_BUFFERED_INPUT && connection->dispatchBlocked())
+          pauseReading(reactor, *connection);
+      } else if(result == 0) {
+        connection->peerClosed = true;
+        dispatchBufferedRequest(reactor, *connection);
+      } else if(result == -ENOBUFS) {
+        if(!connection->readPaused)
+          submitUringRecv(reactor, *connection);
+      } else if(result == -ECANCELED) {
+        // Reading was paused, finishWrite queues a new receive once the connection can dispatch again.
+      } else {
+        closeUringConnection(reactor, *connection);
+      }
+      return;
+    }
+    case UringOp::Send: {
+      if(!connection)
+        return;
+      connection->writeInFlight = false;
+      if(connection->closing) {
+        closesocket(connection->socket);
+        eraseConnection(reactor, *connection);
+        return;
+      }
+      if(result < 0) {
+        closeUringConnection(reactor, *connection);
+        return;
+      }
+      consumeOutgoing(*connection, result);
+      submitUringSend(reactor, *connection);
+      return;
+    }
+    case UringOp::SendThenClose: {
+      // The linked close completes next and releases the connection.
+      return;
+    }
+    case UringOp::Close: {
+      if(!connection)
+        return;
+      if(result == -ECANCELED)
+        closesocket(connection->socket);
+      eraseConnection(reactor, *connection);
+      return;
+    }
+    default:
+      return;
+  }
+}
+
+void HttpServer::uringReactorThreadFunction(Reactor &reactor) {
+  IoUring &ring = *reactor.ring;
+  submitAccept(ring, reactor.listenSocket);
+  submitWakeupRead(ring, reactor.eventFd, &reactor.wakeupValue);
+
+  while(true) {
+    ring.submit(1);
+    ring.forEachCompletion([&](const io_uring_cqe &cqe) {
+      handleUringCompletion(reactor, cqe.user_data, cqe.res, cqe.flags);
+    });
+  }
+}
@@ -0,0 +1,143 @@
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "uring.h"
+
+IoUring::IoUring(unsigned entries) {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+
+  ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+  if(ringFd < 0)
+    throw std::runtime_error(std::string("Error in io_uring_setup ") + std::to_string(errno));
+
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if(params.features & IORING_FEAT_SINGLE_MMAP)
+    sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+  sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  if(sqRing == MAP_FAILED) {
+    close(ringFd);
+    throw std::runtime_error(std::string("Error in mapping submission ring ") + std::to_string(errno));
+  }
+
+  if(params.features & IORING_FEAT_SINGLE_MMAP) {
+    cqRing = sqRing;
+  } else {
+    cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    if(cqRing == MAP_FAILED) {
+      munmap(sqRing, sqRingSize);
+      close(ringFd);
+      throw std::runtime_error(std::string("Error in mapping completion ring ") + std::to_string(errno));
+    }
+  }
+
+  sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqesMemory = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if(sqesMemory == MAP_FAILED) {
+    if(cqRing != sqRing) munmap(cqRing, cqRingSize);
+    munmap(sqRing, sqRingSize);
+    close(ringFd);
+    throw std::runtime_error(std::string("Error in mapping submission entries ") + std::to_string(errno));
+  }
+  sqes = static_cast<io_uring_sqe*>(sqesMemory);
+
+  char *sq = static_cast<char*>(sqRing);
+  sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sqEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+  sqeTail = sqeSubmitted = *sqTail;
+
+  char *cq = static_cast<char*>(cqRing);
+  cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+  if(bufferRing) {
+    io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    syscall(__NR_io_uring_register, ringFd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    munmap(bufferRing, bufferCount * sizeof(io_uring_buf));
+    delete[] bufferPool;
+  }
+  munmap(sqes, sqesSize);
+  if(cqRing != sqRing) munmap(cqRing, cqRingSize);
+  munmap(sqRing, sqRingSize);
+  close(ringFd);
+}
+
+io_uring_sqe* IoUring::getSqe() {
+  unsigned head = std::atomic_ref<unsigned>(*sqHead).load(std::memory_order_acquire);
+  if(sqeTail - head >= sqEntries) {
+    submit();
+    head = std::atomic_ref<unsigned>(*sqHead).load(std::memory_order_acquire);
+    if(sqeTail - head >= sqEntries)
+      return nullptr;
+  }
+  unsigned index = sqeTail & sqMask;
+  io_uring_sqe *sqe = &sqes[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqArray[index] = index;
+  sqeTail++;
+  return sqe;
+}
+
+int IoUring::submit(unsigned waitFor) {
+  unsigned toSubmit = sqeTail - sqeSubmitted;
+  std::atomic_ref<unsigned>(*sqTail).store(sqeTail, std::memory_order_release);
+  sqeSubmitted = sqeTail;
+  if(toSubmit == 0 && waitFor == 0)
+    return 0;
+  unsigned flags = waitFor ? IORING_ENTER_GETEVENTS : 0;
+  return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, waitFor, flags, nullptr, 0));
+}
+
+void IoUring::registerBufferRing(unsigned count, unsigned size, unsigned short groupId) {
+  size_t ringBytes = count * sizeof(io_uring_buf);
+  void *ringMemory = mmap(nullptr, ringBytes, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  if(ringMemory == MAP_FAILED)
+    throw std::runtime_error(std::string("Error in mapping buffer ring ") + std::to_string(errno));
+
+  io_uring_buf_reg reg;
+  std::memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(ringMemory);
+  reg.ring_entries = count;
+  reg.bgid = groupId;
+  if(syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    int error = errno;
+    munmap(ringMemory, ringBytes);
+    throw std::runtime_error(std::string("Error in registering buffer ring ") + std::to_string(error));
+  }
+
+  bufferRing = static_cast<io_uring_buf_ring*>(ringMemory);
+  bufferPool = new char[static_cast<size_t>(count) * size];
+  bufferCount = count;
+  bufferSize = size;
+  bufferTail = 0;
+  for(unsigned i = 0; i < count; i++)
+    recycleBuffer(static_cast<unsigned short>(i));
+}
+
+void IoUring::recycleBuffer(unsigned short bufferId) {
+  // Index the ring as a plain array: in C++ the kernel's flexible array member sits behind an empty
+  // struct of size 1, so &bufferRing->bufs[i] would be off by one alignment unit.
+  io_uring_buf *buf = reinterpret_cast<io_uring_buf*>(bufferRing) + (bufferTail & (bufferCount - 1));
+  buf->addr = reinterpret_cast<uint64_t>(buffer(bufferId));
+  buf->len = bufferSize;
+  buf->bid = bufferId;
+  bufferTail++;
+  std::atomic_ref<unsigned short>(bufferRing->tail).store(bufferTail, std::memory_order_release);
+}
@@ -1,11 +1,27 @@
+#include <cctype>
+
 #include "utils.h"
 
 std::string trim(std::string_view view) {
+  return std::string(trimView(view));
+}
+
+std::string_view trimView(std::string_view view) {
   size_t start = 0;
-  while (start < view.size() && std::isspace(view[start])) ++start;
+  while (start < view.size() && std::isspace(static_cast<unsigned char>(view[start]))) ++start;
   size_t end = view.size();
-  while (end > start && std::isspace(view[end - 1])) --end;
-  return std::string(view.substr(start, end - start));
+  while (end > start && std::isspace(static_cast<unsigned char>(view[end - 1]))) --end;
+  return view.substr(start, end - start);
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+      return false;
+  }
+  return true;
 }
 
 std::vector<std::string> split(const std::string_view str, const char delim) {
@@ -0,0 +1,148 @@
+// Checks how the server answers exceptions escaping handlers. An invalid body read through Request::json()
+// has to come back as 400 Bad Request, any other exception as 500 Internal Server Error, and neither may keep
+// headers, body or file the handler set before it threw. Every request is sent on one connection, which has
+// to keep working afterwards. The server runs in-process with one reactor and one worker.
+//
+// Ends with status 1 and a message naming the first failed check.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "httpserver.h"
+
+static const int PORT = 18091;
+
+struct Reply {
+  int status = 0;
+  std::string headers;  ///< Header block without the status line.
+  std::string body;
+};
+
+static void fail(const char *check, const Reply &reply) {
+  std::fprintf(stderr, "%s\nstatus %d\r\n%s\r\n\r\n%.200s\n", check, reply.status, reply.headers.c_str(),
+               reply.body.c_str());
+  std::exit(1);
+}
+
+static void startServer(const std::string &filePath) {
+  std::thread([filePath]() {
+    HttpServer server;
+    server.setReactorThreads(1);
+    server.setWorkerThreads(1);
+    server.Post("/orders", [](Request &req, Response &res) {
+      res.status(201).send("customer " + std::to_string(req.json()["customer"]["id"].asDouble()));
+    });
+    server.Get("/json", [](Request &, Response &res) {
+      res.setHeader("X-Partial", "yes");
+      res.status(202).json(JSONValue(JSONValue::Object()));
+      throw std::runtime_error("after json()");
+    });
+    server.Get("/file", [filePath](Request &, Response &res) {
+      res.sendFile(filePath);
+      throw std::runtime_error("after sendFile()");
+    });
+    server.Get("/ok", [](Request &, Response &res) { res.send("ok"); });
+    server.initServer(PORT);
+  }).detach();
+}
+
+static int connectToServer() {
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(PORT);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for(int attempt = 0; attempt < 200; attempt++) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+      return fd;
+    close(fd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::fprintf(stderr, "cannot connect to the server\n");
+  std::exit(1);
+}
+
+// Sends request and reads its response, framed by Content-Length unless it answers HEAD. A closed connection
+// fails the test.
+static Reply roundTrip(int fd, const std::string &request, bool head = false) {
+  send(fd, request.data(), request.size(), 0);
+  std::string buffer;
+  char chunk[4096];
+  while(true) {
+    size_t headerEnd = buffer.find("\r\n\r\n");
+    if(headerEnd != std::string::npos) {
+      size_t field = buffer.find("Content-Length: ");
+      size_t length = !head && field < headerEnd ? std::strtoull(buffer.c_str() + field + 16, nullptr, 10) : 0;
+      if(buffer.size() >= headerEnd + 4 + length) {
+        size_t statusEnd = buffer.find("\r\n");
+        return {std::atoi(buffer.c_str() + 9), buffer.substr(statusEnd + 2, headerEnd - statusEnd - 2),
+                buffer.substr(headerEnd + 4, length)};
+      }
+    }
+    ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+    if(received <= 0) {
+      std::fprintf(stderr, "connection closed by the server after: %s", request.c_str());
+      std::exit(1);
+    }
+    buffer.append(chunk, received);
+  }
+}
+
+static std::string postRequest(const std::string &body) {
+  return "POST /orders HTTP/1.1\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) +
+         "\r\n\r\n" + body;
+}
+
+int main() {
+  char filePath[] = "/tmp/boltpp_error_response_XXXXXX";
+  int file = mkstemp(filePath);
+  const std::string contents = "contents of a file response";
+  if(file == -1 || write(file, contents.data(), contents.size()) != static_cast<ssize_t>(contents.size())) {
+    std::fprintf(stderr, "cannot create %s\n", filePath);
+    return 1;
+  }
+  close(file);
+
+  startServer(filePath);
+  int fd = connectToServer();
+
+  Reply reply = roundTrip(fd, postRequest("{\"customer\":"));
+  if(reply.status != 400 || reply.body != "Bad Request")
+    fail("invalid JSON body not answered with 400", reply);
+
+  reply = roundTrip(fd, "GET /json HTTP/1.1\r\n\r\n");
+  if(reply.status != 500 || reply.body != "Internal Server Error")
+    fail("exception after json() not answered with 500", reply);
+  if(reply.headers.find("X-Partial") != std::string::npos || reply.headers.find("application/json") != std::string::npos)
+    fail("headers set before the exception were sent", reply);
+
+  reply = roundTrip(fd, "GET /file HTTP/1.1\r\n\r\n");
+  if(reply.status != 500 || reply.body != "Internal Server Error")
+    fail("exception after sendFile() not answered with the error body", reply);
+
+  reply = roundTrip(fd, "HEAD /json HTTP/1.1\r\n\r\n", true);
+  if(reply.status != 500 || !reply.body.empty() ||
+     reply.headers.find("Content-Length: 21") == std::string::npos)
+    fail("HEAD request with an exception not answered with the error headers alone", reply);
+
+  reply = roundTrip(fd, postRequest("{\"customer\":{\"id\":42}}"));
+  if(reply.status != 201 || reply.body != "customer 42.000000")
+    fail("valid request after the errors not answered", reply);
+
+  reply = roundTrip(fd, "GET /ok HTTP/1.1\r\n\r\n");
+  if(reply.status != 200 || reply.body != "ok")
+    fail("connection stopped working", reply);
+
+  close(fd);
+  unlink(filePath);
+  return 0;
+}